@@ -15,39 +15,177 @@ typedef enum {
     ALARM_INVALID_STATE,
 } alarm_state_t;
 
-static uint16_t alarm_time = 0; // In minutes. Midnight = 0, Midday = 720, 11pm = 1380
-static alarm_state_t alarm_state = ALARM_DISABLED;
+typedef struct alarm_s {
+    uint16_t        time;       // In minutes. Midnight = 0, Midday = 720, 11pm = 1380
+    uint8_t         weekdays;   // Bit 0 = Sunday. 0 = not in use
+    alarm_state_t   state;
+} alarm_t;
 
+#define WHOLE_WEEK (7 * WHOLE_DAY)
+#define NO_EVENT   (0xffff)
 
+// Alarm 0 is set by alarm_set and sounds once. The others are set by
+// alarm_schedule_set and sound every week on the selected days.
+static alarm_t alarms[ALARM_SCHEDULE_SIZE];
 
-static void save_to_nvram()
+// Time of the last alarm_update_weekday (minutes since Sunday 00:00) and the
+// number of minutes after that when the next state change may happen
+static uint16_t last_update_time = 0;
+static uint16_t next_event_time = NO_EVENT;
+static uint8_t event_pending = 1;
+
+
+
+static void save_to_nvram(uint8_t slot)
 {
-    nvram_write(NVRAM_ALARM_HI, alarm_time >> 8);
-    nvram_write(NVRAM_ALARM_LO, alarm_time);
-    nvram_write(NVRAM_ALARM_STATE, (uint8_t) alarm_state);
+    const alarm_t* a = &alarms[slot];
+
+    if (slot == 0) {
+        nvram_write(NVRAM_ALARM_HI, a->time >> 8);
+        nvram_write(NVRAM_ALARM_LO, a->time);
+        nvram_write(NVRAM_ALARM_STATE, (uint8_t) a->state);
+    } else {
+        // Compact form: weekdays, then state (2 bits) and time (11 bits)
+        uint8_t addr = NVRAM_SCHEDULE_BASE + ((slot - 1) * NVRAM_SCHEDULE_ENTRY_SIZE);
+        nvram_write(addr + 0, a->weekdays);
+        nvram_write(addr + 1, ((uint8_t) a->state << 3) | (a->time >> 8));
+        nvram_write(addr + 2, a->time);
+    }
+}
+
+static void load_from_nvram(uint8_t slot)
+{
+    alarm_t* a = &alarms[slot];
+
+    if (slot == 0) {
+        uint8_t hi = nvram_read(NVRAM_ALARM_HI);
+        uint8_t lo = nvram_read(NVRAM_ALARM_LO);
+        a->state = (alarm_state_t) nvram_read(NVRAM_ALARM_STATE);
+        a->time = ((uint16_t) hi << 8) | (uint16_t) lo;
+        a->weekdays = ALARM_EVERY_DAY;
+    } else {
+        uint8_t addr = NVRAM_SCHEDULE_BASE + ((slot - 1) * NVRAM_SCHEDULE_ENTRY_SIZE);
+        uint8_t hi;
+        a->weekdays = nvram_read(addr + 0);
+        hi = nvram_read(addr + 1);
+        a->state = (alarm_state_t) (hi >> 3);
+        a->time = ((uint16_t) (hi & 7) << 8) | (uint16_t) nvram_read(addr + 2);
+        if (a->weekdays & ~ALARM_EVERY_DAY) {
+            a->weekdays = 0;
+        }
+        if (!a->weekdays) {
+            a->state = ALARM_DISABLED;
+        }
+    }
+    if (a->time >= WHOLE_DAY) {
+        a->time = 0;
+    }
+    if ((uint8_t) a->state >= (uint8_t) ALARM_INVALID_STATE) {
+        a->state = ALARM_DISABLED;
+    }
+}
+
+// Returns > 0 if 'now' is within ALARM_SOUNDS_FOR minutes of the alarm time,
+// on a day when the alarm is enabled. The return value is the number of
+// minutes since the alarm time, rounded up.
+static unsigned active_region(const alarm_t* a, uint8_t weekday, uint16_t now_time)
+{
+    uint16_t since;
+
+    if (now_time >= WHOLE_DAY) {
+        return 0;
+    }
+    since = (now_time + WHOLE_DAY - a->time) % WHOLE_DAY;
+    if (since >= ALARM_SOUNDS_FOR) {
+        return 0;
+    }
+    if (weekday != ALARM_NO_WEEKDAY) {
+        // If the alarm time is later than 'now', the alarm began yesterday
+        uint8_t day = (now_time < a->time) ? (weekday + 6) : weekday;
+        if (!(a->weekdays & (1 << (day % 7)))) {
+            return 0;
+        }
+    }
+    return since + 1;
+}
+
+// Returns the number of minutes from 'now' until the state of the alarm may change
+static uint16_t minutes_to_event(const alarm_t* a, uint8_t weekday, uint16_t now_time)
+{
+    uint16_t until, day;
+
+    switch (a->state) {
+        case ALARM_ACTIVE:
+            // the return value of alarm_update changes every minute
+            return 1;
+        case ALARM_RESET:
+            // enabled after leaving the active region
+            return ALARM_SOUNDS_FOR - active_region(a, ALARM_NO_WEEKDAY, now_time) + 1;
+        case ALARM_ENABLED:
+            // next alarm time on a day when the alarm is enabled
+            until = (a->time + WHOLE_DAY - now_time) % WHOLE_DAY;
+            if (until == 0) {
+                until = WHOLE_DAY;
+            }
+            if (weekday == ALARM_NO_WEEKDAY) {
+                return until;
+            }
+            for (day = (now_time + until) / WHOLE_DAY; day <= 7; day++, until += WHOLE_DAY) {
+                if (a->weekdays & (1 << ((weekday + day) % 7))) {
+                    return until;
+                }
+            }
+            return NO_EVENT;
+        default:
+            return NO_EVENT;
+    }
+}
+
+// Stop any scheduled alarm which is sounding now; it will sound again next time
+static int silence_schedule(void)
+{
+    uint8_t slot;
+    int changed = 0;
+
+    for (slot = 1; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        if (alarms[slot].state == ALARM_ACTIVE) {
+            alarms[slot].state = ALARM_RESET;
+            save_to_nvram(slot);
+            changed = 1;
+        }
+    }
+    event_pending = 1;
+    return changed;
 }
 
 // Called as a result of an incoming message. Alarm is set for some time in the future.
 int alarm_set(uint8_t hour, uint8_t minute)
 {
     char tmp[16];
-    alarm_state_t old_state = alarm_state;
-    alarm_time = (hour * 60) + minute;
-    alarm_state = ALARM_RESET;
+    alarm_t* a = &alarms[0];
+    alarm_state_t old_state = a->state;
+    a->time = (hour * 60) + minute;
+    if (a->time >= WHOLE_DAY) {
+        a->time = 0;
+    }
+    a->state = ALARM_RESET;
     snprintf(tmp, sizeof(tmp), "ALARM %02d:%02d", hour, minute);
     display_message(tmp);
-    save_to_nvram();
-    return old_state != alarm_state;
+    save_to_nvram(0);
+    event_pending = 1;
+    return (old_state != a->state) | silence_schedule();
 }
 
 // Called as a result of an incoming message, or pressing the left button. Alarm is unset.
 int alarm_unset(void)
 {
-    alarm_state_t old_state = alarm_state;
+    alarm_t* a = &alarms[0];
+    alarm_state_t old_state = a->state;
     display_message("ALARM OFF");
-    alarm_state = ALARM_DISABLED;
-    save_to_nvram();
-    return old_state != alarm_state;
+    a->state = ALARM_DISABLED;
+    save_to_nvram(0);
+    event_pending = 1;
+    return (old_state != a->state) | silence_schedule();
 }
 
 // Called as a result of pressing the right button. Alarm is set for the same time again - but in the future.
@@ -61,79 +199,124 @@ int alarm_reset(void)
 // Get the alarm time
 void alarm_get(uint8_t* hour, uint8_t* minute)
 {
-    *hour = alarm_time / 60;
-    *minute = alarm_time % 60;
+    *hour = alarms[0].time / 60;
+    *minute = alarms[0].time % 60;
+}
+
+// Called as a result of an incoming message. Scheduled alarm is set to sound every week.
+int alarm_schedule_set(uint8_t slot, uint8_t hour, uint8_t minute, uint8_t weekdays)
+{
+    char tmp[16];
+    alarm_t* a;
+
+    if ((slot == 0) || (slot >= ALARM_SCHEDULE_SIZE)
+    || (hour >= 24) || (minute >= 60)) {
+        display_message("ALARM ERROR");
+        return 0;
+    }
+    a = &alarms[slot];
+    a->time = (hour * 60) + minute;
+    a->weekdays = weekdays & ALARM_EVERY_DAY;
+    if (a->weekdays) {
+        a->state = ALARM_RESET;
+        snprintf(tmp, sizeof(tmp), "ALARM %d %02d:%02d", slot, hour, minute);
+    } else {
+        a->state = ALARM_DISABLED;
+        snprintf(tmp, sizeof(tmp), "ALARM %d OFF", slot);
+    }
+    display_message(tmp);
+    save_to_nvram(slot);
+    event_pending = 1;
+    return 1;
 }
 
 // Returns > 0 if the alarm should be sounding now.
 // The return value is the number of minutes since activation, rounded up.
 unsigned alarm_update(uint8_t now_hour, uint8_t now_minute)
+{
+    return alarm_update_weekday(ALARM_NO_WEEKDAY, now_hour, now_minute);
+}
+
+// As alarm_update, taking the weekday into account
+unsigned alarm_update_weekday(uint8_t weekday, uint8_t now_hour, uint8_t now_minute)
 {
     uint16_t now_time = (now_hour * 60) + now_minute;
-    uint16_t test_time = alarm_time;
-    unsigned i, in_active_region = 0;
+    unsigned sounding = 0;
+    uint8_t slot;
+
+    next_event_time = NO_EVENT;
+    for (slot = 0; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        alarm_t* a = &alarms[slot];
+        unsigned in_active_region;
+        uint16_t until;
+
+        if (a->state == ALARM_DISABLED) {
+            continue;
+        }
+        in_active_region = active_region(a, weekday, now_time);
 
-    for (i = 1; i <= ALARM_SOUNDS_FOR; i++) {
-        if (test_time >= WHOLE_DAY) {
-            test_time = 0;
+        switch(a->state) {
+            case ALARM_ACTIVE:
+                // alarm already sounding
+                if (!in_active_region) {
+                    // stop - timeout. Scheduled alarms will sound again next time.
+                    a->state = slot ? ALARM_ENABLED : ALARM_DISABLED;
+                    save_to_nvram(slot);
+                }
+                break;
+            case ALARM_ENABLED:
+                if (in_active_region) {
+                    // alarm begins to sound
+                    a->state = ALARM_ACTIVE;
+                    save_to_nvram(slot);
+                }
+                break;
+            case ALARM_RESET:
+                // alarm has been set or reset
+                // It won't actually be enabled until after it has left the active region.
+                // Otherwise it would retrigger immediately.
+                if (!in_active_region) {
+                    a->state = ALARM_ENABLED;
+                    save_to_nvram(slot);
+                }
+                break;
+            default:
+                break;
+        }
+        if ((a->state == ALARM_ACTIVE) && (in_active_region > sounding)) {
+            sounding = in_active_region;
         }
-        if (test_time == now_time) {
-            in_active_region = i;
-            break;
+        until = minutes_to_event(a, weekday, now_time);
+        if (until < next_event_time) {
+            next_event_time = until;
         }
-        test_time++;
     }
 
-    switch(alarm_state) {
-        case ALARM_ACTIVE:
-            // alarm already sounding
-            if (!in_active_region) {
-                // stop - timeout
-                alarm_state = ALARM_DISABLED;
-                save_to_nvram();
-                return 0;
-            } else {
-                return in_active_region;
-            }
-        case ALARM_ENABLED:
-            if (in_active_region) {
-                // alarm begins to sound
-                alarm_state = ALARM_ACTIVE;
-                save_to_nvram();
-                return in_active_region;
-            } else {
-                return 0;
-            }
-        case ALARM_RESET:
-            // alarm has been set or reset
-            // It won't actually be enabled until after it has left the active region.
-            // Otherwise it would retrigger immediately.
-            if (!in_active_region) {
-                alarm_state = ALARM_ENABLED;
-                save_to_nvram();
-            }
-            return 0;
-        case ALARM_DISABLED:
-            return 0;
-        default:
-            return 0;
-    }
+    last_update_time = ((weekday % 7) * WHOLE_DAY) + now_time;
+    event_pending = 0;
+    return sounding;
+}
+
+// Returns non-zero if alarm_update_weekday should be called now. Otherwise,
+// the result of alarm_update_weekday would be the same as last time.
+int alarm_update_due(uint8_t weekday, uint8_t now_hour, uint8_t now_minute)
+{
+    uint16_t now_time = ((weekday % 7) * WHOLE_DAY) + (now_hour * 60) + now_minute;
+
+    // If the clock goes backwards, the elapsed time is large, so an update is due
+    return event_pending
+        || (((now_time + WHOLE_WEEK - last_update_time) % WHOLE_WEEK) >= next_event_time);
 }
 
 // Called during boot
 void alarm_init(void)
 {
-    uint8_t hi = nvram_read(NVRAM_ALARM_HI);
-    uint8_t lo = nvram_read(NVRAM_ALARM_LO);
-    alarm_state = (alarm_state_t) nvram_read(NVRAM_ALARM_STATE);
+    uint8_t slot;
 
-    alarm_time = ((uint16_t) hi << 8) | (uint16_t) lo;
-    if (alarm_time >= WHOLE_DAY) {
-        alarm_time = 0;
-    }
-    if ((uint8_t) alarm_state >= (uint8_t) ALARM_INVALID_STATE) {
-        alarm_state = ALARM_DISABLED;
+    for (slot = 0; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        load_from_nvram(slot);
+        save_to_nvram(slot);
     }
-    save_to_nvram();
+    event_pending = 1;
 }
 
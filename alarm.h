@@ -10,6 +10,9 @@ extern "C" {
 
 #define WHOLE_DAY (24*60)
 #define ALARM_SOUNDS_FOR (10) // minutes
+#define ALARM_SCHEDULE_SIZE (3) // alarm 0 (alarm_set) plus scheduled alarms 1 and 2
+#define ALARM_EVERY_DAY (0x7f) // weekday mask: bit 0 = Sunday, bit 6 = Saturday
+#define ALARM_NO_WEEKDAY (0xff) // weekday is unknown: weekday masks are ignored
 
 // Called as a result of an incoming message. Alarm is set for some time in the future.
 int alarm_set(uint8_t hour, uint8_t minute);
@@ -23,10 +26,24 @@ int alarm_reset(void);
 // Get the alarm time
 void alarm_get(uint8_t* hour, uint8_t* minute);
 
+// Called as a result of an incoming message. Scheduled alarm 'slot' (1 .. ALARM_SCHEDULE_SIZE - 1)
+// is set to sound at the same time every week, on the days in the weekday mask.
+// A weekday mask of 0 removes the scheduled alarm. Returns 0 if the parameters are invalid.
+int alarm_schedule_set(uint8_t slot, uint8_t hour, uint8_t minute, uint8_t weekdays);
+
 // Returns > 0 if the alarm should be sounding now.
 // The return value is the number of minutes since activation, rounded up.
 unsigned alarm_update(uint8_t now_hour, uint8_t now_minute);
 
+// As alarm_update, but scheduled alarms only sound on the selected weekdays (0 = Sunday).
+unsigned alarm_update_weekday(uint8_t weekday, uint8_t now_hour, uint8_t now_minute);
+
+// Returns non-zero if alarm_update_weekday needs to be called at this time.
+// If zero, no alarm can change state before the next event time computed by
+// the last call to alarm_update_weekday, and the result would be the same as
+// the last result (which may be non-zero within the same minute).
+int alarm_update_due(uint8_t weekday, uint8_t now_hour, uint8_t now_minute);
+
 // Called during boot
 void alarm_init(void);
 
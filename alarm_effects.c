@@ -0,0 +1,185 @@
+
+#include <stdint.h>
+#include <string.h>
+
+#include "alarm_effects.h"
+
+#define STEPS_PER_PHASE     (ALARM_EFFECTS_PHASE_TIME / ALARM_EFFECTS_STEP_TIME)
+#define REPEAT_PHASE        10  // after the final phase, continue from here
+#define NUM_PHASES          (sizeof(alarm_phases) / sizeof(alarm_phases[0]))
+
+typedef enum {
+    EFFECT_FADE,            // gradual fade in
+    EFFECT_PULSE,           // brightness follows pulse_table
+    EFFECT_STROBE,          // flash once per period
+} effect_t;
+
+typedef enum {
+    COLOUR_YELLOW,
+    COLOUR_WHITE,
+    COLOUR_WHITE_RED,       // white in the first half of each pulse, then red
+} colour_t;
+
+typedef struct alarm_phase_s {
+    uint8_t     effect;
+    uint8_t     colour;
+    uint16_t    period;         // milliseconds between brightness updates (or flashes)
+    uint16_t    tone_interval;  // milliseconds between tones, 0 = silent
+} alarm_phase_t;
+
+// Each phase lasts for ALARM_EFFECTS_PHASE_TIME
+static const alarm_phase_t alarm_phases[] = {
+    {EFFECT_FADE,   COLOUR_YELLOW,      250,    0},     // 0
+    {EFFECT_PULSE,  COLOUR_YELLOW,      250,    0},     // 1
+    {EFFECT_STROBE, COLOUR_YELLOW,      2000,   0},     // 2
+    {EFFECT_STROBE, COLOUR_YELLOW,      500,    10000}, // 3
+    {EFFECT_STROBE, COLOUR_YELLOW,      250,    5000},  // 4
+    {EFFECT_PULSE,  COLOUR_WHITE,       250,    3000},  // 5
+    {EFFECT_STROBE, COLOUR_WHITE,       2000,   2000},  // 6
+    {EFFECT_STROBE, COLOUR_WHITE,       500,    1000},  // 7
+    {EFFECT_STROBE, COLOUR_WHITE,       250,    500},   // 8
+    {EFFECT_PULSE,  COLOUR_WHITE_RED,   250,    200},   // 9
+    {EFFECT_STROBE, COLOUR_WHITE_RED,   2000,   100},   // 10
+    {EFFECT_STROBE, COLOUR_WHITE_RED,   500,    100},   // 11
+    {EFFECT_STROBE, COLOUR_WHITE_RED,   250,    100},   // 12
+    {EFFECT_PULSE,  COLOUR_WHITE_RED,   250,    100},   // 13
+};
+
+// Brightness at each step of a pulse: down from full brightness, then up again
+static const uint8_t pulse_table[ALARM_EFFECTS_PULSE_STEPS] = {255, 192, 128, 64, 0, 63, 127, 191};
+
+static const uint8_t colour_table[][2][3] = {
+    {{255, 255, 0}, {255, 255, 0}},     // COLOUR_YELLOW
+    {{255, 255, 255}, {255, 255, 255}}, // COLOUR_WHITE
+    {{255, 255, 255}, {255, 0, 0}},     // COLOUR_WHITE_RED
+};
+
+// Playback position
+static uint8_t started = 0;
+static uint8_t phase = 0;
+static uint8_t step = 0;            // steps since the start of the phase
+static uint16_t step_time = 0;      // milliseconds since the start of the step
+static uint32_t last_running_time = 0;
+
+// Effect state
+static uint32_t strobe_trigger = 0;
+static uint32_t sound_trigger = 0;
+static uint8_t brightness = 0;
+static uint8_t colour[3] = {0, 0, 0};
+static uint8_t output[3] = {0, 0, 0};
+
+
+
+// Find the playback position from the start (used when the time jumps)
+static void seek(uint32_t running_time)
+{
+    uint32_t phase_count = running_time / ALARM_EFFECTS_PHASE_TIME;
+    uint32_t phase_time = running_time % ALARM_EFFECTS_PHASE_TIME;
+
+    if (phase_count >= NUM_PHASES) {
+        phase_count = REPEAT_PHASE + ((phase_count - REPEAT_PHASE) % (NUM_PHASES - REPEAT_PHASE));
+    }
+    phase = phase_count;
+    step = phase_time / ALARM_EFFECTS_STEP_TIME;
+    step_time = phase_time % ALARM_EFFECTS_STEP_TIME;
+}
+
+// Move the playback position forwards
+static void advance(uint32_t delta)
+{
+    delta += step_time;
+    while (delta >= ALARM_EFFECTS_STEP_TIME) {
+        delta -= ALARM_EFFECTS_STEP_TIME;
+        step++;
+        if (step >= STEPS_PER_PHASE) {
+            step = 0;
+            phase++;
+            if (phase >= NUM_PHASES) {
+                phase = REPEAT_PHASE;
+            }
+        }
+    }
+    step_time = delta;
+}
+
+void alarm_effects_reset(void)
+{
+    started = 0;
+    strobe_trigger = sound_trigger = 0;
+    brightness = 0;
+    memset(output, 0, sizeof(output));
+}
+
+int alarm_effects_update(uint32_t running_time, alarm_effects_t* effects)
+{
+    const alarm_phase_t* p;
+    uint32_t delta = running_time - last_running_time;
+    uint8_t pulse_step, changed, updated, i;
+
+    last_running_time = running_time;
+    if ((!started) || (delta >= ALARM_EFFECTS_PHASE_TIME)) {
+        // first update, or the time has jumped (possibly backwards)
+        seek(running_time);
+        started = 1;
+        delta = 0;
+    } else {
+        advance(delta);
+    }
+    p = &alarm_phases[phase];
+    pulse_step = step % ALARM_EFFECTS_PULSE_STEPS;
+
+    strobe_trigger += delta;
+    sound_trigger += delta;
+
+    // Brightness effects
+    updated = 0;
+    if (p->effect == EFFECT_STROBE) {
+        brightness = 0;
+        updated = 1;
+    }
+    if (strobe_trigger >= p->period) {
+        updated = 1;
+        strobe_trigger -= p->period;
+        switch (p->effect) {
+            case EFFECT_FADE:
+                // 255 / STEPS_PER_PHASE = 17 / 8
+                brightness = (step * 17) / 8;
+                break;
+            case EFFECT_PULSE:
+                brightness = pulse_table[pulse_step];
+                break;
+            default:
+                brightness = 255;
+                break;
+        }
+    }
+    if (updated) {
+        // Colour is chosen whenever the brightness is updated
+        memcpy(colour, colour_table[p->colour][pulse_step >= (ALARM_EFFECTS_PULSE_STEPS / 2)], 3);
+    }
+
+    // Colours are scaled in the same way as Adafruit_NeoPixel::setBrightness
+    changed = 0;
+    for (i = 0; i < 3; i++) {
+        uint8_t value = ((uint16_t) colour[i] * (brightness + 1)) >> 8;
+        if (value != output[i]) {
+            output[i] = value;
+            changed = 1;
+        }
+    }
+    effects->red = output[0];
+    effects->green = output[1];
+    effects->blue = output[2];
+
+    // Sound effects
+    effects->sound = (p->tone_interval != 0);
+    effects->tone = 0;
+    if (!p->tone_interval) {
+        sound_trigger = 0;
+    } else if (sound_trigger >= p->tone_interval) {
+        sound_trigger -= p->tone_interval;
+        effects->tone = 1;
+    }
+    return changed;
+}
+
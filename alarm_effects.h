@@ -0,0 +1,33 @@
+#ifndef ALARM_EFFECTS_H
+#define ALARM_EFFECTS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALARM_EFFECTS_PHASE_TIME    30000   // milliseconds
+#define ALARM_EFFECTS_STEP_TIME     250     // milliseconds
+#define ALARM_EFFECTS_PULSE_STEPS   8       // 2 seconds
+
+typedef struct alarm_effects_s {
+    uint8_t     red;        // colour of all NeoPixels, already scaled by the brightness
+    uint8_t     green;
+    uint8_t     blue;
+    uint8_t     sound;      // non-zero if the speaker should be enabled
+    uint8_t     tone;       // non-zero if a tone should be played now
+} alarm_effects_t;
+
+// Called while the alarm is not sounding. The next update starts the effects again.
+void alarm_effects_reset(void);
+
+// Called frequently while the alarm is sounding. running_time is the number of
+// milliseconds since the alarm began. Returns non-zero if the colour has changed.
+int alarm_effects_update(uint32_t running_time, alarm_effects_t* effects);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
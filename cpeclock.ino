@@ -14,6 +14,10 @@
 #include "hal.h"
 #include "ncrs.h"
 #include "night_day_time.h"
+#include "drift.h"
+#include "deferred.h"
+#include "alarm_effects.h"
+#include "profile.h"
 
 #define SCREEN_WIDTH 128 // OLED display width, in pixels
 #define SCREEN_HEIGHT 64 // OLED display height, in pixels
@@ -23,9 +27,25 @@
 
 #define OLED_RESET     -1 // Reset pin # (or -1 if sharing Arduino reset pin)
 #define SCREEN_ADDRESS 0x3c ///< See datasheet for Address; 0x3D for 128x64, 0x3C for 128x32
-static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
+#define DISPLAY_I2C_CLOCK 400000 // Hz, during display transfers
+#define I2C_CLOCK 100000 // Hz, restored afterwards
+static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET,
+                                DISPLAY_I2C_CLOCK, I2C_CLOCK);
 
 #define NUM_LEDS 10
+#define NEOPIXEL_MAX_DEFER 150 // milliseconds
+
+// Optional: drive the NeoPixels by DMA, so that interrupts are not disabled
+// while updating them. Requires the Adafruit_NeoPixel_ZeroDMA library.
+//#define NEOPIXEL_DMA
+#ifdef NEOPIXEL_DMA
+#include <Adafruit_NeoPixel_ZeroDMA.h>
+#define NEOPIXEL_PIN 8
+static Adafruit_NeoPixel_ZeroDMA dma_strip(NUM_LEDS, NEOPIXEL_PIN, NEO_GRB);
+#define STRIP dma_strip
+#else
+#define STRIP CircuitPlayground.strip
+#endif
 
 #define NVRAM_SIZE 56
 #define KEY 0x98
@@ -34,6 +54,11 @@ static Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 #define INT_PIN     (PIN_A2)
 #define EXT_BUTTON_PIN (PIN_A3)
 
+// Optional: the DS1307 SQW/OUT pin may be connected here. The RTC then generates
+// a 1Hz tick, time is kept locally between ticks, rtc.now() is only called once
+// per minute, and the CPU sleeps between events instead of polling the RTC.
+//#define SQW_PIN     (PIN_A6)
+
 #define PERIOD 10 // milliseconds
 
 static RTC_DS1307 rtc;     // RTC address 0x68
@@ -51,15 +76,46 @@ static DateTime message_off_time = INVALID_TIME;
 
 static char message_buffer_1[32];
 static char message_buffer_2[32];
-static bool message_is_long;
 static uint16_t clock_text_x = 0;
 static bool allow_sound = false;
 static unsigned alarm_active = 0;
 static uint32_t millisecond_offset = 0;
-static uint32_t last_running_time = 0;
-static uint32_t sound_trigger = 0;
-static uint32_t strobe_trigger = 0;
 static uint16_t extension_button_pressed = 0;
+static bool pixels_pending = false;
+static bool pixels_lit = false;
+static uint32_t pixels_pending_since = 0;
+
+// What is currently shown on the display, so that only changes are sent
+#define DISPLAY_CHUNK_SIZE 16 // bytes per I2C transfer
+static uint8_t display_sent[SCREEN_WIDTH * (SCREEN_HEIGHT / 8)];
+static char display_upper[sizeof(message_buffer_1)];
+static char display_lower[sizeof(message_buffer_2)];
+static bool display_lower_is_time = false;
+static int display_dim = -1;
+
+// Pre-rendered clock glyphs, in the SSD1306 page format (one byte = 8 pixels in a column)
+#define CLOCK_GLYPHS " 0123456789:"
+#define CLOCK_GLYPH_COUNT (sizeof(CLOCK_GLYPHS) - 1)
+#define CLOCK_CACHE_SIZE 2048 // bytes
+typedef struct clock_glyph_s {
+    int8_t      x_offset;   // first column, relative to the cursor
+    uint8_t     width;      // number of columns
+    uint8_t     x_advance;
+    uint16_t    index;      // first byte in clock_cache
+} clock_glyph_t;
+static clock_glyph_t clock_glyph[CLOCK_GLYPH_COUNT];
+static uint8_t clock_cache[CLOCK_CACHE_SIZE];
+static uint8_t clock_first_page = 0;
+static uint8_t clock_num_pages = 0;
+static bool clock_cache_ready = false;
+
+#ifdef SQW_PIN
+static volatile uint8_t sqw_ticks = 0;
+static void sqw_interrupt(void);
+#endif
+#ifdef CONFIG_PROFILE
+static void profiled_rx433_interrupt(void);
+#endif
 
 static TimeSpan get_screen_on_time();
 
@@ -123,6 +179,7 @@ void setup()
         display.setFont(&FreeSans24pt7b);
         display.getTextBounds("99:99", 0, LINE_1_Y, &x1, &y1, &w, &h);
         clock_text_x = (SCREEN_WIDTH - w) / 2;
+        clock_cache_ready = build_clock_cache();
     }
 
     if (!ncrs_init()) {
@@ -139,14 +196,32 @@ void setup()
 
     alarm_init();
     night_day_time_init();
+    drift_init();
+    deferred_init();
 
     screen_off_time = now_time + get_screen_on_time();
 
+#ifdef CONFIG_PROFILE
+    attachInterrupt(digitalPinToInterrupt(RX433_PIN), profiled_rx433_interrupt, RISING);
+#else
     attachInterrupt(digitalPinToInterrupt(RX433_PIN), rx433_interrupt, RISING);
+#endif
+#ifdef SQW_PIN
+    // SQW/OUT is open drain; the seconds register changes on the falling edge
+    pinMode(SQW_PIN, INPUT_PULLUP);
+    rtc.writeSqwPinMode(DS1307_SquareWave1HZ);
+    attachInterrupt(digitalPinToInterrupt(SQW_PIN), sqw_interrupt, FALLING);
+#endif
 
     digitalWrite(LED_BUILTIN, LOW);
-    CircuitPlayground.strip.setBrightness(0);
-    CircuitPlayground.strip.show();
+#ifdef NEOPIXEL_DMA
+    STRIP.begin();
+#endif
+    // Alarm effect colours are scaled by alarm_effects_update,
+    // because setBrightness loses information when the brightness is low
+    STRIP.clear();
+    STRIP.setBrightness(255);
+    STRIP.show();
     Serial.println("Booted");
     Serial.flush();
 }
@@ -161,50 +236,389 @@ void nvram_write(uint8_t addr, uint8_t data)
     rtc.writenvram(addr, data);
 }
 
+#ifdef SQW_PIN
+static void sqw_interrupt(void)
+{
+    sqw_ticks++;
+}
+
+// Returns true if the time has moved on by at least one second
+static bool update_now_time(void)
+{
+    uint8_t ticks;
+
+    disable_interrupts();
+    ticks = sqw_ticks;
+    sqw_ticks = 0;
+    enable_interrupts();
+
+    if (!ticks) {
+        return false;
+    }
+    now_time = now_time + TimeSpan(ticks);
+    if (now_time.second() < ticks) {
+        // a new minute: read the RTC again, in case a tick was missed
+        now_time = rtc.now();
+    }
+    return true;
+}
+
+// Sleep until a tick or a radio code is received, or until the next time to
+// check the buttons and update the alarm effects
+static void wait_for_event(void)
+{
+    uint32_t start = millis();
+
+    while (((millis() - start) < PERIOD)
+    && !sqw_ticks && !rx433_new_code_ready && !rx433_home_easy) {
+        __WFI();
+    }
+}
+#else
+static bool update_now_time(void)
+{
+    uint8_t previous_second = now_time.second();
+    now_time = rtc.now();
+    return now_time.second() != previous_second;
+}
+
+static void wait_for_event(void)
+{
+    delay(PERIOD);
+}
+#endif
+
+#ifdef CONFIG_PROFILE
+static uint32_t masked_since = 0;
+#endif
+
 void disable_interrupts(void)
 {
     noInterrupts();
+#ifdef CONFIG_PROFILE
+    masked_since = profile_cycles();
+#endif
 }
 
 void enable_interrupts(void)
 {
+#ifdef CONFIG_PROFILE
+    profile_record(PROFILE_MASKED, profile_cycles() - masked_since);
+#endif
     interrupts();
 }
 
+#ifdef CONFIG_PROFILE
+// The Cortex-M0+ has no cycle counter, so the time in cycles is made from
+// millis() and SysTick, which counts down from LOAD to 0 once per millisecond.
+// This works with interrupts disabled, provided that they are not disabled for
+// more than 1 millisecond.
+uint32_t profile_cycles(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    uint32_t load = SysTick->LOAD;
+    uint32_t ms, ticks;
+
+    __disable_irq();
+    ms = millis();
+    ticks = SysTick->VAL;
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && (ticks > (load / 2))) {
+        // SysTick has reached 0, but millis() has not been updated yet
+        ms++;
+    }
+    __set_PRIMASK(primask);
+    return (ms * (load + 1)) + (load - ticks);
+}
+
+uint32_t profile_cycles_per_second(void)
+{
+    return F_CPU;
+}
+
+static void profiled_rx433_interrupt(void)
+{
+    PROFILE_BEGIN(isr);
+    rx433_interrupt();
+    PROFILE_END(isr, PROFILE_ISR);
+}
+
+// Commands from the serial port: 'P' sends the profile (see profile_report.py),
+// 'R' resets it, 'H' prints the Home Easy voting statistics
+static void profile_serial(void)
+{
+    static uint8_t buffer[PROFILE_DUMP_SIZE];
+    unsigned i;
+
+    while (Serial.available() > 0) {
+        switch (Serial.read()) {
+            case 'P':
+                Serial.write(buffer, profile_dump(buffer));
+                break;
+            case 'R':
+                profile_reset();
+                break;
+            case 'H':
+                Serial.print("HE copies ");
+                Serial.print(rx433_he_stats.copies);
+                Serial.print(" accepted ");
+                Serial.print(rx433_he_stats.accepted);
+                Serial.print(" suppressed ");
+                Serial.print(rx433_he_stats.suppressed);
+                Serial.print(" unconfirmed ");
+                Serial.print(rx433_he_stats.unconfirmed);
+                Serial.print(" needed");
+                for (i = 0; i < RX433_HE_STATS_COPIES; i++) {
+                    Serial.print(" ");
+                    Serial.print(rx433_he_stats.copies_needed[i]);
+                }
+                Serial.println();
+                break;
+            default:
+                break;
+        }
+    }
+}
+#endif
+
+// Send the parts of the display buffer which have changed since the last call.
+// For each 8 pixel high page, only the range of columns which differ are sent.
+static void send_display_changes(void)
+{
+    const uint8_t* buffer = display.getBuffer();
+    uint8_t page;
+
+    for (page = 0; page < (SCREEN_HEIGHT / 8); page++) {
+        const uint8_t* row = &buffer[page * SCREEN_WIDTH];
+        uint8_t* sent_row = &display_sent[page * SCREEN_WIDTH];
+        int first = 0;
+        int last = SCREEN_WIDTH - 1;
+        int x, i;
+
+        while ((first < SCREEN_WIDTH) && (row[first] == sent_row[first])) {
+            first++;
+        }
+        if (first >= SCREEN_WIDTH) {
+            continue; // no change on this page
+        }
+        while (row[last] == sent_row[last]) {
+            last--;
+        }
+        display.ssd1306_command(SSD1306_PAGEADDR);
+        display.ssd1306_command(page);
+        display.ssd1306_command(page);
+        display.ssd1306_command(SSD1306_COLUMNADDR);
+        display.ssd1306_command(first);
+        display.ssd1306_command(last);
+        // As the library does for its own transfers
+        Wire.setClock(DISPLAY_I2C_CLOCK);
+        for (x = first; x <= last; x += DISPLAY_CHUNK_SIZE) {
+            Wire.beginTransmission(SCREEN_ADDRESS);
+            Wire.write((uint8_t) 0x40); // Co = 0, D/C = 1: data follows
+            for (i = x; (i <= last) && (i < (x + DISPLAY_CHUNK_SIZE)); i++) {
+                Wire.write(row[i]);
+            }
+            Wire.endTransmission();
+        }
+        Wire.setClock(I2C_CLOCK);
+        memcpy(&sent_row[first], &row[first], last - first + 1);
+    }
+}
+
+// Decode the clock font glyphs into clock_cache. The clock baseline is always
+// at LINE_1_Y, so each glyph is stored in the same pages as it will be drawn.
+static bool build_clock_cache(void)
+{
+    const GFXfont* font = &FreeSans24pt7b;
+    int16_t min_y = SCREEN_HEIGHT;
+    int16_t max_y = 0;
+    uint16_t index = 0;
+    uint8_t i;
+
+    // Which pages are used?
+    for (i = 0; i < CLOCK_GLYPH_COUNT; i++) {
+        const GFXglyph* glyph = &font->glyph[CLOCK_GLYPHS[i] - font->first];
+        int16_t y1 = LINE_1_Y + glyph->yOffset;
+        int16_t y2 = y1 + glyph->height - 1;
+        if (glyph->height && (y1 < min_y)) {
+            min_y = y1;
+        }
+        if (glyph->height && (y2 > max_y)) {
+            max_y = y2;
+        }
+    }
+    if ((min_y < 0) || (max_y >= SCREEN_HEIGHT) || (min_y > max_y)) {
+        return false;
+    }
+    clock_first_page = min_y / 8;
+    clock_num_pages = (max_y / 8) - clock_first_page + 1;
+
+    // Decode each glyph, in the same way as Adafruit_GFX::drawChar
+    memset(clock_cache, 0, sizeof(clock_cache));
+    for (i = 0; i < CLOCK_GLYPH_COUNT; i++) {
+        const GFXglyph* glyph = &font->glyph[CLOCK_GLYPHS[i] - font->first];
+        const uint8_t* bitmap = &font->bitmap[glyph->bitmapOffset];
+        clock_glyph_t* cg = &clock_glyph[i];
+        uint8_t bits = 0;
+        uint16_t bit = 0;
+
+        cg->x_offset = glyph->xOffset;
+        cg->width = glyph->width;
+        cg->x_advance = glyph->xAdvance;
+        cg->index = index;
+        index += cg->width * clock_num_pages;
+        if (index > sizeof(clock_cache)) {
+            return false;
+        }
+        for (uint8_t yy = 0; yy < glyph->height; yy++) {
+            uint8_t y = LINE_1_Y + glyph->yOffset + yy - (clock_first_page * 8);
+            for (uint8_t xx = 0; xx < glyph->width; xx++) {
+                if (!(bit++ & 7)) {
+                    bits = *bitmap++;
+                }
+                if (bits & 0x80) {
+                    clock_cache[cg->index + (xx * clock_num_pages) + (y / 8)] |= 1 << (y % 8);
+                }
+                bits <<= 1;
+            }
+        }
+    }
+    return true;
+}
+
+// Draw the clock text (digits, spaces and colons) by copying columns from the cache
+static void draw_clock_text(const char* text)
+{
+    uint8_t* buffer = display.getBuffer();
+    int16_t cursor = clock_text_x;
+
+    for (; *text; text++) {
+        const char* found = strchr(CLOCK_GLYPHS, *text);
+        if (!found) {
+            continue;
+        }
+        const clock_glyph_t* cg = &clock_glyph[found - CLOCK_GLYPHS];
+        const uint8_t* column = &clock_cache[cg->index];
+        for (uint8_t xx = 0; xx < cg->width; xx++) {
+            int16_t x = cursor + cg->x_offset + xx;
+            if ((x >= 0) && (x < SCREEN_WIDTH)) {
+                for (uint8_t page = 0; page < clock_num_pages; page++) {
+                    buffer[((clock_first_page + page) * SCREEN_WIDTH) + x] |= column[page];
+                }
+            }
+            column += clock_num_pages;
+        }
+        cursor += cg->x_advance;
+    }
+}
+
+// Copy a line of text, which may be truncated, to a buffer of "size" bytes
+static void copy_line(char* to, const char* from, size_t size)
+{
+    size_t length = strnlen(from, size - 1);
+
+    memcpy(to, from, length);
+    to[length] = '\0';
+}
+
 static void update_display(void)
 {
     bool alternator = !(now_time.second() & 1);
-    char tmp[16];
+    bool dim = is_night_time() && !alarm_active;
+    const char* upper = "";
+    char lower[sizeof(message_buffer_2)];
+    bool lower_is_time = false;
+
+    // Decide what the upper line should show
+    if (now_time <= message_off_time) {
+        upper = message_buffer_1;
+    } else if (alarm_active && alternator) {
+        upper = "ALARM!";
+    }
+
+    // Decide what the lower line should show
+    lower[0] = '\0';
+    if ((now_time <= message_off_time) && message_buffer_2[0]) {
+        // second line of message
+        strncpy(lower, message_buffer_2, sizeof(lower) - 1);
+        lower[sizeof(lower) - 1] = '\0';
+    } else if ((now_time <= screen_off_time) || alarm_active) {
+        // show the time
+        snprintf(lower, sizeof(lower), "%02d%c%02d", now_time.hour(),
+            alternator ? ' ' : ':', now_time.minute());
+        lower_is_time = true;
+    }
+
+    if (dim != display_dim) {
+        display.dim(dim);
+        display_dim = dim;
+    }
+    if ((strcmp(upper, display_upper) == 0)
+    && (strcmp(lower, display_lower) == 0)
+    && (lower_is_time == display_lower_is_time)) {
+        // Nothing has changed
+        return;
+    }
+    copy_line(display_upper, upper, sizeof(display_upper));
+    copy_line(display_lower, lower, sizeof(display_lower));
+    display_lower_is_time = lower_is_time;
 
     display.clearDisplay();
     display.setTextSize(1);
     display.setTextColor(SSD1306_WHITE);
-    display.dim(is_night_time() && !alarm_active);
 
     // Update the upper line on the display
     display.setFont(&FreeSans9pt7b);
     display.setCursor(0, BLUE_AREA_Y - 1);
-    if (now_time <= message_off_time) {
-        display.println(message_buffer_1);
-    } else if (alarm_active && alternator) {
-        display.println("ALARM!");
-    }
+    display.println(upper);
 
     // Update the lower line on the display
-    display.setFont(&FreeSans24pt7b);
-    display.setCursor(clock_text_x, LINE_1_Y);
-    if ((now_time <= message_off_time) && message_buffer_2[0]) {
-        // second line of message
-        display.setFont(&FreeSans9pt7b);
+    if (lower_is_time && clock_cache_ready) {
+        draw_clock_text(lower);
+    } else if (lower_is_time) {
+        display.setFont(&FreeSans24pt7b);
+        display.setCursor(clock_text_x, LINE_1_Y);
+        display.println(lower);
+    } else {
         display.setCursor(0, LINE_1_Y);
-        display.println(message_buffer_2);
-    } else if ((now_time <= screen_off_time) || alarm_active) {
-        // show the time
-        snprintf(tmp, sizeof(tmp), "%02d%c%02d", now_time.hour(),
-            alternator ? ' ' : ':', now_time.minute());
-        display.println(tmp);
+        display.println(lower);
     }
-    display.display();
+    send_display_changes();
+}
+
+// Width of some FreeSans9pt7b text, measured one character at a time,
+// with the same result as Adafruit_GFX::getTextBounds
+typedef struct text_bounds_s {
+    int16_t     x;
+    int16_t     min_x;
+    int16_t     max_x;
+} text_bounds_t;
+
+static void text_bounds_add(text_bounds_t* tb, char c)
+{
+    const GFXfont* font = &FreeSans9pt7b;
+    uint8_t ch = (uint8_t) c;
+
+    if ((ch >= font->first) && (ch <= font->last)) {
+        const GFXglyph* glyph = &font->glyph[ch - font->first];
+        // As in Adafruit_GFX charBounds, a glyph with no bitmap (a space)
+        // only advances the cursor
+        if ((glyph->width > 0) && (glyph->height > 0)) {
+            int16_t x1 = tb->x + glyph->xOffset;
+            int16_t x2 = x1 + glyph->width - 1;
+            if (x1 < tb->min_x) {
+                tb->min_x = x1;
+            }
+            if (x2 > tb->max_x) {
+                tb->max_x = x2;
+            }
+        }
+        tb->x += glyph->xAdvance;
+    }
+}
+
+static uint16_t text_bounds_width(const text_bounds_t* tb)
+{
+    return (tb->max_x >= tb->min_x) ? (tb->max_x - tb->min_x + 1) : 0;
 }
 
 void display_message(const char* msg)
@@ -215,7 +629,7 @@ void display_message(const char* msg)
 
     // Will the message spill onto two lines?
     size_t chars_on_first_line = 0;
-    display.setFont(&FreeSans9pt7b);
+    text_bounds_t tb = {0, 0x7fff, -1};
 
     while (true) {
         if ((chars_on_first_line >= (sizeof(message_buffer_1) - 1)) || !msg[chars_on_first_line]) {
@@ -235,10 +649,8 @@ void display_message(const char* msg)
             break;
         }
 
-        int16_t x1, y1;
-        uint16_t h, w;
-        display.getTextBounds(message_buffer_1, 0, 0, &x1, &y1, &w, &h);
-        if (w > SCREEN_WIDTH) {
+        text_bounds_add(&tb, msg[chars_on_first_line]);
+        if (text_bounds_width(&tb) > SCREEN_WIDTH) {
             // Too many characters - go to the second line
             message_buffer_1[chars_on_first_line] = '\0';
             strncpy(message_buffer_2, &msg[chars_on_first_line], sizeof(message_buffer_2) - 1);
@@ -260,7 +672,7 @@ void display_message(const char* msg)
 
 static int is_night_time()
 {
-    return night_day_time_test(now_time.hour(), now_time.minute());
+    return night_day_time_test(now_time.dayOfTheWeek(), now_time.hour(), now_time.minute());
 }
 
 static TimeSpan get_screen_on_time() {
@@ -279,204 +691,134 @@ void clock_set(uint8_t hour, uint8_t minute, uint8_t second)
 {
     DateTime new_time = DateTime(now_time.year(), now_time.month(), now_time.day(), hour, minute, second);
 
-    while (new_time <= now_time) {
+    // The date does not change unless the new time is more than 12 hours away
+    if ((new_time - now_time).totalseconds() > (ONE_DAY.totalseconds() / 2)) {
+        new_time = new_time - ONE_DAY;
+    } else if ((now_time - new_time).totalseconds() > (ONE_DAY.totalseconds() / 2)) {
         new_time = new_time + ONE_DAY;
     }
+    drift_clock_set(now_time.unixtime(), new_time.unixtime());
     rtc.adjust(new_time);
     now_time = new_time;
     display_message("SET CLOCK");
 }
 
-static bool try_subtract_strobe_trigger(uint32_t how_often)
+static unsigned check_alarm(void)
 {
-    if (strobe_trigger >= how_often) {
-        strobe_trigger -= how_often;
-        return true;
-    } else {
-        return false;
+    return alarm_update_weekday(now_time.dayOfTheWeek(), now_time.hour(), now_time.minute());
+}
+
+// Send any new NeoPixel colours. Without DMA, this involves disabling interrupts,
+// which would disrupt receiving messages, so it waits until no code is being
+// received (for up to NEOPIXEL_MAX_DEFER). Changes made while waiting are merged.
+static void flush_pixels(void)
+{
+    if (!pixels_pending) {
+        return;
     }
+#ifndef NEOPIXEL_DMA
+    if (rx433_busy() && ((millis() - pixels_pending_since) < NEOPIXEL_MAX_DEFER)) {
+        return;
+    }
+#endif
+    digitalWrite(INT_PIN, HIGH);
+    PROFILE_BEGIN(show);
+    STRIP.show();
+    PROFILE_END(show, PROFILE_NEOPIXEL);
+    digitalWrite(INT_PIN, LOW);
+    pixels_pending = false;
+}
+
+static void show_pixels(void)
+{
+    if (!pixels_pending) {
+        pixels_pending = true;
+        pixels_pending_since = millis();
+    }
+    flush_pixels();
 }
 
 static void update_alarm(void)
 {
+    // Finish any update which was deferred
+    flush_pixels();
+
     // No action if the alarm is disabled, except for switching off NeoPixels
     // and the speaker
     if (!alarm_active) {
-        if (0 != CircuitPlayground.strip.getBrightness()) {
-            CircuitPlayground.strip.setBrightness(0);
-            digitalWrite(INT_PIN, HIGH);
-            CircuitPlayground.strip.show();
-            digitalWrite(INT_PIN, LOW);
+        if (pixels_lit) {
+            STRIP.clear();
+            show_pixels();
+            pixels_lit = false;
         }
         CircuitPlayground.speaker.enable(false);
-        strobe_trigger = sound_trigger = 0;
+        alarm_effects_reset();
         return;
     }
 
-    uint32_t i;
-
     // How many milliseconds has the alarm been running for?
     uint32_t running_time = ((alarm_active - 1) * 60000) + millis() - millisecond_offset;
+    alarm_effects_t effects;
 
-    // How many milliseconds since the last time update_alarm ran?
-    uint32_t millisecond_delta = running_time - last_running_time;
-    last_running_time = running_time;
-
-    const uint32_t TOTAL_PHASE_TIME = 30000;
-    const uint32_t TOTAL_PULSE_TIME = 2000;
-    uint32_t phase = running_time / TOTAL_PHASE_TIME;
-    uint32_t phase_time = running_time % TOTAL_PHASE_TIME;
-    uint32_t pulse_time = phase_time % TOTAL_PULSE_TIME;
-    uint32_t brightness = CircuitPlayground.strip.getBrightness();
-
-    strobe_trigger += millisecond_delta;
-    sound_trigger += millisecond_delta;
-
-    // Brightness effects
-    switch ((phase <= 4) ? phase : (((phase - 1) % 4) + 1)) {
-        case 0:
-            // gradual fade in
-            if (try_subtract_strobe_trigger(250)) {
-                brightness = ((phase_time * 255) / TOTAL_PHASE_TIME);
-            }
-            break;
-        case 1:
-            // pulsing
-            if (try_subtract_strobe_trigger(250)) {
-                if (pulse_time < (TOTAL_PULSE_TIME / 2)) {
-                    brightness = (255 - ((pulse_time * 255) / (TOTAL_PULSE_TIME / 2)));
-                } else {
-                    brightness = (((pulse_time - (TOTAL_PULSE_TIME / 2)) * 255) / (TOTAL_PULSE_TIME / 2));
-                }
-            }
-            break;
-        case 2:
-            // strobing, once every two seconds
-            if (try_subtract_strobe_trigger(2000)) {
-                brightness = (255);
-            } else {
-                brightness = (0);
-            }
-            break;
-        case 3:
-            // strobing, twice a second
-            if (try_subtract_strobe_trigger(500)) {
-                brightness = (255);
-            } else {
-                brightness = (0);
-            }
-            break;
-        default:
-            // strobing, four times a second
-            if (try_subtract_strobe_trigger(250)) {
-                brightness = (255);
-            } else {
-                brightness = (0);
-            }
-            break;
-    }
-
-    if (brightness != CircuitPlayground.strip.getBrightness()) {
-        // Update required - this will involve disabling interrupts
-        // while writing to the NeoPixels, so it will disrupt receiving messages
-        CircuitPlayground.strip.setBrightness(brightness);
-
-        // Lighting colour effects
-        if (phase <= 4) {
-            // yellow
-            for (i = 0; i < NUM_LEDS; i++) {
-                CircuitPlayground.strip.setPixelColor(i, 255, 255, 0);
-            }
-        } else if (phase <= 8) {
-            // white
-            for (i = 0; i < NUM_LEDS; i++) {
-                CircuitPlayground.strip.setPixelColor(i, 255, 255, 255);
-            }
-        } else {
-            if (pulse_time < (TOTAL_PULSE_TIME / 2)) {
-                // white
-                for (i = 0; i < NUM_LEDS; i++) {
-                    CircuitPlayground.strip.setPixelColor(i, 255, 255, 255);
-                }
-            } else {
-                // red
-                for (i = 0; i < NUM_LEDS; i++) {
-                    CircuitPlayground.strip.setPixelColor(i, 255, 0, 0);
-                }
-            }
-        }
-        digitalWrite(INT_PIN, HIGH);
-        CircuitPlayground.strip.show();
-        digitalWrite(INT_PIN, LOW);
+    // Lighting effects: the NeoPixels are only written when the colour changes
+    if (alarm_effects_update(running_time, &effects)) {
+        STRIP.fill(STRIP.Color(effects.red, effects.green, effects.blue));
+        pixels_lit = true;
+        show_pixels();
     }
 
     // Sound effects
-    uint32_t how_often = 0;
-    switch (phase) {
-        case 0:
-        case 1:
-        case 2:
-            // no sound
-            how_often = 0;
-            sound_trigger = 0;
-            break;
-        case 3:
-            how_often = 10000;
-            break;
-        case 4:
-            how_often = 5000;
-            break;
-        case 5:
-            how_often = 3000;
-            break;
-        case 6:
-            how_often = 2000;
-            break;
-        case 7:
-            how_often = 1000;
-            break;
-        case 8:
-            how_often = 500;
-            break;
-        case 9:
-            how_often = 200;
-            break;
-        default:
-            how_often = 100;
-            break;
-    }
-    if (phase >= 3) {
+    if (effects.sound) {
         CircuitPlayground.speaker.enable(allow_sound);
     }
-    if ((sound_trigger >= how_often) && (how_often > 0)) {
+    if (effects.tone) {
         CircuitPlayground.playTone(440, 20);
-        sound_trigger -= how_often;
     }
 }
 
 
 void loop()
 {
-    uint8_t previous_second = now_time.second();
-    now_time = rtc.now();
-
-    if (now_time.second() != previous_second) {
+    PROFILE_BEGIN(loop);
+    PROFILE_BEGIN(rtc);
+    bool new_second = update_now_time();
+    if (new_second) {
         // at the start of the minute, update the millisecond offset
         if (now_time.second() == 0) {
             millisecond_offset = millis();
         }
-        // Check for the alarm
-        alarm_active = alarm_update(now_time.hour(), now_time.minute());
-        update_alarm();
+        // Compensate for the drift of the RTC, one second at a time
+        int adjust = drift_update(now_time.unixtime());
+        if (adjust) {
+            now_time = now_time + TimeSpan(adjust);
+            rtc.adjust(now_time);
+        }
+        // Check for the alarm, unless no change is possible yet
+        if (alarm_update_due(now_time.dayOfTheWeek(), now_time.hour(), now_time.minute())) {
+            alarm_active = check_alarm();
+        }
+        // Run commands which were sent in advance
+        mail_run_deferred(now_time.hour(), now_time.minute());
+    }
+    PROFILE_END(rtc, PROFILE_RTC);
+
+    // Update the alarm frequently when active
+    PROFILE_BEGIN(alarm);
+    update_alarm();
+    PROFILE_END(alarm, PROFILE_ALARM);
+
+    if (new_second) {
+        PROFILE_BEGIN(display);
         update_display();
-    } else {
-        // Update the alarm frequently when active
-        update_alarm();
+        PROFILE_END(display, PROFILE_DISPLAY);
     }
 
     // These tasks run every time loop() is called
+    PROFILE_BEGIN(mail);
     mail_receive_messages();
+    PROFILE_END(mail, PROFILE_MAIL);
 
+    PROFILE_BEGIN(buttons);
     bool rightButton = CircuitPlayground.rightButton();
     bool leftButton = CircuitPlayground.leftButton();
 
@@ -502,14 +844,14 @@ void loop()
     if (rightButton) {
         // right button
         if (alarm_reset()) {
-            alarm_active = alarm_update(now_time.hour(), now_time.minute());
+            alarm_active = check_alarm();
             update_alarm();
         }
     }
     if (leftButton) {
         // left button - cancel / disable alarm
         if (alarm_unset()) {
-            alarm_active = alarm_update(now_time.hour(), now_time.minute());
+            alarm_active = check_alarm();
             update_alarm();
         }
     }
@@ -522,7 +864,12 @@ void loop()
             display_message("SOUND OFF");
         }
     }
+    PROFILE_END(buttons, PROFILE_BUTTONS);
+    PROFILE_END(loop, PROFILE_LOOP);
 
-    delay(PERIOD);
+#ifdef CONFIG_PROFILE
+    profile_serial();
+#endif
+    wait_for_event();
 }
 
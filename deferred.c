@@ -0,0 +1,173 @@
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+#include "nvram.h"
+#include "alarm.h"
+#include "deferred.h"
+
+#define HEADER_SIZE     2
+#define SIZE_SHIFT      5
+#define TIME_HI_MASK    7
+#define CHECK_VALUE     0x5d
+
+// Actions in order of their time of day, as stored in NVRAM. Each action has a
+// header: bits 7..5 are its size, and bits 2..0 and the next byte are the time
+// of day in minutes. A zero byte ends the queue, and the rest is zero.
+static uint8_t queue[DEFERRED_QUEUE_SIZE];
+
+
+static uint8_t entry_size(unsigned pos)
+{
+    return queue[pos] >> SIZE_SHIFT;
+}
+
+static uint16_t entry_time(unsigned pos)
+{
+    return ((uint16_t) (queue[pos] & TIME_HI_MASK) << 8) | (uint16_t) queue[pos + 1];
+}
+
+static unsigned queue_end(void)
+{
+    unsigned pos = 0;
+    while ((pos < DEFERRED_QUEUE_SIZE) && queue[pos]) {
+        pos += HEADER_SIZE + entry_size(pos);
+    }
+    return pos;
+}
+
+// Actions are commands which would otherwise be received by radio: garbage in
+// NVRAM must not be mistaken for them
+static uint8_t check_byte(void)
+{
+    uint8_t check = CHECK_VALUE;
+    unsigned i;
+
+    for (i = 0; i < DEFERRED_QUEUE_SIZE; i++) {
+        check = (uint8_t) ((check << 1) | (check >> 7)) ^ queue[i];
+    }
+    return check;
+}
+
+static int queue_valid(void)
+{
+    unsigned pos = 0;
+    uint16_t previous = 0;
+
+    while ((pos < DEFERRED_QUEUE_SIZE) && queue[pos]) {
+        uint8_t size = entry_size(pos);
+
+        if ((size == 0) || (size > DEFERRED_MAX_SIZE)
+        || (queue[pos] & ~((7 << SIZE_SHIFT) | TIME_HI_MASK))
+        || ((pos + HEADER_SIZE + size) > DEFERRED_QUEUE_SIZE)
+        || (entry_time(pos) >= WHOLE_DAY)
+        || (entry_time(pos) < previous)) {
+            return 0;
+        }
+        previous = entry_time(pos);
+        pos += HEADER_SIZE + size;
+    }
+    for (; pos < DEFERRED_QUEUE_SIZE; pos++) {
+        if (queue[pos]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void save_to_nvram(void)
+{
+    unsigned i;
+
+    for (i = 0; i < DEFERRED_QUEUE_SIZE; i++) {
+        nvram_write(NVRAM_DEFERRED_QUEUE + i, queue[i]);
+    }
+    nvram_write(NVRAM_DEFERRED_CHECK, check_byte());
+}
+
+int deferred_add(uint8_t hour, uint8_t minute, const uint8_t* action, uint8_t size)
+{
+    uint16_t time = ((uint16_t) hour * 60) + minute;
+    unsigned end = queue_end();
+    unsigned pos = 0;
+
+    if ((hour >= 24) || (minute >= 60) || (size == 0) || (size > DEFERRED_MAX_SIZE)
+    || ((end + HEADER_SIZE + size) > DEFERRED_QUEUE_SIZE)) {
+        return 0;
+    }
+    // Actions for the same time are run in the order they were received
+    while ((pos < end) && (entry_time(pos) <= time)) {
+        pos += HEADER_SIZE + entry_size(pos);
+    }
+    memmove(&queue[pos + HEADER_SIZE + size], &queue[pos], end - pos);
+    queue[pos] = (size << SIZE_SHIFT) | (time >> 8);
+    queue[pos + 1] = (uint8_t) time;
+    memcpy(&queue[pos + HEADER_SIZE], action, size);
+    save_to_nvram();
+    return 1;
+}
+
+void deferred_clear(void)
+{
+    memset(queue, 0, sizeof(queue));
+    save_to_nvram();
+}
+
+unsigned deferred_count(void)
+{
+    unsigned pos = 0;
+    unsigned count = 0;
+
+    while ((pos < DEFERRED_QUEUE_SIZE) && queue[pos]) {
+        pos += HEADER_SIZE + entry_size(pos);
+        count++;
+    }
+    return count;
+}
+
+uint8_t deferred_next(uint8_t now_hour, uint8_t now_minute, uint8_t* action)
+{
+    uint16_t now = ((uint16_t) now_hour * 60) + now_minute;
+    unsigned end = queue_end();
+    unsigned best = end;
+    uint16_t best_late = 0;
+    unsigned pos;
+    uint8_t size;
+
+    // The action which is most overdue. An action is due from its time until
+    // DEFERRED_LATE minutes later, so that it is not lost if the clock was off
+    // or was set forwards; actions which are missed entirely wait until the next day.
+    for (pos = 0; pos < end; pos += HEADER_SIZE + entry_size(pos)) {
+        uint16_t late = (now + WHOLE_DAY - entry_time(pos)) % WHOLE_DAY;
+        if ((late < DEFERRED_LATE) && ((best == end) || (late > best_late))) {
+            best = pos;
+            best_late = late;
+        }
+    }
+    if (best == end) {
+        return 0;
+    }
+
+    size = entry_size(best);
+    memset(action, 0, DEFERRED_MAX_SIZE);
+    memcpy(action, &queue[best + HEADER_SIZE], size);
+    memmove(&queue[best], &queue[best + HEADER_SIZE + size], end - best - HEADER_SIZE - size);
+    memset(&queue[end - HEADER_SIZE - size], 0, HEADER_SIZE + size);
+    save_to_nvram();
+    return size;
+}
+
+// Called during boot
+void deferred_init(void)
+{
+    unsigned i;
+
+    for (i = 0; i < DEFERRED_QUEUE_SIZE; i++) {
+        queue[i] = nvram_read(NVRAM_DEFERRED_QUEUE + i);
+    }
+    if ((nvram_read(NVRAM_DEFERRED_CHECK) != check_byte()) || !queue_valid()) {
+        // NVRAM was not initialised
+        deferred_clear();
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DEFERRED_MAX_SIZE       6       // bytes in an action, as in a packet payload
+#define DEFERRED_QUEUE_SIZE     12      // bytes of NVRAM; each action uses its size plus 2
+#define DEFERRED_LATE           10      // minutes; an action is run if it was missed by less
+#define DEFERRED_CLEAR          0xff    // hour in a message which removes every action
+
+// Called as a result of an incoming message. The action (a packet payload of
+// "size" bytes) is run at the next hour:minute, or at once if that time passed
+// less than DEFERRED_LATE minutes ago. Returns 0 if the parameters are invalid
+// or the queue is full.
+int deferred_add(uint8_t hour, uint8_t minute, const uint8_t* action, uint8_t size);
+
+// Called as a result of an incoming message. Every action is removed.
+void deferred_clear(void);
+
+// Number of actions waiting
+unsigned deferred_count(void);
+
+// Called once per second. If an action is due, it is removed from the queue and
+// copied to "action" (DEFERRED_MAX_SIZE bytes, padded with zeroes), and its size
+// is returned. Returns 0 if no action is due.
+uint8_t deferred_next(uint8_t now_hour, uint8_t now_minute, uint8_t* action);
+
+// Called during boot
+void deferred_init(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
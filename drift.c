@@ -0,0 +1,169 @@
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+#include "nvram.h"
+#include "drift.h"
+
+#define ONE_DAY         86400
+#define PPM_SCALE       10000000    // 1 second per PPM_SCALE seconds = 0.1 ppm
+#define MINUTE_MASK     0xffffff    // the sync time is stored in 24 bits
+#define NOT_SYNCED      MINUTE_MASK
+#define NO_ESTIMATE     INT16_MIN   // the drift has not been measured yet
+
+// Minute when the clock was last set, modulo 2^24 (about 31 years)
+static uint32_t sync_minute = NOT_SYNCED;
+
+// Estimated drift in units of 0.1 ppm
+static int16_t estimate = NO_ESTIMATE;
+
+// Seconds added by drift_update since sync_minute
+static int8_t applied = 0;
+
+// Seconds added by clock settings which were too soon after sync_minute for an estimate
+static int8_t manual = 0;
+
+
+
+static void save_to_nvram(void)
+{
+    nvram_write(NVRAM_DRIFT_SYNC + 0, sync_minute >> 16);
+    nvram_write(NVRAM_DRIFT_SYNC + 1, sync_minute >> 8);
+    nvram_write(NVRAM_DRIFT_SYNC + 2, sync_minute);
+    nvram_write(NVRAM_DRIFT_ESTIMATE + 0, (uint16_t) estimate >> 8);
+    nvram_write(NVRAM_DRIFT_ESTIMATE + 1, (uint16_t) estimate);
+    nvram_write(NVRAM_DRIFT_APPLIED, (uint8_t) applied);
+    nvram_write(NVRAM_DRIFT_MANUAL, (uint8_t) manual);
+}
+
+static void set_sync_time(uint32_t now)
+{
+    sync_minute = (now / 60) & MINUTE_MASK;
+    if (sync_minute == NOT_SYNCED) {
+        sync_minute--;
+    }
+    applied = 0;
+    manual = 0;
+}
+
+// Seconds since the clock was last set (to the nearest minute)
+static uint32_t seconds_since_sync(uint32_t now)
+{
+    return (((now / 60) - sync_minute) & MINUTE_MASK) * 60;
+}
+
+// Called when the clock is set.
+void drift_clock_set(uint32_t rtc_time, uint32_t new_time)
+{
+    // The 'T' message only includes the time of day, so the correction is modulo one day
+    int32_t correction = ((int32_t) (new_time - rtc_time)) % ONE_DAY;
+    int32_t total;
+    int64_t measured;
+    uint32_t elapsed;
+
+    if (correction > (ONE_DAY / 2)) {
+        correction -= ONE_DAY;
+    } else if (correction <= -(ONE_DAY / 2)) {
+        correction += ONE_DAY;
+    }
+    if ((sync_minute == NOT_SYNCED)
+    || (correction > DRIFT_MAX_CORRECTION) || (correction < -DRIFT_MAX_CORRECTION)) {
+        // Not drift: start measuring again from now
+        set_sync_time(new_time);
+        save_to_nvram();
+        return;
+    }
+
+    elapsed = seconds_since_sync(new_time);
+    total = (int32_t) manual + correction;
+    if (elapsed < DRIFT_MIN_INTERVAL) {
+        // Too soon to estimate the drift: remember the correction for next time
+        if ((total > DRIFT_MAX_APPLIED) || (total < -DRIFT_MAX_APPLIED)) {
+            set_sync_time(new_time);
+        } else {
+            manual = (int8_t) total;
+        }
+        save_to_nvram();
+        return;
+    }
+    total += (int32_t) applied;
+
+    // The drift during this interval is averaged with the previous estimate, if any
+    measured = ((int64_t) total * PPM_SCALE) / (int64_t) elapsed;
+    if (estimate != NO_ESTIMATE) {
+        measured = (measured + (int64_t) estimate) / 2;
+    }
+    if (measured > DRIFT_MAX_ESTIMATE) {
+        measured = DRIFT_MAX_ESTIMATE;
+    } else if (measured < -DRIFT_MAX_ESTIMATE) {
+        measured = -DRIFT_MAX_ESTIMATE;
+    }
+    estimate = (int16_t) measured;
+    set_sync_time(new_time);
+    save_to_nvram();
+}
+
+// Called once per second.
+int drift_update(uint32_t rtc_time)
+{
+    uint8_t second = rtc_time % 60;
+    int64_t expected;
+
+    if ((sync_minute == NOT_SYNCED) || (estimate == 0) || (estimate == NO_ESTIMATE)
+    || (second < DRIFT_ADJUST_FROM) || (second > DRIFT_ADJUST_TO)) {
+        return 0;
+    }
+
+    // Total adjustment which should have been made by now
+    expected = ((int64_t) seconds_since_sync(rtc_time) * estimate) / PPM_SCALE;
+    if ((expected > applied) && (applied < DRIFT_MAX_APPLIED)) {
+        applied++;
+        nvram_write(NVRAM_DRIFT_APPLIED, (uint8_t) applied);
+        return 1;
+    }
+    if ((expected < applied) && (applied > -DRIFT_MAX_APPLIED)) {
+        applied--;
+        nvram_write(NVRAM_DRIFT_APPLIED, (uint8_t) applied);
+        return -1;
+    }
+    return 0;
+}
+
+int16_t drift_get_estimate(void)
+{
+    return (estimate == NO_ESTIMATE) ? 0 : estimate;
+}
+
+int8_t drift_get_applied(void)
+{
+    return applied;
+}
+
+// Called during boot
+void drift_init(void)
+{
+    sync_minute = ((uint32_t) nvram_read(NVRAM_DRIFT_SYNC + 0) << 16)
+                | ((uint32_t) nvram_read(NVRAM_DRIFT_SYNC + 1) << 8)
+                | (uint32_t) nvram_read(NVRAM_DRIFT_SYNC + 2);
+    estimate = (int16_t) (((uint16_t) nvram_read(NVRAM_DRIFT_ESTIMATE + 0) << 8)
+                | (uint16_t) nvram_read(NVRAM_DRIFT_ESTIMATE + 1));
+    applied = (int8_t) nvram_read(NVRAM_DRIFT_APPLIED);
+    manual = (int8_t) nvram_read(NVRAM_DRIFT_MANUAL);
+
+    // applied and manual can't be above DRIFT_MAX_APPLIED, as it is INT8_MAX
+    if (((estimate != NO_ESTIMATE)
+        && ((estimate > DRIFT_MAX_ESTIMATE) || (estimate < -DRIFT_MAX_ESTIMATE)))
+    || (applied < -DRIFT_MAX_APPLIED) || (manual < -DRIFT_MAX_APPLIED)) {
+        sync_minute = NOT_SYNCED;
+    }
+    if (sync_minute == NOT_SYNCED) {
+        // NVRAM was not initialised
+        estimate = NO_ESTIMATE;
+        applied = 0;
+        manual = 0;
+    }
+    save_to_nvram();
+}
+
@@ -0,0 +1,37 @@
+#ifndef DRIFT_H
+#define DRIFT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DRIFT_MAX_CORRECTION    300     // seconds; a larger change is not drift (e.g. summer time)
+#define DRIFT_MIN_INTERVAL      86400   // seconds between clock settings for a new estimate
+#define DRIFT_MAX_ESTIMATE      5000    // units of 0.1 ppm
+#define DRIFT_MAX_APPLIED       127     // seconds; adjustments stop here until the clock is set
+#define DRIFT_ADJUST_FROM       10      // adjustments only happen between these seconds of the
+#define DRIFT_ADJUST_TO         50      // minute, so the minute never changes as a result
+
+// Called when the clock is set. rtc_time is the time from the RTC, and new_time
+// is the correct time, both in seconds (e.g. DateTime::unixtime).
+void drift_clock_set(uint32_t rtc_time, uint32_t new_time);
+
+// Called once per second. Returns the number of seconds to add to the RTC (-1, 0 or 1).
+int drift_update(uint32_t rtc_time);
+
+// Estimated drift in units of 0.1 ppm. Positive if the RTC is slow.
+int16_t drift_get_estimate(void);
+
+// Seconds added to the RTC since the clock was last set
+int8_t drift_get_applied(void);
+
+// Called during boot
+void drift_init(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,39 @@
+#ifndef FRAGMENT_H
+#define FRAGMENT_H
+
+#include "hmac433.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A logical payload which is too large for one packet is split into fragments.
+// Each fragment is an ordinary authenticated packet. The first payload byte is a
+// fragment header, and the remaining FRAGMENT_DATA_SIZE bytes carry the data:
+//
+//   bit 7      FRAGMENT_FLAG, always set (ordinary commands are ASCII)
+//   bit 6      FRAGMENT_LAST, set in the final fragment
+//   bits 5..4  tag, identifying the logical payload
+//   bits 3..0  fragment index, 0 for the first fragment
+//
+// Like any packet, a fragment is only authenticated if its counter is later than
+// that of the last packet received, so fragments must arrive in the order in
+// which they were sent; one received out of order is rejected. They are
+// reassembled by the receiver, and the logical payload is then processed as if
+// it were one packet.
+
+#define FRAGMENT_FLAG           0x80
+#define FRAGMENT_LAST           0x40
+#define FRAGMENT_TAG_SHIFT      4
+#define FRAGMENT_TAG_MASK       0x03
+#define FRAGMENT_INDEX_MASK     0x0f
+
+#define FRAGMENT_DATA_SIZE      (PACKET_PAYLOAD_SIZE - 1)
+#define FRAGMENT_MAX_COUNT      6
+#define FRAGMENT_MAX_PAYLOAD    (FRAGMENT_DATA_SIZE * FRAGMENT_MAX_COUNT)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
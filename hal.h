@@ -15,6 +15,7 @@ extern void nvram_write(uint8_t addr, uint8_t data);
 extern void display_message(const char* msg);
 extern void display_message_lp(const char* msg);
 extern uint32_t micros();
+extern uint32_t millis();
 extern void clock_set(uint8_t hour, uint8_t minute, uint8_t second);
 
 
@@ -72,8 +72,9 @@ class NCData(AbstractData):
         self.msg = msg
 
     def device_send(self, driver: tx433_driver.TX433_Driver) -> None:
-        print ("broadcast NC message at %s" % (time.asctime()))
-        driver.write_nc(self.msg[NC_HEADER_SIZE:])
+        version = 2 if self.msg.startswith(b"N2") else 1
+        print ("broadcast NC message (version %d) at %s" % (version, time.asctime()))
+        driver.write_nc(self.msg[NC_HEADER_SIZE:], version)
 
     def network_send(self, address: str, port: int) -> None:
         s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -139,8 +140,9 @@ class Server433(DatagramProtocol):
         send_to_timer_service = False
 
         if ((len(data_bytes) == (NC_DATA_SIZE + NC_HEADER_SIZE))
-        and data_bytes.startswith(b"NC")):
-            # New Code transmitted by txnc433/udp.c or home_easy.py
+        and (data_bytes.startswith(b"NC") or data_bytes.startswith(b"N2"))):
+            # New Code transmitted by txnc433/udp.c or home_easy.py.
+            # The "N2" header selects version 2 line coding.
             data = NCData(data_bytes)
 
         else:
@@ -11,17 +11,35 @@
 #include "nvram.h"
 #include "alarm.h"
 #include "night_day_time.h"
+#include "fragment.h"
+#include "drift.h"
+#include "deferred.h"
+#include "packed.h"
 
 #include "secret.h"
 
+#define REASSEMBLY_BUFFERS  2
+#define REASSEMBLY_TIMEOUT  60000       // milliseconds
+
+typedef struct reassembly_s {
+    uint8_t     in_use;
+    uint8_t     tag;
+    uint8_t     received;       // one bit for each fragment received
+    uint8_t     count;          // number of fragments, 0 until the last fragment is received
+    uint32_t    start_time;     // millis() when the first fragment was received
+    uint64_t    first_counter;  // HMAC counter after the first fragment was received
+    uint8_t     payload[FRAGMENT_MAX_PAYLOAD];
+} reassembly_t;
+
 static uint64_t hmac_message_counter = 0;
 static hmac433_packet_t previous_packet;
+static reassembly_t reassembly[REASSEMBLY_BUFFERS];
 
 static void save_counter(void)
 {
     // Which counter is currently valid? Save in the other one
-    uint8_t new_state = nvram_read(NVRAM_STATE_ADDR) ^ 1;
-    uint8_t new_counter_addr = (new_state & 1) ? NVRAM_COUNTER_1_ADDR : NVRAM_COUNTER_0_ADDR;
+    uint8_t new_state = nvram_read(NVRAM_STATE_ADDR) ^ NVRAM_STATE_COUNTER;
+    uint8_t new_counter_addr = (new_state & NVRAM_STATE_COUNTER) ? NVRAM_COUNTER_1_ADDR : NVRAM_COUNTER_0_ADDR;
     size_t i;
     for (i = 0; i < 8; i++) {
         nvram_write(i + new_counter_addr, ((uint8_t*) &hmac_message_counter)[i]);
@@ -30,6 +48,22 @@ static void save_counter(void)
     nvram_write(NVRAM_STATE_ADDR, new_state);
 }
 
+// Settings which were added to NVRAM later (see NVRAM_STATE_LAYOUT)
+static void erase_settings(uint8_t from, uint8_t to)
+{
+    uint8_t addr;
+    for (addr = from; addr < to; addr++) {
+        nvram_write(addr, 0xff);
+    }
+}
+
+static void erase_new_settings(void)
+{
+    erase_settings(NVRAM_SCHEDULE_BASE, NVRAM_ALT_WEEKDAYS);
+    erase_settings(NVRAM_ALT_WEEKDAYS, NVRAM_DRIFT_SYNC);
+    erase_settings(NVRAM_DRIFT_SYNC, NVRAM_DEFERRED_CHECK);
+}
+
 int mail_init(void)
 {
     uint8_t state;
@@ -43,11 +77,12 @@ int mail_init(void)
     state = nvram_read(NVRAM_STATE_ADDR);
     if ((nvram_read(NVRAM_CHECK_BYTE_1_ADDR) != CHECK_BYTE_1_VALUE)
     || (nvram_read(NVRAM_CHECK_BYTE_2_ADDR) != CHECK_BYTE_2_VALUE)
-    || (state > 1)) {
+    || ((state & NVRAM_STATE_LAYOUT_MASK) > NVRAM_STATE_LAYOUT)) {
         // nvram is garbage - reformat
+        erase_new_settings();
         nvram_write(NVRAM_CHECK_BYTE_1_ADDR, CHECK_BYTE_1_VALUE);
         nvram_write(NVRAM_CHECK_BYTE_2_ADDR, CHECK_BYTE_2_VALUE);
-        nvram_write(NVRAM_STATE_ADDR, 0);
+        nvram_write(NVRAM_STATE_ADDR, NVRAM_STATE_LAYOUT);
         // check this worked
         if ((nvram_read(NVRAM_CHECK_BYTE_1_ADDR) == CHECK_BYTE_1_VALUE)
         && (nvram_read(NVRAM_CHECK_BYTE_2_ADDR) == CHECK_BYTE_2_VALUE)) {
@@ -61,8 +96,13 @@ int mail_init(void)
         }
     } else {
         // load counter
-        uint8_t counter_addr = (state & 1) ? NVRAM_COUNTER_1_ADDR : NVRAM_COUNTER_0_ADDR;
+        uint8_t counter_addr = (state & NVRAM_STATE_COUNTER) ? NVRAM_COUNTER_1_ADDR : NVRAM_COUNTER_0_ADDR;
         size_t i;
+        if ((state & NVRAM_STATE_LAYOUT_MASK) != NVRAM_STATE_LAYOUT) {
+            // written by an older version: its settings are kept, and the new ones are cleared
+            erase_new_settings();
+            nvram_write(NVRAM_STATE_ADDR, (state & NVRAM_STATE_COUNTER) | NVRAM_STATE_LAYOUT);
+        }
         for (i = 0; i < 8; i++) {
             ((uint8_t*) &hmac_message_counter)[i] = nvram_read(i + counter_addr);
         }
@@ -78,11 +118,11 @@ static void new_home_easy_message(uint32_t msg)
 }
 
 
-static void show_message(const uint8_t* payload)
+static void show_message(const uint8_t* payload, size_t payload_size)
 {
-    char tmp[16];
-    memcpy(tmp, &payload[1], PACKET_PAYLOAD_SIZE - 1);
-    tmp[PACKET_PAYLOAD_SIZE - 1] = '\0';
+    char tmp[FRAGMENT_MAX_PAYLOAD];
+    memcpy(tmp, &payload[1], payload_size - 1);
+    tmp[payload_size - 1] = '\0';
     display_message(tmp);
 }
 
@@ -100,16 +140,123 @@ static void show_counter(uint64_t counter_copy, int rs_rc)
     display_message(tmp);
 }
 
-static void new_packet(const uint8_t* payload, int rs_rc)
+static void show_drift(void)
+{
+    char tmp[32];
+    int16_t estimate = drift_get_estimate();
+    unsigned magnitude = (estimate < 0) ? -estimate : estimate;
+
+    snprintf(tmp, sizeof(tmp), "DRIFT %c%u.%u PPM\nADJUST %d S",
+                (estimate < 0) ? '-' : '+', magnitude / 10, magnitude % 10,
+                (int) drift_get_applied());
+    display_message(tmp);
+}
+
+// Each packed command: the ordinary command, then the size of each field in bits
+static const uint8_t packed_commands[][PACKET_PAYLOAD_SIZE] = {
+    [PACKED_TIME] = {'T', PACKED_HOUR_BITS, PACKED_MINUTE_BITS, PACKED_SECOND_BITS},
+    [PACKED_ALARM] = {'A', PACKED_HOUR_BITS, PACKED_MINUTE_BITS},
+    [PACKED_NIGHT_DAY] = {'N', PACKED_HOUR_BITS, PACKED_MINUTE_BITS,
+                          PACKED_HOUR_BITS, PACKED_MINUTE_BITS},
+};
+
+static void new_packet(const uint8_t* payload, size_t payload_size, int rs_rc);
+
+// Read a bit field from a packed payload, most significant bit first
+static uint8_t packed_read(const uint8_t* payload, unsigned* pos, uint8_t bits)
+{
+    uint8_t value = 0;
+
+    for (; bits > 0; bits--, (*pos)++) {
+        value = (value << 1) | ((payload[*pos >> 3] >> (7 - (*pos & 7))) & 1);
+    }
+    return value;
+}
+
+// Several commands in one payload (see packed.h): each one is unpacked
+// and then handled as if it had been received alone
+static void new_packed(const uint8_t* payload, size_t payload_size, int rs_rc)
+{
+    unsigned pos = 8;
+    unsigned end = payload_size * 8;
+
+    while ((pos + PACKED_CODE_BITS) <= end) {
+        uint8_t action[PACKET_PAYLOAD_SIZE];
+        uint8_t code = packed_read(payload, &pos, PACKED_CODE_BITS);
+        const uint8_t* fields = packed_commands[code];
+        size_t i;
+
+        if (code == PACKED_END) {
+            return;
+        }
+        memset(action, 0, sizeof(action));
+        action[0] = fields[0];
+        for (i = 1; (i < PACKET_PAYLOAD_SIZE) && fields[i]; i++) {
+            if ((pos + fields[i]) > end) {
+                display_message("PACKED ERROR");
+                return;
+            }
+            action[i] = packed_read(payload, &pos, fields[i]);
+        }
+        if ((action[0] == 'A') && (action[1] == PACKED_UNSET_HOUR)) {
+            action[0] = 'a';
+        }
+        new_packet(action, PACKET_PAYLOAD_SIZE, rs_rc);
+    }
+}
+
+// Size of each action which may be deferred, including the action byte.
+// Not 'T': the time would be out of date when it runs.
+static uint8_t action_size(uint8_t action)
+{
+    switch (action) {
+        case 'A':   return 3;
+        case 'N':   return 6;
+        case 'S':   return 5;
+        case 'a':   return 1;
+        default:    return 0;
+    }
+}
+
+static void new_deferred(const uint8_t* payload, size_t payload_size)
+{
+    char tmp[32];
+    uint8_t size = action_size(payload[3]);
+
+    if (payload[1] == DEFERRED_CLEAR) {
+        deferred_clear();
+        display_message("DEFERRED\nCLEAR");
+        return;
+    }
+    if ((payload[1] >= 24) || (payload[2] >= 60) || (size == 0) || ((size + 3) > payload_size)) {
+        display_message("DEFER ERROR");
+        return;
+    }
+    if (!deferred_add(payload[1], payload[2], &payload[3], size)) {
+        display_message("DEFER FULL");
+        return;
+    }
+    snprintf(tmp, sizeof(tmp), "DEFERRED %02u:%02u\n%u WAITING",
+                (unsigned) payload[1], (unsigned) payload[2], deferred_count());
+    display_message(tmp);
+}
+
+// The payload buffer always has at least PACKET_PAYLOAD_SIZE bytes, padded with zeroes
+static void new_packet(const uint8_t* payload, size_t payload_size, int rs_rc)
 {
     switch (payload[0]) {
         case 'M':
             // message for the screen
-            show_message(payload);
+            show_message(payload, payload_size);
             break;
         case 'C':
-            // show counter
-            show_counter(hmac_message_counter, rs_rc);
+            if (payload[1] == 'D') {
+                // show RTC drift estimate
+                show_drift();
+            } else {
+                // show counter
+                show_counter(hmac_message_counter, rs_rc);
+            }
             break;
         case 'T':
             // set time
@@ -120,25 +267,103 @@ static void new_packet(const uint8_t* payload, int rs_rc)
             alarm_set(payload[1], payload[2]);
             break;
         case 'N':
-            // set night and day time 
-            night_day_time_set(payload[1], payload[2], payload[3], payload[4]);
+            // set night and day time, optionally for some weekdays only
+            night_day_time_set(payload[1], payload[2], payload[3], payload[4], payload[5]);
+            break;
+        case 'S':
+            // set scheduled alarm: slot, hour, minute, weekdays
+            alarm_schedule_set(payload[1], payload[2], payload[3], payload[4]);
             break;
         case 'a':
             // unset alarm, and cancel if it's active
             // same as pressing the left button
             alarm_unset();
             break;
+        case 'D':
+            // deferred action: hour, minute, then the action
+            new_deferred(payload, payload_size);
+            break;
+        case PACKED_COMMANDS:
+            // several commands in one packet
+            new_packed(payload, payload_size, rs_rc);
+            break;
         default:
             display_message("ACTION ERROR");
             break;
     }
 }
 
+static void new_fragment(const uint8_t* payload, int rs_rc)
+{
+    uint8_t     tag = (payload[0] >> FRAGMENT_TAG_SHIFT) & FRAGMENT_TAG_MASK;
+    uint8_t     index = payload[0] & FRAGMENT_INDEX_MASK;
+    uint32_t    now = millis();
+    reassembly_t* r = NULL;
+    size_t      i;
+
+    if (index >= FRAGMENT_MAX_COUNT) {
+        display_message("FRAGMENT ERROR");
+        return;
+    }
+
+    // Discard incomplete messages which have timed out, or which can no longer
+    // be completed because the counter has moved on (millis() wraps eventually)
+    for (i = 0; i < REASSEMBLY_BUFFERS; i++) {
+        if (reassembly[i].in_use
+        && (((now - reassembly[i].start_time) > REASSEMBLY_TIMEOUT)
+            || ((hmac_message_counter - reassembly[i].first_counter) >= FRAGMENT_MAX_COUNT))) {
+            reassembly[i].in_use = 0;
+        }
+    }
+
+    // Find the message this fragment belongs to. The fragments of one
+    // message are sent together, so their counter values are close.
+    for (i = 0; i < REASSEMBLY_BUFFERS; i++) {
+        if (reassembly[i].in_use
+        && (reassembly[i].tag == tag)
+        && ((hmac_message_counter - reassembly[i].first_counter) < FRAGMENT_MAX_COUNT)
+        && !(reassembly[i].received & (1 << index))) {
+            r = &reassembly[i];
+            break;
+        }
+    }
+
+    if (!r) {
+        // Start of a new message: use a free buffer, or else replace the oldest
+        r = &reassembly[0];
+        for (i = 0; i < REASSEMBLY_BUFFERS; i++) {
+            if (!reassembly[i].in_use) {
+                r = &reassembly[i];
+                break;
+            }
+            if ((now - reassembly[i].start_time) > (now - r->start_time)) {
+                r = &reassembly[i];
+            }
+        }
+        memset(r, 0, sizeof(reassembly_t));
+        r->in_use = 1;
+        r->tag = tag;
+        r->start_time = now;
+        r->first_counter = hmac_message_counter;
+    }
+
+    memcpy(&r->payload[index * FRAGMENT_DATA_SIZE], &payload[1], FRAGMENT_DATA_SIZE);
+    r->received |= 1 << index;
+    if (payload[0] & FRAGMENT_LAST) {
+        r->count = index + 1;
+    }
+
+    if (r->count && (r->received == ((1 << r->count) - 1))) {
+        // All fragments received
+        r->in_use = 0;
+        new_packet(r->payload, r->count * FRAGMENT_DATA_SIZE, rs_rc);
+    }
+}
+
 void mail_receive_messages(void)
 {
     uint32_t    copy_home_easy = 0;
-    uint8_t     copy_new_code[NC_DATA_SIZE];
-    uint8_t     copy_new_code_ready = 0;
+    const uint8_t* new_code = NULL;
     hmac433_packet_t packet;
     int         rs_rc;
 
@@ -149,9 +374,9 @@ void mail_receive_messages(void)
         rx433_home_easy = 0;
     }
     if (rx433_new_code_ready) {
-        memcpy(copy_new_code, (const uint8_t*) rx433_new_code, NC_DATA_SIZE);
+        // The packed symbols are ours until the next new code is taken
+        new_code = rx433_new_code;
         rx433_new_code_ready = 0;
-        copy_new_code_ready = 1;
     }
     enable_interrupts();
 
@@ -160,14 +385,14 @@ void mail_receive_messages(void)
         new_home_easy_message(copy_home_easy);
     }
 
-    if (!copy_new_code_ready) {
+    if (!new_code) {
         // No messages
         return;
     }
 
     // Process new code
     // Reed Solomon decoding
-    rs_rc = ncrs_decode((uint8_t*) &packet, copy_new_code);
+    rs_rc = ncrs_decode_packed((uint8_t*) &packet, new_code);
     if (rs_rc <= 0) {
         // display_message("RS ERROR");
         return;
@@ -193,9 +418,23 @@ void mail_receive_messages(void)
     if (packet.counter_resync_flag) {
         // There is no payload - we just update the counter
         display_message_lp("COUNTER\nRESYNCHED");
+    } else if (packet.payload[0] & FRAGMENT_FLAG) {
+        // part of a larger payload
+        new_fragment(packet.payload, rs_rc);
     } else {
         // process packet payload
-        new_packet(packet.payload, rs_rc);
+        new_packet(packet.payload, PACKET_PAYLOAD_SIZE, rs_rc);
     }
 }
 
+
+// Called once per second: run the actions which were sent in advance
+void mail_run_deferred(uint8_t now_hour, uint8_t now_minute)
+{
+    uint8_t action[DEFERRED_MAX_SIZE];
+    uint8_t size;
+
+    while ((size = deferred_next(now_hour, now_minute, action)) != 0) {
+        new_packet(action, size, 0);
+    }
+}
@@ -9,6 +9,7 @@ extern "C" {
 #endif
 
 void mail_receive_messages(void);
+void mail_run_deferred(uint8_t now_hour, uint8_t now_minute);
 int mail_init(void);
 
 #ifdef __cplusplus
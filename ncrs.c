@@ -10,10 +10,6 @@
 #include "ncrs.h"
 #include "hal.h"
 
-#define NROOTS          (10)    // 10 parity symbols
-#define GFPOLY          (0x25)  // Reed Solomon Galois field polynomial
-#define FCR             (1)     // First Consecutive Root
-#define PRIM            (1)     // Primitive Element
 #define PAD             (0)     // No padding
 
 #define MAX_SHIFT_DISTANCE (3)
@@ -30,33 +26,77 @@ int ncrs_init(void)
     return 1;
 }
 
+uint8_t ncrs_symbol(const uint8_t *packed_message, unsigned index)
+{
+    unsigned pos = index * SYMBOL_SIZE;
+    uint16_t bits = ((uint16_t) packed_message[pos >> 3] << 8) | (uint16_t) packed_message[(pos >> 3) + 1];
+
+    return (bits >> (16 - SYMBOL_SIZE - (pos & 7))) & ((1 << SYMBOL_SIZE) - 1);
+}
+
+void ncrs_pack(uint8_t *packed_message, const uint8_t *symbols)
+{
+    size_t i;
+
+    memset(packed_message, 0, RX433_PACKED_SIZE);
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        unsigned pos = i * SYMBOL_SIZE;
+        uint16_t bits = (uint16_t) (symbols[i] & ((1 << SYMBOL_SIZE) - 1)) << (16 - SYMBOL_SIZE - (pos & 7));
+
+        packed_message[pos >> 3] |= bits >> 8;
+        packed_message[(pos >> 3) + 1] |= (uint8_t) bits;
+    }
+}
+
+void ncrs_unpack(uint8_t *symbols, const uint8_t *packed_message)
+{
+    size_t i;
+
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        symbols[i] = ncrs_symbol(packed_message, i);
+    }
+}
+
+// Symbol i of a packed message, or zero beyond the ends (for shift attempts)
+static uint8_t shifted_symbol(const uint8_t *packed_message, int i)
+{
+    if ((i < 0) || (i >= NC_DATA_SIZE)) {
+        return 0;
+    }
+    return ncrs_symbol(packed_message, (unsigned) i);
+}
+
 int ncrs_decode(uint8_t *original_message, const uint8_t *encoded_message)
 {
-    uint8_t padded_message[(MAX_SHIFT_DISTANCE * 2) + NC_DATA_SIZE];
+    uint8_t packed_message[RX433_PACKED_SIZE];
+
+    ncrs_pack(packed_message, encoded_message);
+    return ncrs_decode_packed(original_message, packed_message);
+}
+
+int ncrs_decode_packed(uint8_t *original_message, const uint8_t *packed_message)
+{
     uint8_t data[MSG_SYMBOLS];
     uint16_t parity[NROOTS];
     size_t i, j, k, shift_attempt;
     int corrections = -1;
-
-    // pad message with zeroes (for shift attempts)
-    memset(padded_message, 0, sizeof(padded_message));
-    memcpy(&padded_message[MAX_SHIFT_DISTANCE], encoded_message, NC_DATA_SIZE);
+    int m;
 
     for (shift_attempt = 0; shift_attempt <= (MAX_SHIFT_DISTANCE * 2); shift_attempt++) {
         // Determine how far to shift
         if (shift_attempt % 2) {
-            i = MAX_SHIFT_DISTANCE + (shift_attempt / 2); // Shifting left (losing symbols from beginning)
+            m = (int) (shift_attempt / 2); // Shifting left (losing symbols from beginning)
         } else {
-            i = MAX_SHIFT_DISTANCE - (shift_attempt / 2); // Shifting right (losing symbols from end)
+            m = - (int) (shift_attempt / 2); // Shifting right (losing symbols from end)
         }
 
-        // Copy interleaved data and parity, applying shift
-        for (j = 0; j < (NROOTS * 2); i += 3, j += 2) {
-            data[j + 0] = padded_message[i + 0];
-            data[j + 1] = padded_message[i + 1];
-            parity[j / 2] = padded_message[i + 2];
+        // Read interleaved data and parity from the packed symbols, applying shift
+        for (j = 0; j < (NROOTS * 2); m += 3, j += 2) {
+            data[j + 0] = shifted_symbol(packed_message, m + 0);
+            data[j + 1] = shifted_symbol(packed_message, m + 1);
+            parity[j / 2] = shifted_symbol(packed_message, m + 2);
         }
-        data[j] = padded_message[i];   // last data symbol
+        data[j] = shifted_symbol(packed_message, m);   // last data symbol
 
         // Attempt decoding
         corrections = decode_rs8(rs, data, parity, MSG_SYMBOLS, NULL, 0, NULL, 0, NULL);
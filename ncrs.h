@@ -11,11 +11,24 @@ extern "C" {
 
 #define MSG_SYMBOLS         (21)    // 21 message symbols
 
+// Reed Solomon code, as passed to init_rs (see rslib.h)
+#define NROOTS              (10)    // 10 parity symbols
+#define GFPOLY              (0x25)  // Reed Solomon Galois field polynomial
+#define FCR                 (1)     // First Consecutive Root
+#define PRIM                (1)     // Primitive Element
+
 #define DECODED_DATA_BITS   (MSG_SYMBOLS * SYMBOL_SIZE)
 #define DECODED_DATA_BYTES  ((DECODED_DATA_BITS + 7) / 8)
 
 int ncrs_init(void);
 int ncrs_decode(uint8_t *original_message, const uint8_t *encoded_message);
+// As ncrs_decode, but the message is RX433_PACKED_SIZE bytes of packed symbols (see rx433.h)
+int ncrs_decode_packed(uint8_t *original_message, const uint8_t *packed_message);
+// Symbol "index" (0 .. NC_DATA_SIZE - 1) of packed symbols
+uint8_t ncrs_symbol(const uint8_t *packed_message, unsigned index);
+// Convert NC_DATA_SIZE symbols, one per byte, to and from packed symbols
+void ncrs_pack(uint8_t *packed_message, const uint8_t *symbols);
+void ncrs_unpack(uint8_t *symbols, const uint8_t *packed_message);
 void ncrs_encode(uint8_t *encoded_message, const uint8_t *original_message);
 
 #ifdef __cplusplus
@@ -11,23 +11,56 @@
 static uint16_t start_night_time = 0; // In minutes. Midnight = 0, Midday = 720, 11pm = 1380
 static uint16_t start_day_time = 0;
 
+// Alternative night and day times, used on the weekdays in alt_weekdays (bit 0 = Sunday)
+static uint16_t alt_start_night_time = 0;
+static uint16_t alt_start_day_time = 0;
+static uint8_t alt_weekdays = 0;
+
+// The result of night_day_time_test does not change between cache_from and cache_until.
+// These are minutes since Sunday 00:00.
+static uint16_t cache_from = 0;
+static uint16_t cache_until = 0;
+static int cache_is_night = 0;
+
 
 
 static void save_to_nvram()
 {
+    uint32_t alt = ((uint32_t) (alt_start_night_time & 0x7ff) << 11)
+                 | (uint32_t) (alt_start_day_time & 0x7ff);
+
     nvram_write(NVRAM_NIGHT_TIME_HI, start_night_time >> 8);
     nvram_write(NVRAM_NIGHT_TIME_LO, start_night_time);
     nvram_write(NVRAM_DAY_TIME_HI, start_day_time >> 8);
     nvram_write(NVRAM_DAY_TIME_LO, start_day_time);
+    nvram_write(NVRAM_ALT_WEEKDAYS, alt_weekdays);
+    nvram_write(NVRAM_ALT_TIMES + 0, alt >> 16);
+    nvram_write(NVRAM_ALT_TIMES + 1, alt >> 8);
+    nvram_write(NVRAM_ALT_TIMES + 2, alt);
 }
 
 // Called as a result of an incoming message.
 void night_day_time_set(uint8_t start_night_hour, uint8_t start_night_minute,
-                        uint8_t start_day_hour, uint8_t start_day_minute)
+                        uint8_t start_day_hour, uint8_t start_day_minute,
+                        uint8_t weekdays)
 {
     char tmp[16];
-    start_night_time = (start_night_hour * 60) + start_night_minute;
-    start_day_time = (start_day_hour * 60) + start_day_minute;
+    uint16_t night = (start_night_hour * 60) + start_night_minute;
+    uint16_t day = (start_day_hour * 60) + start_day_minute;
+
+    weekdays &= ALARM_EVERY_DAY;
+    if ((weekdays == 0) || (weekdays == ALARM_EVERY_DAY)) {
+        // Same times every day
+        start_night_time = night;
+        start_day_time = day;
+        alt_weekdays = 0;
+    } else {
+        // Different times on some days
+        alt_start_night_time = night;
+        alt_start_day_time = day;
+        alt_weekdays = weekdays;
+    }
+    cache_from = cache_until = 0;
     snprintf(tmp, sizeof(tmp), "%02d:%02d..%02d:%02d",
             start_night_hour, start_night_minute,
             start_day_hour, start_day_minute);
@@ -36,29 +69,65 @@ void night_day_time_set(uint8_t start_night_hour, uint8_t start_night_minute,
 }
 
 // Returns 1 if it is night time
-int night_day_time_test(uint8_t now_hour, uint8_t now_minute)
+int night_day_time_test(uint8_t weekday, uint8_t now_hour, uint8_t now_minute)
 {
     uint16_t now_time = (now_hour * 60) + now_minute;
+    uint16_t week_time = ((weekday % 7) * WHOLE_DAY) + now_time;
+    uint16_t night, day, until;
+
+    if ((week_time >= cache_from) && (week_time < cache_until)) {
+        // No transition since the last call
+        return cache_is_night;
+    }
 
-    if (start_day_time == start_night_time) {
+    if (alt_weekdays & (1 << (weekday % 7))) {
+        night = alt_start_night_time;
+        day = alt_start_day_time;
+    } else {
+        night = start_night_time;
+        day = start_day_time;
+    }
+
+    if (day == night) {
         // permanent night time
-        return 1;
-    } else if (start_day_time < start_night_time) {
+        cache_is_night = 1;
+    } else if (day < night) {
         // e.g. day at 7am night at 11pm
-        return (now_time < start_day_time) || (now_time >= start_night_time);
+        cache_is_night = (now_time < day) || (now_time >= night);
     } else {
         // e.g. day at 9am night at 1am
-        return (now_time >= start_night_time) && (now_time < start_day_time);
+        cache_is_night = (now_time >= night) && (now_time < day);
+    }
+
+    // The result is the same until the next transition, or until the end
+    // of the day, as the times may be different tomorrow
+    until = WHOLE_DAY;
+    if ((night > now_time) && (night < until)) {
+        until = night;
+    }
+    if ((day > now_time) && (day < until)) {
+        until = day;
     }
+    cache_from = week_time;
+    cache_until = week_time + (until - now_time);
+    return cache_is_night;
 }
 
 // Called during boot
 void night_day_time_init(void)
 {
+    uint32_t alt;
+
     start_night_time =
         ((uint16_t) nvram_read(NVRAM_NIGHT_TIME_HI) << 8) | (uint16_t) nvram_read(NVRAM_NIGHT_TIME_LO);
     start_day_time =
         ((uint16_t) nvram_read(NVRAM_DAY_TIME_HI) << 8) | (uint16_t) nvram_read(NVRAM_DAY_TIME_LO);
+    alt_weekdays = nvram_read(NVRAM_ALT_WEEKDAYS);
+    alt = ((uint32_t) nvram_read(NVRAM_ALT_TIMES + 0) << 16)
+        | ((uint32_t) nvram_read(NVRAM_ALT_TIMES + 1) << 8)
+        | (uint32_t) nvram_read(NVRAM_ALT_TIMES + 2);
+    alt_start_night_time = (alt >> 11) & 0x7ff;
+    alt_start_day_time = alt & 0x7ff;
 
     if (start_night_time >= WHOLE_DAY) {
         start_night_time = 0;
@@ -66,6 +135,13 @@ void night_day_time_init(void)
     if (start_day_time >= WHOLE_DAY) {
         start_day_time = 0;
     }
+    if ((alt_start_night_time >= WHOLE_DAY)
+    || (alt_start_day_time >= WHOLE_DAY)
+    || (alt_weekdays & ~ALARM_EVERY_DAY)) {
+        alt_start_night_time = alt_start_day_time = 0;
+        alt_weekdays = 0;
+    }
+    cache_from = cache_until = 0;
     save_to_nvram();
 }
 
@@ -9,12 +9,16 @@ extern "C" {
 #endif
 
 
-// Called as a result of an incoming message.
+// Called as a result of an incoming message. If weekdays is 0 (or every day),
+// the times apply to every day. Otherwise they apply only to the days in the
+// weekdays mask (bit 0 = Sunday), replacing any previous times for other weekdays.
 void night_day_time_set(uint8_t start_night_hour, uint8_t start_night_minute,
-                        uint8_t start_day_hour, uint8_t start_day_minute);
+                        uint8_t start_day_hour, uint8_t start_day_minute,
+                        uint8_t weekdays);
 
-// Returns 1 if it is night time
-int night_day_time_test(uint8_t now_hour, uint8_t now_minute);
+// Returns 1 if it is night time. The weekday is 0 for Sunday.
+// The result is cached until the next transition, so repeated calls are cheap.
+int night_day_time_test(uint8_t weekday, uint8_t now_hour, uint8_t now_minute);
 
 // Called during boot
 void night_day_time_init(void);
@@ -5,6 +5,14 @@
 #define CHECK_BYTE_1_VALUE      0xae
 #define CHECK_BYTE_2_VALUE      0xc2
 
+// NVRAM_STATE_ADDR: bit 0 selects the valid counter, and the other bits are the
+// layout of the settings after NVRAM_DAY_TIME_LO. Clocks which did not use those
+// bytes left the bits at 0; the bytes may contain anything, so mail_init sets them
+// to 0xff (which each module reads as "not set") before changing the layout.
+#define NVRAM_STATE_COUNTER     0x01
+#define NVRAM_STATE_LAYOUT_MASK 0xfe
+#define NVRAM_STATE_LAYOUT      0x02
+
 #define NVRAM_COUNTER_0_ADDR    0x00
 #define NVRAM_COUNTER_1_ADDR    0x08
 #define NVRAM_CHECK_BYTE_1_ADDR 0x10
@@ -17,6 +25,16 @@
 #define NVRAM_NIGHT_TIME_LO     0x17
 #define NVRAM_DAY_TIME_HI       0x18
 #define NVRAM_DAY_TIME_LO       0x19
+#define NVRAM_SCHEDULE_BASE     0x1a    // scheduled alarms 1 .. ALARM_SCHEDULE_SIZE - 1
+#define NVRAM_SCHEDULE_ENTRY_SIZE 3
+#define NVRAM_ALT_WEEKDAYS      0x20    // weekdays using the alternative night and day times
+#define NVRAM_ALT_TIMES         0x21    // 3 bytes: alternative night and day times (11 bits each)
+#define NVRAM_DRIFT_SYNC        0x24    // 3 bytes: minute when the clock was last set
+#define NVRAM_DRIFT_ESTIMATE    0x27    // 2 bytes: drift estimate (0.1 ppm units)
+#define NVRAM_DRIFT_APPLIED     0x29    // seconds added since the clock was last set
+#define NVRAM_DRIFT_MANUAL      0x2a    // seconds corrected since the clock was last set
+#define NVRAM_DEFERRED_CHECK    0x2b    // check byte for the deferred actions
+#define NVRAM_DEFERRED_QUEUE    0x2c    // 12 bytes: deferred actions (to the end of NVRAM)
 
 #endif
 
@@ -0,0 +1,34 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Several short commands can be sent in one packet. The payload begins with
+// PACKED_COMMANDS, and the rest is a list of bit fields, most significant bit
+// first. Each command is a code of PACKED_CODE_BITS followed by its fields:
+//
+//   PACKED_TIME        hour, minute, second: as 'T'
+//   PACKED_ALARM       hour, minute: as 'A', or as 'a' if the hour is PACKED_UNSET_HOUR
+//   PACKED_NIGHT_DAY   night hour, minute, day hour, minute: as 'N' for every day
+//
+// PACKED_END, or the end of the payload, ends the list. The commands are run
+// in order. A list which does not fit in one packet is sent as fragments.
+
+#define PACKED_COMMANDS         'P'
+#define PACKED_CODE_BITS        2
+#define PACKED_END              0
+#define PACKED_TIME             1
+#define PACKED_ALARM            2
+#define PACKED_NIGHT_DAY        3
+#define PACKED_HOUR_BITS        5
+#define PACKED_MINUTE_BITS      6
+#define PACKED_SECOND_BITS      6
+#define PACKED_UNSET_HOUR       31
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
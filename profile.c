@@ -0,0 +1,122 @@
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hal.h"
+#include "profile.h"
+
+#ifdef CONFIG_PROFILE
+
+typedef struct histogram_s {
+    uint32_t    count;
+    uint32_t    max;
+    uint64_t    total;
+    uint16_t    bucket[PROFILE_BUCKETS];
+} histogram_t;
+
+static histogram_t histogram[PROFILE_COUNT];
+
+// Set while a reset or dump is in progress, so that their own critical
+// sections (and anything else at that time) are not sampled
+static volatile uint8_t profile_busy = 0;
+
+
+
+// Number of significant bits, without a division or a CLZ instruction (not on the Cortex-M0+)
+static uint8_t bucket_for(uint32_t cycles)
+{
+    uint8_t bits = 0;
+
+    if (cycles >> 16) {
+        bits += 16;
+        cycles >>= 16;
+    }
+    if (cycles >> 8) {
+        bits += 8;
+        cycles >>= 8;
+    }
+    if (cycles >> 4) {
+        bits += 4;
+        cycles >>= 4;
+    }
+    if (cycles >> 2) {
+        bits += 2;
+        cycles >>= 2;
+    }
+    if (cycles >> 1) {
+        bits += 1;
+        cycles >>= 1;
+    }
+    bits += cycles;
+    return (bits < PROFILE_BUCKETS) ? bits : (PROFILE_BUCKETS - 1);
+}
+
+// Each histogram is only updated from one context (main loop or interrupt)
+void profile_record(profile_id_t id, uint32_t cycles)
+{
+    histogram_t* h = &histogram[id];
+    uint16_t* bucket;
+
+    if (profile_busy) {
+        return;
+    }
+    bucket = &h->bucket[bucket_for(cycles)];
+    h->count++;
+    h->total += cycles;
+    if (cycles > h->max) {
+        h->max = cycles;
+    }
+    if (*bucket != 0xffff) {
+        (*bucket)++;
+    }
+}
+
+void profile_reset(void)
+{
+    profile_busy = 1;
+    disable_interrupts();
+    memset(histogram, 0, sizeof(histogram));
+    enable_interrupts();
+    profile_busy = 0;
+}
+
+static uint8_t* put(uint8_t* out, uint64_t value, uint8_t size)
+{
+    uint8_t i;
+
+    for (i = 0; i < size; i++) {
+        *out++ = (uint8_t) value;
+        value >>= 8;
+    }
+    return out;
+}
+
+size_t profile_dump(uint8_t* buffer)
+{
+    histogram_t copy;
+    uint8_t* out = buffer;
+    uint8_t i, j;
+
+    profile_busy = 1;
+    memcpy(out, PROFILE_MAGIC, 4);
+    out = put(out + 4, profile_cycles_per_second(), 4);
+    out = put(out, PROFILE_COUNT, 1);
+    out = put(out, PROFILE_BUCKETS, 1);
+    out = put(out, 0, 2);
+    for (i = 0; i < PROFILE_COUNT; i++) {
+        disable_interrupts();
+        memcpy(&copy, &histogram[i], sizeof(copy));
+        enable_interrupts();
+
+        out = put(out, copy.count, 4);
+        out = put(out, copy.max, 4);
+        out = put(out, copy.total, 8);
+        for (j = 0; j < PROFILE_BUCKETS; j++) {
+            out = put(out, copy.bucket[j], 2);
+        }
+    }
+    profile_busy = 0;
+    return out - buffer;
+}
+
+#endif
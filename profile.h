@@ -0,0 +1,67 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Optional: measure how long the main loop, the 433MHz interrupt, interrupt-masked
+// windows and each part of the main loop take. Send 'P' on the serial port for a
+// dump (decoded by profile_report.py) or 'R' to reset. Without CONFIG_PROFILE,
+// all of the instrumentation is compiled out.
+//#define CONFIG_PROFILE
+
+typedef enum {
+    PROFILE_LOOP,           // loop(), except for waiting
+    PROFILE_ISR,            // rx433_interrupt
+    PROFILE_MASKED,         // critical sections (disable_interrupts .. enable_interrupts)
+    PROFILE_NEOPIXEL,       // NeoPixel show(), with interrupts disabled unless using DMA
+    PROFILE_RTC,            // reading the time, drift compensation, checking the alarm
+    PROFILE_ALARM,          // update_alarm
+    PROFILE_DISPLAY,        // update_display
+    PROFILE_MAIL,           // mail_receive_messages
+    PROFILE_BUTTONS,        // buttons and the slide switch
+    PROFILE_COUNT,
+} profile_id_t;
+
+#define PROFILE_BUCKETS     24      // bucket n counts durations of 2^(n-1) .. 2^n - 1 cycles
+#define PROFILE_MAGIC       "PRF1"
+#define PROFILE_HEADER_SIZE 12
+#define PROFILE_ENTRY_SIZE  (16 + (PROFILE_BUCKETS * 2))
+#define PROFILE_DUMP_SIZE   (PROFILE_HEADER_SIZE + (PROFILE_COUNT * PROFILE_ENTRY_SIZE))
+
+#ifdef CONFIG_PROFILE
+
+// Current time in CPU cycles (provided by the HAL)
+extern uint32_t profile_cycles(void);
+extern uint32_t profile_cycles_per_second(void);
+
+// Add a duration to a histogram
+void profile_record(profile_id_t id, uint32_t cycles);
+
+// Clear all histograms
+void profile_reset(void);
+
+// Write all histograms to buffer, which must have PROFILE_DUMP_SIZE bytes.
+// Little endian. Header: magic, cycles per second (4 bytes), number of histograms,
+// number of buckets, 2 bytes reserved. Then for each histogram: count (4 bytes),
+// maximum (4 bytes), total (8 bytes), then each bucket (2 bytes, saturating).
+size_t profile_dump(uint8_t* buffer);
+
+#define PROFILE_BEGIN(name) uint32_t profile_start_##name = profile_cycles()
+#define PROFILE_END(name, id) profile_record((id), profile_cycles() - profile_start_##name)
+
+#else
+
+#define PROFILE_BEGIN(name)
+#define PROFILE_END(name, id)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,52 @@
+#!/usr/bin/python3
+# Decode a profile from the clock (built with CONFIG_PROFILE in profile.h).
+# The input is the binary data sent in reply to 'P' on the serial port,
+# or the same data in hex, e.g. a "serial data:" line from the simulation.
+
+import argparse
+import os
+import struct
+import sys
+import typing
+
+NAMES = ["loop", "isr", "masked", "neopixel", "rtc", "alarm", "display", "mail", "buttons"]
+MAGIC = b"PRF1"
+HEADER = "<4sIBBH"
+ENTRY = "<IIQ"
+
+def decode(data: bytes) -> None:
+    (magic, cycles_per_second, count, buckets, _) = struct.unpack_from(HEADER, data, 0)
+    if magic != MAGIC:
+        raise ValueError("not a profile")
+    offset = struct.calcsize(HEADER)
+    us = 1e6 / cycles_per_second
+
+    print("{:10s} {:>9s} {:>10s} {:>10s}  histogram (bucket upper bound in us: count)".format(
+            "", "count", "mean us", "max us"))
+    for i in range(count):
+        (n, maximum, total) = struct.unpack_from(ENTRY, data, offset)
+        offset += struct.calcsize(ENTRY)
+        histogram = struct.unpack_from("<{}H".format(buckets), data, offset)
+        offset += buckets * 2
+        name = NAMES[i] if i < len(NAMES) else str(i)
+        mean = (total * us / n) if n else 0.0
+        parts: typing.List[str] = []
+        for (j, value) in enumerate(histogram):
+            if value:
+                parts.append("{:.3g}: {}{}".format(
+                        (1 << j) * us, value, "+" if value == 0xffff else ""))
+        print("{:10s} {:9d} {:10.2f} {:10.2f}  {}".format(
+                name, n, mean, maximum * us, ", ".join(parts)))
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="Decode a cpeclock profile")
+    parser.add_argument("input", help="binary file, or a hex string")
+    args = parser.parse_args()
+    if os.path.isfile(args.input):
+        data = open(args.input, "rb").read()
+    else:
+        data = bytes.fromhex(args.input.split(":")[-1].strip())
+    decode(data)
+
+if __name__ == "__main__":
+    main()
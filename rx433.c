@@ -4,172 +4,415 @@
 #include "hal.h"
 
 
-// constants for new codes
-#define NC_PULSE 0x100
+// constants for new codes (the line coding is in rx433.h)
 #define EPSILON  ((NC_PULSE * 3) / 8)
 
-#define NC_SYMBOL_TIME      ((NC_PULSE * 5) + (NC_PULSE * 2 * SYMBOL_SIZE))
+#define PERIOD_SHIFT        4       // pulse length estimates are in 1/16 microseconds
+#define NC_PERIOD           (NC_PULSE << PERIOD_SHIFT)
+#define NC_MIN_PERIOD       ((NC_PERIOD * 7) / 8)   // limits of the estimate: the
+#define NC_MAX_PERIOD       ((NC_PERIOD * 9) / 8)   // start code is found within 1/8
 #define MAX_INCOMPLETE_SKIP (5) // maximum symbols that can be skipped at the end of a message
+#define HE_GAP_TIME         (128 * 24) // longer than any Home Easy symbol except the gap
 
-static uint32_t old_time = 0;
+// Pulse classes. Each protocol declares the intervals between rising edges that
+// it recognises, and rx_classes maps every interval to the classes that it
+// belongs to, so each edge is classified for all protocols by one lookup.
+// A decoder does no more than one test unless it has a code in progress,
+// or the edge is of a class that it recognises.
+// Intervals are looked up in buckets of 32 microseconds, so the limits of
+// each class should be multiples of 32.
+#define RX_HE_SHORT         0x01    // Home Easy: 220 high + 320 low
+#define RX_HE_LONG          0x02    // 220 high + 1330 low
+#define RX_HE_START         0x04    // 220 high + 2700 low
+#define RX_NC_START         0x08    // New codes: the "11010" start code
+#define RX_NC2_SYNC_1       0x10    // New codes, version 2: sync word
+#define RX_NC2_SYNC_2       0x20
 
-// Home Easy decoder state
+#define RX_BUCKET_SHIFT     5
+#define RX_BUCKETS          128     // longer intervals have no class
+
+#define RX_CLASS(bucket, min_us, max_us, class) \
+        ((((bucket) << RX_BUCKET_SHIFT) >= (min_us)) \
+            && (((bucket) << RX_BUCKET_SHIFT) < (max_us)) ? (class) : 0)
+
+#define RX_CLASSES_1(b) ( \
+        RX_CLASS(b, 384, 768, RX_HE_SHORT) | \
+        RX_CLASS(b, 1408, 1664, RX_HE_LONG) | \
+        RX_CLASS(b, 2816, 3072, RX_HE_START) | \
+        RX_CLASS(b, (NC_PULSE * 3) - EPSILON, (NC_PULSE * 3) + EPSILON, RX_NC_START) | \
+        RX_CLASS(b, NC2_SYNC_1 - EPSILON, NC2_SYNC_1 + EPSILON, RX_NC2_SYNC_1) | \
+        RX_CLASS(b, NC2_SYNC_2 - EPSILON, NC2_SYNC_2 + EPSILON, RX_NC2_SYNC_2))
+#define RX_CLASSES_4(b)  RX_CLASSES_1(b), RX_CLASSES_1(b + 1), RX_CLASSES_1(b + 2), RX_CLASSES_1(b + 3)
+#define RX_CLASSES_16(b) RX_CLASSES_4(b), RX_CLASSES_4(b + 4), RX_CLASSES_4(b + 8), RX_CLASSES_4(b + 12)
+
+static const uint8_t rx_classes[RX_BUCKETS] = {
+    RX_CLASSES_16(0), RX_CLASSES_16(16), RX_CLASSES_16(32), RX_CLASSES_16(48),
+    RX_CLASSES_16(64), RX_CLASSES_16(80), RX_CLASSES_16(96), RX_CLASSES_16(112),
+};
+
+// Home Easy decoder states
 typedef enum { HE_RESET, HE_RECEIVED_LONG, HE_RECEIVED_SHORT, HE_READY_FOR_BIT } t_he_state;
 
-static t_he_state he_state = HE_RESET;
-static uint8_t he_bit_count = 0;
-static uint32_t he_bit_data = 0;
-volatile uint32_t rx433_home_easy = 0;
+#define RX433_RESET { \
+        .he_state = HE_RESET, \
+        .nc_count = ~0, \
+        .nc_period = NC_PERIOD, \
+        .nc_symbol_time = NC_SYMBOL_TIME, \
+        .nc_epsilon = EPSILON, \
+        .nc2_count = ~0, \
+        .nc2_frame = 1, \
+        .new_code_frame = 2, \
+    }
+
+// frames[] entries are numbered 0 .. 3, so the free one is this minus the others
+#define FRAME_SUM           ((RX433_FRAMES * (RX433_FRAMES - 1)) / 2)
+
+rx433_decoder_t rx433_decoder = RX433_RESET;
+static const rx433_decoder_t rx433_reset = RX433_RESET;
 
-// New code decoder state
-static uint8_t nc_buffer[NC_DATA_SIZE] = {0};
-static uint32_t nc_timebase = 0;
-static uint32_t nc_count = ~0; 
-volatile uint8_t rx433_new_code[NC_DATA_SIZE] = {0};
-volatile uint8_t rx433_new_code_ready = 0;
+// Weight of each data slot: a symbol is the sum of the weights of the slots
+// with pulses. No two pulses are in adjacent slots, so each symbol has a
+// unique representation (Zeckendorf's theorem).
+static const uint8_t nc2_weight[NC2_LAST_DATA_SLOT + 1] = {0, 0, 21, 13, 8, 5, 3, 2, 1};
+
+// Change to the pulse length estimate for each microsecond of error in a bit,
+// in 1/32 of its units: a quarter of the error, spread over the 2 * bit pulses
+// since the timebase (64 / bit, as there is no hardware divide). The first bits
+// are close to the timebase and easily moved by jitter, so no more than for bit 4.
+static const uint8_t nc_bit_gain[(NC_SYMBOL_PULSES / 2) + 2] = {0, 16, 16, 16, 16, 13, 11, 9, 8};
 
 #define IS_CLOSE(delta, centre, epsilon) \
         (((delta) + (epsilon) - (centre)) < ((epsilon) * 2))
 
+// A new code was received: the symbols in frames[frame], of which those in
+// "received" were complete. The frame becomes the new code, and the decoder
+// continues with the previous new code if it was not taken, or else with the
+// free frame (the consumer has finished with it, having taken another since).
+#define NC_READY(frame, start, received, version) \
+    do { \
+        uint8_t free_ = FRAME_SUM - rx->new_code_frame - rx->nc_frame - rx->nc2_frame; \
+        uint8_t next_ = free_ ^ ((free_ ^ rx->new_code_frame) & (uint8_t) -rx->new_code_ready); \
+        rx->new_code_frame = frame; \
+        frame = next_; \
+        rx->new_code_time = start; \
+        rx->new_code_received = received; \
+        rx->new_code_version = version; \
+        rx->new_code_ready = 1; \
+    } while (0)
+
+// Add a symbol to a frame of packed symbols: it may span two bytes
+#define NC_INSERT(packed, index, symbol) \
+    do { \
+        uint32_t pos_ = (index) * SYMBOL_SIZE; \
+        uint16_t bits_ = (uint16_t) (symbol) << (16 - SYMBOL_SIZE - (pos_ & 7)); \
+        (packed)[pos_ >> 3] |= (uint8_t) (bits_ >> 8); \
+        (packed)[(pos_ >> 3) + 1] |= (uint8_t) bits_; \
+    } while (0)
+
+
+// A copy of a Home Easy code was received: vote
+static void he_vote(rx433_decoder_t* rx, uint32_t code, uint32_t new_time)
+{
+    uint8_t i, votes = 0;
+
+    rx->he_stats.copies++;
+    if ((new_time - rx->he_copy_time) > RX433_HE_BURST_TIME) {
+        // New burst
+        if (rx->he_copy_count && !rx->he_accepted) {
+            rx->he_stats.unconfirmed++;
+        }
+        rx->he_copy_index = 0;
+        rx->he_copy_count = 0;
+        rx->he_accepted = 0;
+    }
+    rx->he_copy_time = new_time;
+    if (code == rx->he_accepted) {
+        rx->he_stats.suppressed++;
+        return;
+    }
+
+    rx->he_copies[rx->he_copy_index] = code;
+    rx->he_copy_index = (rx->he_copy_index >= (RX433_HE_WINDOW - 1)) ? 0 : (rx->he_copy_index + 1);
+    if (rx->he_copy_count < 0xff) {
+        rx->he_copy_count++;
+    }
+    for (i = 0; (i < RX433_HE_WINDOW) && (i < rx->he_copy_count); i++) {
+        votes += (rx->he_copies[i] == code);
+    }
+    if (votes >= RX433_HE_VOTES) {
+        rx->home_easy = code;
+        rx->he_stats.accepted++;
+        rx->he_stats.copies_needed[(rx->he_copy_count < RX433_HE_STATS_COPIES)
+                                   ? (rx->he_copy_count - 1) : (RX433_HE_STATS_COPIES - 1)]++;
+        // Another code in the same burst needs votes of its own
+        rx->he_accepted = code;
+        rx->he_copy_index = 0;
+        rx->he_copy_count = 0;
+    }
+}
+
+// Track the transmitter's pulse length, which may differ from NC_PULSE by a few
+// percent, so that the tolerance of each bit need not be widened
+static void nc_set_period(rx433_decoder_t* rx, uint32_t period)
+{
+    rx->nc_period = period;
+    rx->nc_symbol_time = (period * NC_SYMBOL_PULSES) >> PERIOD_SHIFT;
+    rx->nc_epsilon = (period * 3) >> (3 + PERIOD_SHIFT);
+}
+
+void rx433_init(rx433_decoder_t* rx)
+{
+    *rx = rx433_reset;
+}
 
 void rx433_interrupt(void)
 {
-    uint32_t new_time = micros();
-    uint32_t delta = new_time - old_time;
-    uint32_t delta2 = new_time - nc_timebase;
+    rx433_decode(&rx433_decoder, micros());
+}
+
+void rx433_decode(rx433_decoder_t* rx, uint32_t new_time)
+{
+    uint32_t delta = new_time - rx->old_time;
+    uint32_t delta2 = new_time - rx->nc_timebase;
+    uint8_t in_range = delta < (RX_BUCKETS << RX_BUCKET_SHIFT);
+    uint8_t sync;
+
+    // Longer intervals have no class (this is done without a branch)
+    uint8_t classes = rx_classes[(delta >> RX_BUCKET_SHIFT) & (RX_BUCKETS - 1)]
+                        & (uint8_t) -in_range;
 
-    old_time = new_time;
+    rx->old_time = new_time;
 
     // Home Easy
-    // low    high  total  meaning  rounded         divided
-    // 320    220   540    short    384  .. 767     3  .. 5
-    // 1330   220   1550   long     1408 .. 1663    11 .. 12
-    // 2700   220   2920   start    2816 .. 3071    22 .. 23
-    // 10270  220   10490  gap      10240 ..        80 .. *
+    // low    high  total  meaning  class
+    // 320    220   540    short    RX_HE_SHORT: 384 .. 767
+    // 1330   220   1550   long     RX_HE_LONG: 1408 .. 1663
+    // 2700   220   2920   start    RX_HE_START: 2816 .. 3071
+    // 10270  220   10490  gap      none
     // 
-    switch (delta / 128) {
-        case 3:
-        case 4:
-        case 5:
+    switch (classes & (RX_HE_SHORT | RX_HE_LONG | RX_HE_START)) {
+        case RX_HE_SHORT:
             // Home Easy short code or New long code
-            switch (he_state) {
+            switch (rx->he_state) {
                 case HE_READY_FOR_BIT:
-                    he_state = HE_RECEIVED_SHORT;
+                    rx->he_state = HE_RECEIVED_SHORT;
                     break;
                 case HE_RECEIVED_LONG:
                     // Home Easy: long then short -> bit 1
-                    he_bit_data |= ((uint32_t) 1 << (uint32_t) 31) >> he_bit_count;
-                    he_bit_count ++;
-                    he_state = HE_READY_FOR_BIT;
-                    if (he_bit_count >= 32) {
-                        rx433_home_easy = he_bit_data;
-                        he_state = HE_RESET;
+                    rx->he_bit_data |= ((uint32_t) 1 << (uint32_t) 31) >> rx->he_bit_count;
+                    rx->he_bit_count ++;
+                    rx->he_state = HE_READY_FOR_BIT;
+                    if (rx->he_bit_count >= 32) {
+                        he_vote(rx, rx->he_bit_data, new_time);
+                        rx->he_state = HE_RESET;
                     }
                     break;
                 default:
                     // error
-                    he_state = HE_RESET;
+                    rx->he_state = HE_RESET;
                     break;
             }
             break;
-        case 11:
-        case 12:
+        case RX_HE_LONG:
             // Home Easy long code
-            switch (he_state) {
+            switch (rx->he_state) {
                 case HE_READY_FOR_BIT:
-                    he_state = HE_RECEIVED_LONG;
+                    rx->he_state = HE_RECEIVED_LONG;
                     break;
                 case HE_RECEIVED_SHORT:
                     // Home Easy: short then long -> bit 0
-                    he_bit_count ++;
-                    he_state = HE_READY_FOR_BIT;
-                    if (he_bit_count >= 32) {
-                        rx433_home_easy = he_bit_data;
-                        he_state = HE_RESET;
+                    rx->he_bit_count ++;
+                    rx->he_state = HE_READY_FOR_BIT;
+                    if (rx->he_bit_count >= 32) {
+                        he_vote(rx, rx->he_bit_data, new_time);
+                        rx->he_state = HE_RESET;
                     }
                     break;
                 default:
                     // error
-                    he_state = HE_RESET;
+                    rx->he_state = HE_RESET;
                     break;
             }
             break;
-        case 22:
-        case 23:
+        case RX_HE_START:
             // Home Easy start code
-            he_state = HE_READY_FOR_BIT;
-            he_bit_count = 0;
-            he_bit_data = 0;
+            rx->he_state = HE_READY_FOR_BIT;
+            rx->he_bit_count = 0;
+            rx->he_bit_data = 0;
             break;
         default:
-            he_state = HE_RESET;
+            rx->he_state = HE_RESET;
             break;
     }
 
     // New codes
     //
-    if (IS_CLOSE(delta, NC_PULSE * 3, EPSILON)) {
+    if (classes & RX_NC_START) {
         // indicates a "11010" start code - Nth symbol?
         uint32_t skip = 0;
 
         // Skipped any symbols?
-        while ((nc_count < NC_DATA_SIZE)
-        && (delta2 > ((NC_SYMBOL_TIME * 3) / 2))) {
-            nc_count++;
+        while ((rx->nc_count < NC_DATA_SIZE)
+        && (delta2 > ((rx->nc_symbol_time * 3) / 2))) {
+            rx->nc_count++;
             skip++;
-            nc_timebase += NC_SYMBOL_TIME;
-            delta2 = new_time - nc_timebase;
+            rx->nc_timebase += rx->nc_symbol_time;
+            delta2 = new_time - rx->nc_timebase;
         }
 
-        if (nc_count >= NC_DATA_SIZE) {
+        if (rx->nc_count >= NC_DATA_SIZE) {
             // New message
-            if ((nc_count == NC_DATA_SIZE) && (skip <= MAX_INCOMPLETE_SKIP)) {
+            if ((rx->nc_count == NC_DATA_SIZE) && (skip <= MAX_INCOMPLETE_SKIP)) {
                 // Force end of previous incomplete message
-                memcpy((uint8_t*)rx433_new_code, nc_buffer, NC_DATA_SIZE);
-                rx433_new_code_ready = 1;
+                NC_READY(rx->nc_frame, rx->nc_start, rx->nc_received, 1);
             }
-            nc_count = 0;
-            nc_timebase = new_time;
-            memset(nc_buffer, 0, NC_DATA_SIZE);
-        } else if (IS_CLOSE(delta2, NC_SYMBOL_TIME, EPSILON)) {
-            // Message continues
-            nc_timebase = new_time;
+            rx->nc_count = 0;
+            rx->nc_timebase = new_time;
+            rx->nc_start = new_time;
+            rx->nc_received = 0;
+            memset(rx->frames[rx->nc_frame], 0, RX433_PACKED_SIZE);
+            // First estimate of the pulse length: mostly NC_PULSE, as one
+            // interval is easily moved by jitter (341 / 64 is about 16 / 3).
+            // The start code is within EPSILON, so this is within the limits.
+            // The bits then refine it.
+            nc_set_period(rx, ((NC_PERIOD * 3) + ((delta * 341) >> 6)) / 4);
+        } else if (IS_CLOSE(delta2, rx->nc_symbol_time, EPSILON)) {
+            // Message continues. Start codes are NC_SYMBOL_PULSES apart, and
+            // NC_SYMBOL_PULSES is close to (1 << PERIOD_SHIFT), so the error
+            // in 1/16 microseconds is the error of the pulse length. Correct a
+            // quarter of it, so that jitter has little effect. Start codes
+            // outside EPSILON (noise) are ignored and do not move the estimate.
+            uint32_t period = rx->nc_period + (((int32_t) (delta2 - rx->nc_symbol_time)) / 4);
+
+            if ((period >= NC_MIN_PERIOD) && (period <= NC_MAX_PERIOD)) {
+                nc_set_period(rx, period);
+            }
+            rx->nc_timebase = new_time;
         } else {
             // This signal did not arrive at the right time.
             // Wait more for the start of the next symbol
         }
-    } else if (nc_count < NC_DATA_SIZE) {
-        if (delta2 < (NC_SYMBOL_TIME + EPSILON)) {
-            // A bit within a symbol
+    } else if (rx->nc_count < NC_DATA_SIZE) {
+        if (delta2 < (rx->nc_symbol_time + rx->nc_epsilon)) {
+            // A bit within a symbol. The bit number is found with NC_PULSE,
+            // which is close enough, then the timing is checked with the estimate.
             uint32_t bit = (delta2 + NC_PULSE) / (NC_PULSE * 2);
-            uint32_t expect = NC_PULSE * 2 * bit;
+            uint32_t expect = (rx->nc_period * 2 * bit) >> PERIOD_SHIFT;
 
             if (bit == 0) {
                 // Ignore noise in start bit
-            } else if (IS_CLOSE(expect, delta2, EPSILON)) {
-                // Bit is acceptable
+            } else if (IS_CLOSE(expect, delta2, rx->nc_epsilon)) {
+                // Bit is acceptable. Its timing refines the estimate and the
+                // timebase (by half of the error: part of it is the timebase's
+                // own jitter), so that the next start code is found within EPSILON.
+                int32_t error = (int32_t) (delta2 - expect);
+                uint32_t period = rx->nc_period + ((error * nc_bit_gain[bit]) / 32);
+
+                if ((period >= NC_MIN_PERIOD) && (period <= NC_MAX_PERIOD)) {
+                    nc_set_period(rx, period);
+                }
+                rx->nc_timebase += error / 2;
                 if (bit < (SYMBOL_SIZE + 1)) {
                     // data bit
-                    nc_buffer[nc_count] |= (1 << SYMBOL_SIZE) >> bit;
+                    uint32_t pos = (rx->nc_count * SYMBOL_SIZE) + bit - 1;
+                    rx->frames[rx->nc_frame][pos >> 3] |= 0x80 >> (pos & 7);
                 } else {
                     // stop bit - end of symbol
-                    nc_count++;
-                    if (nc_count == NC_DATA_SIZE) {
+                    rx->nc_received |= (uint32_t) 1 << rx->nc_count;
+                    rx->nc_count++;
+                    if (rx->nc_count == NC_DATA_SIZE) {
                         // Also, end of message
-                        memcpy((uint8_t*)rx433_new_code, nc_buffer, NC_DATA_SIZE);
-                        rx433_new_code_ready = 1;
-                        nc_count = ~0;
+                        NC_READY(rx->nc_frame, rx->nc_start, rx->nc_received, 1);
+                        rx->nc_count = ~0;
                     }
                 }
             }
         } else {
-            if ((nc_count + MAX_INCOMPLETE_SKIP) >= NC_DATA_SIZE) {
+            if ((rx->nc_count + MAX_INCOMPLETE_SKIP) >= NC_DATA_SIZE) {
                 // Force end of incomplete message (as the number of skipped words <= MAX_INCOMPLETE_SKIP)
-                memcpy((uint8_t*)rx433_new_code, nc_buffer, NC_DATA_SIZE);
-                rx433_new_code_ready = 1;
+                NC_READY(rx->nc_frame, rx->nc_start, rx->nc_received, 1);
             }
-            nc_count = ~0;
+            rx->nc_count = ~0;
+        }
+    }
+
+    // New codes, version 2
+    //
+    sync = rx->nc2_sync;
+    rx->nc2_sync = (classes & RX_NC2_SYNC_1) != 0;
+
+    if (sync && (classes & RX_NC2_SYNC_2)) {
+        // Sync word complete: start of symbol 0. If a message was in progress,
+        // it was really noise; a version 1 message can't be in progress either.
+        rx->nc2_count = 0;
+        rx->nc2_timebase = new_time;
+        rx->nc2_start = new_time;
+        rx->nc2_received = 1;
+        rx->nc2_symbol = 0;
+        memset(rx->frames[rx->nc2_frame], 0, RX433_PACKED_SIZE);
+        rx->nc_count = ~0;
+    } else if (rx->nc2_count < NC_DATA_SIZE) {
+        uint32_t delta3 = new_time - rx->nc2_timebase;
+        uint32_t slot = (delta3 + (NC_PULSE / 2)) / NC_PULSE;
+        uint32_t skip = MAX_INCOMPLETE_SKIP + 1;
+
+        // Has the symbol ended? The pulse at the start of the next symbol
+        // might be missing, so symbols are counted from the timebase.
+        if (slot < (NC2_SLOTS * (MAX_INCOMPLETE_SKIP + 1))) {
+            // skip = slot / NC2_SLOTS, without a division (exact for slot < 1029)
+            skip = (slot * 205) >> 11;
+            slot -= skip * NC2_SLOTS;
+        }
+
+        if (((rx->nc2_count + skip) >= NC_DATA_SIZE) || (skip > MAX_INCOMPLETE_SKIP)
+        || (((rx->nc2_count + 1) == NC_DATA_SIZE) && (slot > NC2_LAST_DATA_SLOT))) {
+            // End of message. Usually this is the pulse in slot 0 after the last
+            // symbol, which ends it as the end pulse does in version 1; it may be
+            // early, as nothing else is expected after the last data slot. If it
+            // was lost, the message ends at a later edge, possibly incomplete.
+            NC_INSERT(rx->frames[rx->nc2_frame], rx->nc2_count, rx->nc2_symbol);
+            if ((rx->nc2_count + MAX_INCOMPLETE_SKIP) >= NC_DATA_SIZE) {
+                NC_READY(rx->nc2_frame, rx->nc2_start, rx->nc2_received, 2);
+            }
+            rx->nc2_count = ~0;
+        } else if (IS_CLOSE(delta3, ((skip * NC2_SLOTS) + slot) * NC_PULSE, EPSILON)) {
+            if (skip) {
+                // Next symbol
+                NC_INSERT(rx->frames[rx->nc2_frame], rx->nc2_count, rx->nc2_symbol);
+                rx->nc2_symbol = 0;
+                rx->nc2_count += skip;
+                rx->nc2_timebase += skip * NC2_SYMBOL_TIME;
+                if (slot == 0) {
+                    // follow the transmitter's clock
+                    rx->nc2_timebase = new_time;
+                    rx->nc2_received |= (uint32_t) 1 << rx->nc2_count;
+                }
+            }
+            if ((slot >= NC2_FIRST_DATA_SLOT) && (slot <= NC2_LAST_DATA_SLOT)) {
+                rx->nc2_symbol = (rx->nc2_symbol + nc2_weight[slot]) & ((1 << SYMBOL_SIZE) - 1);
+            }
+        } else {
+            // Noise between slots
         }
     }
 }
 
+int rx433_busy(void)
+{
+    const rx433_decoder_t* rx = &rx433_decoder;
+    uint32_t now = micros();
+
+    if ((rx->nc_count < NC_DATA_SIZE) && ((now - rx->nc_timebase) < (NC_SYMBOL_TIME * 2))) {
+        // New code in progress, and the next symbol is expected soon
+        return 1;
+    }
+    if ((rx->nc2_count < NC_DATA_SIZE) && ((now - rx->nc2_timebase) < (NC2_SYMBOL_TIME * 2))) {
+        // Version 2 new code in progress
+        return 1;
+    }
+    if ((rx->he_state != HE_RESET) && ((now - rx->old_time) < HE_GAP_TIME)) {
+        // Home Easy code in progress
+        return 1;
+    }
+    return 0;
+}
@@ -10,15 +10,125 @@ extern "C" {
 
 #define SYMBOL_SIZE         5
 #define NC_DATA_SIZE        31      // New codes: 31 base-32 symbols
+#define RX433_PACKED_SIZE   (((NC_DATA_SIZE * SYMBOL_SIZE) + 7) / 8)    // 20 bytes
+#define RX433_FRAMES        4       // two being received, the new code, and the consumer's
 
+// Line coding of new codes (see README.md), in microseconds. Version 1: each
+// symbol is a start code (11010), then 10 or 00 for each bit, and the message
+// ends with 10. Version 2: a sync word, then NC2_SLOTS slots for each symbol.
+#define NC_PULSE            0x100
+#define NC_SYMBOL_PULSES    (5 + (2 * SYMBOL_SIZE))
+#define NC_SYMBOL_TIME      (NC_PULSE * NC_SYMBOL_PULSES)
+#define NC2_SLOTS           10      // NC_PULSE slots per symbol
+#define NC2_SYMBOL_TIME     (NC_PULSE * NC2_SLOTS)
+#define NC2_FIRST_DATA_SLOT 2
+#define NC2_LAST_DATA_SLOT  8
+#define NC2_SYNC_1          (NC_PULSE * 13) // sync word: intervals which don't occur in
+#define NC2_SYNC_2          (NC_PULSE * 5)  // version 1 codes, Home Easy codes or version 2 data
 
-extern volatile uint32_t rx433_home_easy;
-extern volatile uint8_t rx433_new_code[NC_DATA_SIZE];
-extern volatile uint8_t rx433_new_code_ready;
+// Home Easy codes are sent several times. A code is accepted when RX433_HE_VOTES
+// of the last RX433_HE_WINDOW copies match, and further copies are ignored until
+// none has been received for RX433_HE_BURST_TIME microseconds. With
+// RX433_HE_VOTES 1, the first copy is accepted, as before voting was added.
+#ifndef RX433_HE_VOTES
+#define RX433_HE_VOTES      2
+#endif
+#ifndef RX433_HE_WINDOW
+#define RX433_HE_WINDOW     3
+#endif
+#ifndef RX433_HE_BURST_TIME
+#define RX433_HE_BURST_TIME 250000
+#endif
+
+#define RX433_HE_STATS_COPIES 8
+
+typedef struct rx433_he_stats_s {
+    uint32_t    copies;         // copies of Home Easy codes received
+    uint32_t    accepted;       // codes accepted by voting
+    uint32_t    suppressed;     // copies of a code which was already accepted
+    uint32_t    unconfirmed;    // bursts which ended without a code being accepted
+    uint32_t    copies_needed[RX433_HE_STATS_COPIES];
+                                // codes accepted at the 1st, 2nd .. copy of a burst
+                                // (the last entry also counts any later copy)
+} rx433_he_stats_t;
+
+
+// Decoder state. rx433_interrupt decodes the edges from the receiver with
+// rx433_decoder; on the host, other decoders can be used for other receivers.
+typedef struct rx433_decoder_s {
+    uint32_t    old_time;
+
+    // Home Easy decoder state
+    uint32_t    he_bit_data;
+    uint8_t     he_state;
+    uint8_t     he_bit_count;
+
+    // Home Easy voting state
+    uint8_t     he_copy_index;                  // next entry of he_copies
+    uint8_t     he_copy_count;                  // copies in this burst (saturating)
+    uint32_t    he_copies[RX433_HE_WINDOW];     // the last copies in this burst
+    uint32_t    he_accepted;                    // code accepted in this burst
+    uint32_t    he_copy_time;                   // time of the last copy
+
+    // New code decoder state
+    uint32_t    nc_timebase;
+    uint32_t    nc_count;
+    uint32_t    nc_period;                      // estimated pulse length of the transmitter
+    uint32_t    nc_symbol_time;                 // and the times derived from it
+    uint32_t    nc_epsilon;
+    uint32_t    nc_start;                       // time of the first symbol
+    uint32_t    nc_received;                    // bit i is set if symbol i was received
+    uint8_t     nc_frame;                       // frames[] entry being received
+
+    // New code (version 2) decoder state
+    uint8_t     nc2_sync;
+    uint32_t    nc2_timebase;
+    uint32_t    nc2_count;
+    uint32_t    nc2_start;
+    uint32_t    nc2_received;
+    uint8_t     nc2_frame;
+    uint8_t     nc2_symbol;                     // added to the frame when the symbol ends
+
+    // Frames of packed symbols: symbol i is bits 5i .. 5i+4, most significant
+    // bit first. Each frame is being received by one of the decoders, or is the
+    // new code, or is free. A new code is passed on by exchanging frames.
+    uint8_t     frames[RX433_FRAMES][RX433_PACKED_SIZE];
+
+    // Outputs
+    volatile uint8_t new_code_ready;
+    volatile uint8_t new_code_frame;            // frames[] entry of the new code
+    volatile uint8_t new_code_version;          // line coding: 1 or 2
+    volatile uint32_t new_code_time;            // when the first symbol received began
+    volatile uint32_t new_code_received;        // bit i is set if symbol i was received
+    volatile uint32_t home_easy;
+    volatile rx433_he_stats_t he_stats;
+} rx433_decoder_t;
+
+extern rx433_decoder_t rx433_decoder;
+
+// The new code of a decoder, as packed symbols. The consumer takes it by
+// clearing new_code_ready (with interrupts disabled), and may then use it
+// until it takes the next one: the decoder only reuses the frame after that.
+#define RX433_NEW_CODE(rx)      ((const uint8_t*) (rx)->frames[(rx)->new_code_frame])
+
+#define rx433_home_easy         (rx433_decoder.home_easy)
+#define rx433_new_code          RX433_NEW_CODE(&rx433_decoder)
+#define rx433_new_code_ready    (rx433_decoder.new_code_ready)
+#define rx433_he_stats          (rx433_decoder.he_stats)
 
 
 void rx433_interrupt(void);
 
+// Reset a decoder
+void rx433_init(rx433_decoder_t* rx);
+
+// Decode a rising edge received at "new_time" (microseconds)
+void rx433_decode(rx433_decoder_t* rx, uint32_t new_time);
+
+// Returns non-zero if a code may be being received now. Interrupts
+// should not be disabled for long at such times.
+int rx433_busy(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,26 @@
+// Host simulation: the firmware itself. The Arduino IDE generates prototypes
+// for functions which are used before they are defined; they are listed here.
+
+#include "Arduino.h"
+
+static bool build_clock_cache(void);
+static int is_night_time();
+
+#include "../cpeclock.ino"
+
+#include "sim.h"
+
+void sim_firmware_setup(void)
+{
+    setup();
+}
+
+void sim_firmware_loop(void)
+{
+    loop();
+}
+
+unsigned sim_firmware_alarm_active(void)
+{
+    return alarm_active;
+}
@@ -0,0 +1,111 @@
+// Host simulation: stand-ins for the FreeSans fonts, which are part of
+// Adafruit_GFX and not available here. A 5x7 font is converted to the GFXfont
+// format: at 1x for FreeSans9pt7b and 3x for FreeSans24pt7b. Lower case
+// letters are drawn as upper case.
+
+#include "Adafruit_GFX.h"
+#include "Fonts/FreeSans9pt7b.h"
+#include "Fonts/FreeSans24pt7b.h"
+
+#define FIRST_CHAR  0x20
+#define LAST_CHAR   0x7e
+#define NUM_CHARS   (LAST_CHAR - FIRST_CHAR + 1)
+#define SMALL_SCALE 1
+#define LARGE_SCALE 3
+
+// 0x20 .. 0x5f, one byte per column, least significant bit at the top
+static const uint8_t font5x7[][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5f, 0x00, 0x00}, // space !
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7f, 0x14, 0x7f, 0x14}, // " #
+    {0x24, 0x2a, 0x7f, 0x2a, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, // $ %
+    {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, // & '
+    {0x00, 0x1c, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1c, 0x00}, // ( )
+    {0x2a, 0x1c, 0x7f, 0x1c, 0x2a}, {0x08, 0x08, 0x3e, 0x08, 0x08}, // * +
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, // , -
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02}, // . /
+    {0x3e, 0x51, 0x49, 0x45, 0x3e}, {0x00, 0x42, 0x7f, 0x40, 0x00}, // 0 1
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4b, 0x31}, // 2 3
+    {0x18, 0x14, 0x12, 0x7f, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, // 4 5
+    {0x3c, 0x4a, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03}, // 6 7
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1e}, // 8 9
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00}, // : ;
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, // < =
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, // > ?
+    {0x32, 0x49, 0x79, 0x41, 0x3e}, {0x7e, 0x11, 0x11, 0x11, 0x7e}, // @ A
+    {0x7f, 0x49, 0x49, 0x49, 0x36}, {0x3e, 0x41, 0x41, 0x41, 0x22}, // B C
+    {0x7f, 0x41, 0x41, 0x22, 0x1c}, {0x7f, 0x49, 0x49, 0x49, 0x41}, // D E
+    {0x7f, 0x09, 0x09, 0x09, 0x01}, {0x3e, 0x41, 0x49, 0x49, 0x7a}, // F G
+    {0x7f, 0x08, 0x08, 0x08, 0x7f}, {0x00, 0x41, 0x7f, 0x41, 0x00}, // H I
+    {0x20, 0x40, 0x41, 0x3f, 0x01}, {0x7f, 0x08, 0x14, 0x22, 0x41}, // J K
+    {0x7f, 0x40, 0x40, 0x40, 0x40}, {0x7f, 0x02, 0x0c, 0x02, 0x7f}, // L M
+    {0x7f, 0x04, 0x08, 0x10, 0x7f}, {0x3e, 0x41, 0x41, 0x41, 0x3e}, // N O
+    {0x7f, 0x09, 0x09, 0x09, 0x06}, {0x3e, 0x41, 0x51, 0x21, 0x5e}, // P Q
+    {0x7f, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31}, // R S
+    {0x01, 0x01, 0x7f, 0x01, 0x01}, {0x3f, 0x40, 0x40, 0x40, 0x3f}, // T U
+    {0x1f, 0x20, 0x40, 0x20, 0x1f}, {0x3f, 0x40, 0x38, 0x40, 0x3f}, // V W
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x07, 0x08, 0x70, 0x08, 0x07}, // X Y
+    {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7f, 0x41, 0x41, 0x00}, // Z [
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7f, 0x00}, // backslash ]
+    {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40}, // ^ _
+};
+
+#define GLYPH_BYTES(scale) (((5 * (scale) * 7 * (scale)) + 7) / 8)
+
+static uint8_t small_bitmap[NUM_CHARS * GLYPH_BYTES(SMALL_SCALE)];
+static uint8_t large_bitmap[NUM_CHARS * GLYPH_BYTES(LARGE_SCALE)];
+static GFXglyph small_glyph[NUM_CHARS];
+static GFXglyph large_glyph[NUM_CHARS];
+
+const GFXfont FreeSans9pt7b = {small_bitmap, small_glyph, FIRST_CHAR, LAST_CHAR, 10 * SMALL_SCALE};
+const GFXfont FreeSans24pt7b = {large_bitmap, large_glyph, FIRST_CHAR, LAST_CHAR, 10 * LARGE_SCALE};
+
+static const uint8_t* columns_for(uint8_t c)
+{
+    switch (c) {
+        case '`': c = '\''; break;
+        case '{': c = '('; break;
+        case '|': c = '!'; break;
+        case '}': c = ')'; break;
+        case '~': c = '-'; break;
+        default:
+            if ((c >= 'a') && (c <= 'z')) {
+                c -= 'a' - 'A';
+            }
+            break;
+    }
+    return font5x7[c - FIRST_CHAR];
+}
+
+static void build_font(uint8_t* bitmap, GFXglyph* glyphs, uint8_t scale)
+{
+    for (unsigned i = 0; i < NUM_CHARS; i++) {
+        const uint8_t* columns = columns_for(FIRST_CHAR + i);
+        GFXglyph* glyph = &glyphs[i];
+        uint8_t* out = &bitmap[i * GLYPH_BYTES(scale)];
+        unsigned bit = 0;
+
+        glyph->bitmapOffset = i * GLYPH_BYTES(scale);
+        glyph->width = (i == 0) ? 0 : (5 * scale);
+        glyph->height = (i == 0) ? 0 : (7 * scale);
+        glyph->xAdvance = 6 * scale;
+        glyph->xOffset = 0;
+        glyph->yOffset = -7 * scale;
+
+        // Rows of pixels, packed with the most significant bit first
+        for (unsigned y = 0; y < glyph->height; y++) {
+            for (unsigned x = 0; x < glyph->width; x++) {
+                if ((columns[x / scale] >> (y / scale)) & 1) {
+                    out[bit / 8] |= 0x80 >> (bit % 8);
+                }
+                bit++;
+            }
+        }
+    }
+}
+
+static struct build_fonts_s {
+    build_fonts_s() {
+        build_font(small_bitmap, small_glyph, SMALL_SCALE);
+        build_font(large_bitmap, large_glyph, LARGE_SCALE);
+    }
+} build_fonts;
@@ -0,0 +1,32 @@
+#ifndef ADAFRUIT_CIRCUITPLAYGROUND_H
+#define ADAFRUIT_CIRCUITPLAYGROUND_H
+
+// Host simulation: the Circuit Playground Express board. Buttons and the
+// slide switch are controlled by the simulator, tones are counted.
+
+#include "Arduino.h"
+#include "Adafruit_NeoPixel.h"
+
+typedef Adafruit_NeoPixel Adafruit_CPlay_NeoPixel;
+
+class Adafruit_CPlay_Speaker {
+public:
+    void enable(bool e) { enabled = e; }
+    bool enabled = false;
+};
+
+class Adafruit_CircuitPlayground {
+public:
+    bool begin(uint8_t brightness = 20);
+    bool slideSwitch(void);
+    bool leftButton(void);
+    bool rightButton(void);
+    void playTone(uint16_t freq, uint16_t time, bool wait = true);
+
+    Adafruit_CPlay_NeoPixel strip;
+    Adafruit_CPlay_Speaker speaker;
+};
+
+extern Adafruit_CircuitPlayground CircuitPlayground;
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef ADAFRUIT_GFX_H
+#define ADAFRUIT_GFX_H
+
+// Host simulation: text drawing with GFX fonts, as Adafruit_GFX does it.
+// Only custom (GFXfont) fonts are supported.
+
+#include "Arduino.h"
+
+typedef struct {
+    uint16_t    bitmapOffset;
+    uint8_t     width;
+    uint8_t     height;
+    uint8_t     xAdvance;
+    int8_t      xOffset;
+    int8_t      yOffset;
+} GFXglyph;
+
+typedef struct {
+    uint8_t*    bitmap;
+    GFXglyph*   glyph;
+    uint16_t    first;
+    uint16_t    last;
+    uint8_t     yAdvance;
+} GFXfont;
+
+class Adafruit_GFX {
+public:
+    Adafruit_GFX(int16_t w, int16_t h);
+    virtual ~Adafruit_GFX() {}
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+    void setCursor(int16_t x, int16_t y);
+    void setTextColor(uint16_t color);
+    void setTextSize(uint8_t size);
+    void setTextWrap(bool wrap);
+    void setFont(const GFXfont* font);
+    size_t write(uint8_t c);
+    void print(const char* text);
+    void println(const char* text);
+    void getTextBounds(const char* text, int16_t x, int16_t y,
+                       int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h);
+    int16_t width(void) const { return _width; }
+    int16_t height(void) const { return _height; }
+
+protected:
+    void drawChar(int16_t x, int16_t y, uint8_t c, uint16_t color, uint8_t size);
+
+    int16_t         _width;
+    int16_t         _height;
+    int16_t         cursor_x;
+    int16_t         cursor_y;
+    uint16_t        textcolor;
+    uint8_t         textsize;
+    bool            wrap;
+    const GFXfont*  gfxFont;
+};
+
+#endif
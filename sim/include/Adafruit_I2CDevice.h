@@ -0,0 +1,8 @@
+#ifndef ADAFRUIT_I2CDEVICE_H
+#define ADAFRUIT_I2CDEVICE_H
+
+// Host simulation: not used directly by cpeclock.ino
+
+#include "Wire.h"
+
+#endif
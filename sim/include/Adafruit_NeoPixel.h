@@ -0,0 +1,36 @@
+#ifndef ADAFRUIT_NEOPIXEL_H
+#define ADAFRUIT_NEOPIXEL_H
+
+// Host simulation: NeoPixels, including the lossy brightness scaling of
+// the real library. show() passes the colours to the simulator.
+
+#include "Arduino.h"
+
+#define NEO_GRB     0x52
+#define NEO_KHZ800  0x0000
+
+class Adafruit_NeoPixel {
+public:
+    Adafruit_NeoPixel(uint16_t n = 10, int16_t pin = 8, uint16_t type = NEO_GRB + NEO_KHZ800);
+    virtual ~Adafruit_NeoPixel();
+    bool begin(void);
+    virtual void show(void);
+    void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+    void setPixelColor(uint16_t n, uint32_t c);
+    void fill(uint32_t c = 0, uint16_t first = 0, uint16_t count = 0);
+    void clear(void);
+    void setBrightness(uint8_t b);
+    uint8_t getBrightness(void) const { return brightness - 1; }
+    uint32_t getPixelColor(uint16_t n) const;
+    uint16_t numPixels(void) const { return numLEDs; }
+    static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+        return ((uint32_t) r << 16) | ((uint32_t) g << 8) | b;
+    }
+
+protected:
+    uint16_t    numLEDs;
+    uint8_t     brightness;
+    uint8_t*    pixels;     // 3 bytes per pixel, R G B
+};
+
+#endif
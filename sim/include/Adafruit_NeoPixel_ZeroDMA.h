@@ -0,0 +1,15 @@
+#ifndef ADAFRUIT_NEOPIXEL_ZERODMA_H
+#define ADAFRUIT_NEOPIXEL_ZERODMA_H
+
+// Host simulation: as Adafruit_NeoPixel, but interrupts stay enabled during show()
+
+#include "Adafruit_NeoPixel.h"
+
+class Adafruit_NeoPixel_ZeroDMA : public Adafruit_NeoPixel {
+public:
+    Adafruit_NeoPixel_ZeroDMA(uint16_t n, uint8_t pin, uint16_t type)
+        : Adafruit_NeoPixel(n, pin, type) {}
+    void show(void);
+};
+
+#endif
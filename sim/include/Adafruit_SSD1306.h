@@ -0,0 +1,48 @@
+#ifndef ADAFRUIT_SSD1306_H
+#define ADAFRUIT_SSD1306_H
+
+// Host simulation: the SSD1306 driver. Commands and data are sent over the
+// simulated I2C bus to the simulated panel, in the same way as the real library.
+
+#include "Adafruit_GFX.h"
+#include "Wire.h"
+
+#define SSD1306_BLACK           0
+#define SSD1306_WHITE           1
+#define SSD1306_INVERSE         2
+
+#define SSD1306_EXTERNALVCC     0x01
+#define SSD1306_SWITCHCAPVCC    0x02
+
+#define SSD1306_MEMORYMODE      0x20
+#define SSD1306_COLUMNADDR      0x21
+#define SSD1306_PAGEADDR        0x22
+#define SSD1306_SETCONTRAST     0x81
+#define SSD1306_CHARGEPUMP      0x8D
+#define SSD1306_DISPLAYOFF      0xAE
+#define SSD1306_DISPLAYON       0xAF
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+    Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t rst_pin = -1,
+                     uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL);
+    ~Adafruit_SSD1306();
+    bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0x3c,
+               bool reset = true, bool periphBegin = true);
+    void display(void);
+    void clearDisplay(void);
+    void dim(bool dim);
+    void drawPixel(int16_t x, int16_t y, uint16_t color);
+    uint8_t* getBuffer(void);
+    void ssd1306_command(uint8_t c);
+
+private:
+    TwoWire*    wire;
+    uint8_t*    buffer;
+    uint8_t     i2caddr;
+    uint8_t     vccstate;
+    uint32_t    wireClk;        // I2C clock during transfers
+    uint32_t    restoreClk;     // and afterwards
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host simulation: the parts of the Arduino core used by cpeclock.ino.
+// Time is virtual, see sim.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+#define CHANGE          2
+#define FALLING         3
+#define RISING          4
+
+#define PIN_A0          14
+#define PIN_A1          15
+#define PIN_A2          16
+#define PIN_A3          17
+#define PIN_A4          18
+#define PIN_A5          19
+#define PIN_A6          20
+#define PIN_A7          21
+#define LED_BUILTIN     13
+#define NUM_PINS        32
+
+#define digitalPinToInterrupt(pin) (pin)
+
+#define F_CPU           48000000L
+
+// Cortex-M0+ core peripherals, as used by CONFIG_PROFILE
+typedef struct {
+    uint32_t LOAD;
+    uint32_t VAL;
+} SysTick_Type;
+
+typedef struct {
+    uint32_t ICSR;
+} SCB_Type;
+
+#define SCB_ICSR_PENDSTSET_Msk  (1UL << 26)
+
+SysTick_Type* sim_systick(void);
+SCB_Type* sim_scb(void);
+#define SysTick         (sim_systick())
+#define SCB             (sim_scb())
+
+extern "C" {
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void noInterrupts(void);
+void interrupts(void);
+void __WFI(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+
+class SimSerial {
+public:
+    void begin(unsigned long baud);
+    void print(const char* text);
+    void print(char c);
+    void print(int value);
+    void print(unsigned value);
+    void print(long value);
+    void print(unsigned long value);
+    void println(void);
+    void println(const char* text);
+    void println(int value);
+    void println(unsigned value);
+    void println(long value);
+    void println(unsigned long value);
+    void flush(void);
+    size_t write(const uint8_t* data, size_t size);
+    int available(void);
+    int read(void);
+};
+
+extern SimSerial Serial;
+
+#endif
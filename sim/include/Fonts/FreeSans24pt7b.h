@@ -0,0 +1,3 @@
+// Host simulation: a 5x7 font scaled by 3 stands in for FreeSans24pt7b (see fonts.cpp)
+#include "Adafruit_GFX.h"
+extern const GFXfont FreeSans24pt7b;
@@ -0,0 +1,3 @@
+// Host simulation: a 5x7 font stands in for FreeSans9pt7b (see fonts.cpp)
+#include "Adafruit_GFX.h"
+extern const GFXfont FreeSans9pt7b;
@@ -0,0 +1,85 @@
+#ifndef RTCLIB_H
+#define RTCLIB_H
+
+// Host simulation: DateTime and TimeSpan as in RTClib, and a DS1307
+// which keeps virtual time (see sim.h).
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define SECONDS_FROM_1970_TO_2000 946684800
+
+class TimeSpan {
+public:
+    TimeSpan(int32_t seconds = 0);
+    TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds);
+    int16_t days(void) const { return _seconds / 86400L; }
+    int8_t hours(void) const { return _seconds / 3600 % 24; }
+    int8_t minutes(void) const { return _seconds / 60 % 60; }
+    int8_t seconds(void) const { return _seconds % 60; }
+    int32_t totalseconds(void) const { return _seconds; }
+    TimeSpan operator+(const TimeSpan& right) const;
+    TimeSpan operator-(const TimeSpan& right) const;
+
+protected:
+    int32_t     _seconds;
+};
+
+class DateTime {
+public:
+    DateTime(uint32_t t = SECONDS_FROM_1970_TO_2000);
+    DateTime(uint16_t year, uint8_t month, uint8_t day,
+             uint8_t hour = 0, uint8_t min = 0, uint8_t sec = 0);
+    uint16_t year(void) const { return 2000U + yOff; }
+    uint8_t month(void) const { return m; }
+    uint8_t day(void) const { return d; }
+    uint8_t hour(void) const { return hh; }
+    uint8_t minute(void) const { return mm; }
+    uint8_t second(void) const { return ss; }
+    uint8_t dayOfTheWeek(void) const;
+    uint32_t unixtime(void) const;
+
+    DateTime operator+(const TimeSpan& span) const;
+    DateTime operator-(const TimeSpan& span) const;
+    TimeSpan operator-(const DateTime& right) const;
+    bool operator<(const DateTime& right) const { return unixtime() < right.unixtime(); }
+    bool operator>(const DateTime& right) const { return right < *this; }
+    bool operator<=(const DateTime& right) const { return !(*this > right); }
+    bool operator>=(const DateTime& right) const { return !(*this < right); }
+    bool operator==(const DateTime& right) const { return unixtime() == right.unixtime(); }
+    bool operator!=(const DateTime& right) const { return !(*this == right); }
+
+protected:
+    uint8_t     yOff;
+    uint8_t     m;
+    uint8_t     d;
+    uint8_t     hh;
+    uint8_t     mm;
+    uint8_t     ss;
+};
+
+enum Ds1307SqwPinMode {
+    DS1307_OFF = 0x00,
+    DS1307_ON = 0x80,
+    DS1307_SquareWave1HZ = 0x10,
+    DS1307_SquareWave4kHz = 0x11,
+    DS1307_SquareWave8kHz = 0x12,
+    DS1307_SquareWave32kHz = 0x13,
+};
+
+class RTC_DS1307 {
+public:
+    bool begin(TwoWire* wire = &Wire);
+    uint8_t isrunning(void);
+    void adjust(const DateTime& dt);
+    DateTime now(void);
+    Ds1307SqwPinMode readSqwPinMode(void);
+    void writeSqwPinMode(Ds1307SqwPinMode mode);
+    uint8_t readnvram(uint8_t address);
+    void writenvram(uint8_t address, uint8_t data);
+
+private:
+    TwoWire*    wire;
+};
+
+#endif
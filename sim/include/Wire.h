@@ -0,0 +1,32 @@
+#ifndef WIRE_H
+#define WIRE_H
+
+// Host simulation: I2C. Transfers are passed to the simulated devices
+// and take the same time as on the real bus.
+
+#include "Arduino.h"
+
+#define WIRE_BUFFER_SIZE 256
+
+class TwoWire {
+public:
+    TwoWire(uint8_t bus);
+    void begin(void);
+    void setClock(uint32_t clock);
+    uint32_t getClock(void) const;
+    void beginTransmission(uint8_t address);
+    size_t write(uint8_t data);
+    uint8_t endTransmission(bool stop = true);
+
+private:
+    uint8_t     bus;
+    uint8_t     address;
+    uint32_t    clock;
+    size_t      size;
+    uint8_t     buffer[WIRE_BUFFER_SIZE];
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,929 @@
+// Host simulation of the cpeclock firmware.
+//
+// The firmware (cpeclock.ino and the C modules) runs against the stub
+// libraries in include/, with a virtual clock: delay() and __WFI() move
+// time forwards immediately, so days of firmware time take seconds. I2C
+// transfers, NeoPixel updates and tones take the same time as on the
+// board. A script drives the simulation; see README.md for the commands.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <ctype.h>
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "sim.h"
+
+extern "C" {
+#include "rx433.h"
+#include "ncrs.h"
+#include "hmac433.h"
+#include "fragment.h"
+#include "secret.h"
+#include "test/capture.h"
+}
+
+#define SSD1306_ADDRESS     0x3c
+#define TX_START_DELAY      1000    // microseconds before a transmission begins
+#define TX_GAP              200000  // microseconds between transmissions
+#define NEOPIXEL_BIT_TIME   1.25    // microseconds
+#define NEOPIXEL_RESET_TIME 50
+#define DEFAULT_RTC_TIME    1704110400  // 2024-01-01 12:00:00, a Monday
+#define MAX_UNTIL           (2 * 86400) // seconds
+
+uint64_t sim_time = 0;
+
+typedef struct event_s {
+    uint64_t            when;
+    uint64_t            seq;
+    sim_event_type_t    type;
+    int                 arg;
+    bool operator>(const struct event_s& right) const {
+        return (when != right.when) ? (when > right.when) : (seq > right.seq);
+    }
+} event_t;
+
+static std::priority_queue<event_t, std::vector<event_t>, std::greater<event_t> > events;
+static uint64_t event_seq = 0;
+static bool inputs[SIM_EVENT_SWITCH + 1];
+
+// Interrupts
+static void (*radio_handler)(void) = NULL;
+static void (*sqw_handler)(void) = NULL;
+static bool interrupts_enabled = true;
+static bool radio_pending = false;
+static bool sqw_pending = false;
+
+// DS1307: the time was rtc_base at sim_time rtc_base_time
+static uint32_t rtc_base = DEFAULT_RTC_TIME;
+static uint64_t rtc_base_time = 0;
+static double rtc_drift_ppm = 0.0;  // positive if the RTC is slow
+static bool rtc_sqw = false;
+static uint64_t next_sqw_time = UINT64_MAX;
+static uint8_t rtc_nvram[SIM_NVRAM_SIZE];
+
+// SSD1306 panel
+static uint8_t gddram[SIM_SCREEN_PAGES][SIM_SCREEN_WIDTH];
+static uint8_t col_start = 0, col_end = SIM_SCREEN_WIDTH - 1;
+static uint8_t page_start = 0, page_end = SIM_SCREEN_PAGES - 1;
+static uint8_t panel_col = 0, panel_page = 0;
+static uint8_t contrast = 0x7f;
+static uint8_t command = 0;
+static uint8_t command_args[2];
+static uint8_t command_args_needed = 0;
+static uint8_t command_args_received = 0;
+
+// NeoPixels, as last shown
+static uint8_t leds[SIM_NUM_LEDS][3];
+
+// Text drawn since the display was last cleared
+static std::string drawn_text;
+static std::string traced_text;
+
+// Transmitter
+static uint64_t tx_counter = 1;
+static uint64_t tx_next_time = 0;
+static uint8_t tx_tag = 0;
+
+// Statistics
+static uint64_t loops = 0;
+static uint64_t i2c_bytes = 0;
+static uint64_t i2c_time = 0;
+static uint64_t neopixel_updates = 0;
+static uint64_t neopixel_time = 0;
+static uint64_t tones = 0;
+static uint64_t tones_checked = 0;
+
+static bool trace = false;
+static bool booted = false;
+static std::string serial_line;
+static std::string serial_input;
+static const char* script_name = "";
+static unsigned script_line = 0;
+
+
+
+// Reporting
+
+static void print_time(FILE* fd)
+{
+    fprintf(fd, "[%10.3f] ", (double) sim_time / 1e6);
+}
+
+static void fail(const char* format, const char* detail)
+{
+    fflush(stdout);
+    fprintf(stderr, "%s:%u: ", script_name, script_line);
+    fprintf(stderr, format, detail);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+void sim_serial_write(const char* text)
+{
+    for (; *text; text++) {
+        if (*text == '\n') {
+            print_time(stdout);
+            printf("serial: %s\n", serial_line.c_str());
+            serial_line.clear();
+        } else if (*text != '\r') {
+            serial_line += *text;
+        }
+    }
+}
+
+// Binary data is printed in hex, on a line of its own
+void sim_serial_write_binary(const uint8_t* data, size_t size)
+{
+    print_time(stdout);
+    printf("serial data: ");
+    for (size_t i = 0; i < size; i++) {
+        printf("%02x", data[i]);
+    }
+    printf("\n");
+}
+
+int sim_serial_available(void)
+{
+    return (int) serial_input.size();
+}
+
+int sim_serial_read(void)
+{
+    if (serial_input.empty()) {
+        return -1;
+    }
+    int c = (uint8_t) serial_input[0];
+    serial_input.erase(0, 1);
+    return c;
+}
+
+void sim_text_clear(void)
+{
+    drawn_text.clear();
+}
+
+void sim_text_add(char c)
+{
+    drawn_text += c;
+}
+
+// Events and virtual time
+
+void sim_schedule(uint64_t when, sim_event_type_t type, int arg)
+{
+    event_t e;
+    e.when = when;
+    e.seq = event_seq++;
+    e.type = type;
+    e.arg = arg;
+    events.push(e);
+}
+
+bool sim_input(sim_event_type_t type)
+{
+    return inputs[type];
+}
+
+static void update_next_sqw_time(void);
+
+void sim_attach_interrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+    // The radio receiver interrupts on the rising edge, the DS1307 SQW/OUT on the falling edge
+    if (mode == RISING) {
+        radio_handler = handler;
+    } else if (mode == FALLING) {
+        sqw_handler = handler;
+    }
+    update_next_sqw_time();
+}
+
+static void deliver_pending(void)
+{
+    if (radio_pending && radio_handler) {
+        radio_pending = false;
+        radio_handler();
+    }
+    if (sqw_pending && sqw_handler) {
+        sqw_pending = false;
+        sqw_handler();
+    }
+}
+
+void sim_set_interrupts_enabled(bool enabled)
+{
+    interrupts_enabled = enabled;
+    if (enabled) {
+        deliver_pending();
+    }
+}
+
+bool sim_interrupts_enabled(void)
+{
+    return interrupts_enabled;
+}
+
+static uint64_t rtc_microseconds(uint64_t when)
+{
+    uint64_t elapsed = when - rtc_base_time;
+    return elapsed - (uint64_t) ((double) elapsed * rtc_drift_ppm * 1e-6);
+}
+
+static void update_next_sqw_time(void)
+{
+    next_sqw_time = UINT64_MAX;
+    if (rtc_sqw && sqw_handler) {
+        uint64_t next_second = ((rtc_microseconds(sim_time) / 1000000) + 1) * 1000000;
+        next_sqw_time = rtc_base_time + (uint64_t) ((double) next_second / (1.0 - (rtc_drift_ppm * 1e-6)));
+        if (next_sqw_time <= sim_time) {
+            next_sqw_time = sim_time + 1;
+        }
+    }
+}
+
+static void raise_interrupt(void (*handler)(void), bool* pending, bool enabled)
+{
+    if (!handler) {
+        return;
+    }
+    if (enabled) {
+        handler();
+    } else {
+        *pending = true;
+    }
+}
+
+void sim_advance(uint64_t until, bool enabled)
+{
+    enabled = enabled && interrupts_enabled;
+    for (;;) {
+        uint64_t next_event_time = events.empty() ? UINT64_MAX : events.top().when;
+
+        if (next_sqw_time <= next_event_time) {
+            if (next_sqw_time > until) {
+                break;
+            }
+            sim_time = next_sqw_time;
+            raise_interrupt(sqw_handler, &sqw_pending, enabled);
+            update_next_sqw_time();
+            continue;
+        }
+        if (next_event_time > until) {
+            break;
+        }
+        event_t e = events.top();
+        events.pop();
+        if (e.when > sim_time) {
+            sim_time = e.when;
+        }
+        if (e.type == SIM_EVENT_EDGE) {
+            raise_interrupt(radio_handler, &radio_pending, enabled);
+        } else {
+            inputs[e.type] = (e.arg != 0);
+        }
+    }
+    if (until > sim_time) {
+        sim_time = until;
+    }
+    if (interrupts_enabled) {
+        deliver_pending();
+    }
+}
+
+void sim_spend(uint32_t us)
+{
+    sim_advance(sim_time + us, true);
+}
+
+void sim_wait_for_interrupt(void)
+{
+    // SysTick wakes the CPU every millisecond
+    uint64_t until = ((sim_time / 1000) + 1) * 1000;
+
+    if ((!events.empty()) && (events.top().when < until)) {
+        until = events.top().when;
+    }
+    if (next_sqw_time < until) {
+        until = next_sqw_time;
+    }
+    sim_advance(until, true);
+}
+
+// DS1307
+
+uint32_t sim_rtc_get(void)
+{
+    return rtc_base + (uint32_t) (rtc_microseconds(sim_time) / 1000000);
+}
+
+void sim_rtc_set(uint32_t unixtime)
+{
+    // Writing the seconds register restarts the current second
+    rtc_base = unixtime;
+    rtc_base_time = sim_time;
+    update_next_sqw_time();
+}
+
+void sim_rtc_set_sqw(bool enabled)
+{
+    rtc_sqw = enabled;
+    update_next_sqw_time();
+}
+
+uint8_t sim_rtc_nvram_read(uint8_t address)
+{
+    return (address < SIM_NVRAM_SIZE) ? rtc_nvram[address] : 0;
+}
+
+void sim_rtc_nvram_write(uint8_t address, uint8_t data)
+{
+    if (address < SIM_NVRAM_SIZE) {
+        rtc_nvram[address] = data;
+    }
+}
+
+// SSD1306 panel
+
+static void panel_command(uint8_t c)
+{
+    if (command_args_needed) {
+        command_args[command_args_received++] = c;
+        if (command_args_received < command_args_needed) {
+            return;
+        }
+        command_args_needed = 0;
+        switch (command) {
+            case 0x21:
+                col_start = panel_col = command_args[0] & 0x7f;
+                col_end = command_args[1] & 0x7f;
+                break;
+            case 0x22:
+                page_start = panel_page = command_args[0] & 0x07;
+                page_end = command_args[1] & 0x07;
+                break;
+            case 0x81:
+                contrast = command_args[0];
+                break;
+            default:
+                break;
+        }
+        return;
+    }
+    command = c;
+    command_args_received = 0;
+    switch (c) {
+        case 0x21: case 0x22:
+            command_args_needed = 2;
+            break;
+        case 0x20: case 0x81: case 0x8d: case 0xa8: case 0xd3:
+        case 0xd5: case 0xd9: case 0xda: case 0xdb:
+            command_args_needed = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+static void panel_data(uint8_t data)
+{
+    // Horizontal addressing mode
+    gddram[panel_page][panel_col] = data;
+    if (panel_col >= col_end) {
+        panel_col = col_start;
+        panel_page = (panel_page >= page_end) ? page_start : (panel_page + 1);
+    } else {
+        panel_col++;
+    }
+}
+
+static void trace_display(void)
+{
+    if (trace && (drawn_text != traced_text)) {
+        std::string text = drawn_text;
+        size_t i;
+        while ((i = text.find('\n')) != std::string::npos) {
+            text.replace(i, 1, " | ");
+        }
+        print_time(stdout);
+        printf("display: %s\n", text.c_str());
+        traced_text = drawn_text;
+    }
+}
+
+static void i2c_time_for(size_t size, uint32_t clock)
+{
+    // Address and data bytes are 9 bits each with the acknowledge, plus start and stop
+    uint32_t us = (uint32_t) ((((size + 1) * 9) + 2) * 1000000ULL / clock);
+    i2c_bytes += size + 1;
+    i2c_time += us;
+    sim_spend(us);
+}
+
+void sim_i2c_transfer(uint8_t address, const uint8_t* data, size_t size, uint32_t clock)
+{
+    if ((address == SSD1306_ADDRESS) && (size > 0)) {
+        size_t i;
+        if (data[0] == 0x00) {
+            for (i = 1; i < size; i++) {
+                panel_command(data[i]);
+            }
+        } else if (data[0] == 0x40) {
+            for (i = 1; i < size; i++) {
+                panel_data(data[i]);
+            }
+            trace_display();
+        }
+    }
+    i2c_time_for(size, clock);
+}
+
+void sim_i2c_read(uint8_t address, size_t size, uint32_t clock)
+{
+    i2c_time_for(size, clock);
+}
+
+// NeoPixels and speaker
+
+void sim_neopixel_show(const uint8_t* pixels, uint16_t count, bool enabled)
+{
+    uint32_t us = (uint32_t) (count * 24 * NEOPIXEL_BIT_TIME) + NEOPIXEL_RESET_TIME;
+    bool changed = false;
+
+    for (uint16_t i = 0; (i < count) && (i < SIM_NUM_LEDS); i++) {
+        if (memcmp(leds[i], &pixels[i * 3], 3) != 0) {
+            memcpy(leds[i], &pixels[i * 3], 3);
+            changed = true;
+        }
+    }
+    if (trace && changed) {
+        print_time(stdout);
+        printf("leds: %u %u %u\n", leds[0][0], leds[0][1], leds[0][2]);
+    }
+    neopixel_updates++;
+    neopixel_time += us;
+    // Without DMA, interrupts are disabled while the colours are sent
+    sim_advance(sim_time + us, enabled);
+}
+
+void sim_tone(uint16_t freq, uint16_t time, bool enabled)
+{
+    tones++;
+    if (trace) {
+        print_time(stdout);
+        printf("tone: %u Hz %u ms%s\n", freq, time, enabled ? "" : " (speaker disabled)");
+    }
+}
+
+// Transmitter: new codes are encoded as txnc433 does it, and sent as
+// rising edges in the same format as make_test_rx433.py
+
+static void transmit_code(const uint8_t* message)
+{
+    uint64_t t = tx_next_time;
+    unsigned i, j;
+
+    if (t < (sim_time + TX_START_DELAY)) {
+        t = sim_time + TX_START_DELAY;
+    }
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        uint8_t symbol = message[i];
+        // start of symbol: 11010
+        sim_schedule(t, SIM_EVENT_EDGE, 0);
+        sim_schedule(t + (NC_PULSE * 3), SIM_EVENT_EDGE, 0);
+        t += NC_PULSE * 5;
+        for (j = 0; j < SYMBOL_SIZE; j++) {
+            if (symbol & (1 << (SYMBOL_SIZE - 1))) {
+                sim_schedule(t, SIM_EVENT_EDGE, 0);
+            }
+            t += NC_PULSE * 2;
+            symbol <<= 1;
+        }
+    }
+    // end of final symbol: 10
+    sim_schedule(t, SIM_EVENT_EDGE, 0);
+    tx_next_time = t + TX_GAP;
+}
+
+static void transmit_packet(const uint8_t* payload, size_t size, bool resync)
+{
+    hmac433_packet_t packet;
+    uint8_t message[NC_DATA_SIZE];
+
+    memset(&packet, 0, sizeof(packet));
+    memcpy(packet.payload, payload, (size < PACKET_PAYLOAD_SIZE) ? size : PACKET_PAYLOAD_SIZE);
+    if (resync) {
+        packet.counter_resync_flag = 0x80;
+    }
+    hmac433_encode((const uint8_t*) SECRET_DATA, SECRET_SIZE, &packet, &tx_counter);
+    ncrs_encode(message, (const uint8_t*) &packet);
+    transmit_code(message);
+}
+
+static void transmit(const uint8_t* payload, size_t size)
+{
+    uint8_t fragment[PACKET_PAYLOAD_SIZE];
+    size_t count, i, part;
+
+    if (size <= PACKET_PAYLOAD_SIZE) {
+        transmit_packet(payload, size, false);
+        return;
+    }
+    if (size > FRAGMENT_MAX_PAYLOAD) {
+        fail("%s", "message is too large");
+    }
+    tx_tag = (tx_tag + 1) & FRAGMENT_TAG_MASK;
+    count = (size + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+    for (i = 0; i < count; i++) {
+        memset(fragment, 0, sizeof(fragment));
+        fragment[0] = FRAGMENT_FLAG | (tx_tag << FRAGMENT_TAG_SHIFT) | (uint8_t) i;
+        if ((i + 1) == count) {
+            fragment[0] |= FRAGMENT_LAST;
+        }
+        part = size - (i * FRAGMENT_DATA_SIZE);
+        if (part > FRAGMENT_DATA_SIZE) {
+            part = FRAGMENT_DATA_SIZE;
+        }
+        memcpy(&fragment[1], &payload[i * FRAGMENT_DATA_SIZE], part);
+        transmit_packet(fragment, sizeof(fragment), false);
+    }
+}
+
+static void load_edges(const char* file_name)
+{
+    uint64_t start = sim_time + TX_START_DELAY;
+    uint64_t last = start;
+    uint32_t first = 0, edge;
+    bool have_first = false;
+    const char* error = "";
+    capture_t cap;
+    FILE* fd;
+
+    if (capture_open(&cap, file_name, &error)) {
+        // Binary capture (.cap), see test/capture.h
+        while (capture_next(&cap, &edge)) {
+            if (!have_first) {
+                first = edge;
+                have_first = true;
+            }
+            last = start + (edge - first);
+            sim_schedule(last, SIM_EVENT_EDGE, 0);
+        }
+        capture_close(&cap);
+        tx_next_time = last + TX_GAP;
+        return;
+    }
+
+    fd = fopen(file_name, "rt");
+    if (!fd) {
+        fail("unable to read '%s'", file_name);
+    }
+    // One rising edge per line, as hex microseconds
+    while (fscanf(fd, "%x\n", &edge) == 1) {
+        if (!have_first) {
+            first = edge;
+            have_first = true;
+        }
+        last = start + (uint32_t) (edge - first);
+        sim_schedule(last, SIM_EVENT_EDGE, 0);
+    }
+    fclose(fd);
+    tx_next_time = last + TX_GAP;
+}
+
+// Frame buffer dumps, showing what the panel displays
+
+static void dump(const char* file_name)
+{
+    unsigned x, y;
+
+    if (file_name) {
+        FILE* fd = fopen(file_name, "wt");
+        if (!fd) {
+            fail("unable to write '%s'", file_name);
+        }
+        fprintf(fd, "P1\n%u %u\n", SIM_SCREEN_WIDTH, SIM_SCREEN_PAGES * 8);
+        for (y = 0; y < (SIM_SCREEN_PAGES * 8); y++) {
+            for (x = 0; x < SIM_SCREEN_WIDTH; x++) {
+                fputc(((gddram[y / 8][x] >> (y % 8)) & 1) ? '1' : '0', fd);
+            }
+            fputc('\n', fd);
+        }
+        fclose(fd);
+        return;
+    }
+    print_time(stdout);
+    printf("dump: contrast 0x%02x\n+", contrast);
+    for (x = 0; x < SIM_SCREEN_WIDTH; x++) {
+        putchar('-');
+    }
+    printf("+\n");
+    for (y = 0; y < (SIM_SCREEN_PAGES * 8); y++) {
+        putchar('|');
+        for (x = 0; x < SIM_SCREEN_WIDTH; x++) {
+            putchar(((gddram[y / 8][x] >> (y % 8)) & 1) ? '#' : ' ');
+        }
+        printf("|\n");
+    }
+    putchar('+');
+    for (x = 0; x < SIM_SCREEN_WIDTH; x++) {
+        putchar('-');
+    }
+    printf("+\n");
+}
+
+// Script
+
+static uint64_t parse_duration(const char* text)
+{
+    char* end = NULL;
+    double value = strtod(text, &end);
+
+    if ((end == text) || (value < 0.0)) {
+        fail("invalid duration '%s'", text);
+    }
+    if ((strcmp(end, "") == 0) || (strcmp(end, "s") == 0)) {
+        value *= 1e6;
+    } else if (strcmp(end, "us") == 0) {
+        // microseconds
+    } else if (strcmp(end, "ms") == 0) {
+        value *= 1e3;
+    } else if (strcmp(end, "m") == 0) {
+        value *= 60e6;
+    } else if (strcmp(end, "h") == 0) {
+        value *= 3600e6;
+    } else if (strcmp(end, "d") == 0) {
+        value *= 86400e6;
+    } else {
+        fail("invalid duration '%s'", text);
+    }
+    return (uint64_t) value;
+}
+
+static unsigned long parse_number(const char* text)
+{
+    char* end = NULL;
+    unsigned long value = strtoul(text, &end, 0);
+
+    if ((end == text) || (*end != '\0')) {
+        fail("invalid number '%s'", text);
+    }
+    return value;
+}
+
+// Payload text with C-style \xNN escapes
+static size_t parse_payload(const char* text, uint8_t* payload, size_t max_size)
+{
+    size_t size = 0;
+
+    while (*text) {
+        unsigned value = (uint8_t) *text++;
+        if ((value == '\\') && (*text == 'x') && isxdigit(text[1]) && isxdigit(text[2])) {
+            char hex[3] = {text[1], text[2], '\0'};
+            value = strtoul(hex, NULL, 16);
+            text += 3;
+        }
+        if (size >= max_size) {
+            fail("%s", "message is too large");
+        }
+        payload[size++] = value;
+    }
+    return size;
+}
+
+static void run_loop(uint64_t until)
+{
+    if (!booted) {
+        fail("%s", "not booted");
+    }
+    while (sim_time < until) {
+        sim_firmware_loop();
+        loops++;
+    }
+}
+
+static void run_until_rtc(uint32_t target)
+{
+    uint64_t limit = sim_time + (MAX_UNTIL * 1000000ULL);
+
+    if (!booted) {
+        fail("%s", "not booted");
+    }
+    while (sim_rtc_get() < target) {
+        if (sim_time > limit) {
+            fail("%s", "the time was not reached");
+        }
+        sim_firmware_loop();
+        loops++;
+    }
+}
+
+static void expect(const std::vector<std::string>& args, const std::string& rest)
+{
+    char tmp[128];
+
+    if (args.size() < 2) {
+        fail("%s", "expect what?");
+    }
+    const std::string& what = args[1];
+    if ((what == "text") || (what == "notext")) {
+        // The rest of the line, after "expect text "
+        std::string wanted = rest.substr(rest.find(what) + what.size());
+        wanted.erase(0, wanted.find_first_not_of(' '));
+        bool found = drawn_text.find(wanted) != std::string::npos;
+        if (found != (what == "text")) {
+            fail("display text is '%s'", drawn_text.c_str());
+        }
+    } else if ((what == "leds") && (args.size() == 5)) {
+        for (unsigned i = 0; i < SIM_NUM_LEDS; i++) {
+            for (unsigned j = 0; j < 3; j++) {
+                if (leds[i][j] != parse_number(args[2 + j].c_str())) {
+                    snprintf(tmp, sizeof(tmp), "%u %u %u at LED %u",
+                             leds[i][0], leds[i][1], leds[i][2], i);
+                    fail("NeoPixel colour is %s", tmp);
+                }
+            }
+        }
+    } else if ((what == "tones") && (args.size() == 3)) {
+        unsigned long count = tones - tones_checked;
+        unsigned long wanted = parse_number(args[2].c_str());
+        tones_checked = tones;
+        if (count != wanted) {
+            snprintf(tmp, sizeof(tmp), "%lu", count);
+            fail("%s tones were played", tmp);
+        }
+    } else if ((what == "alarm") && (args.size() == 3)) {
+        if (sim_firmware_alarm_active() != parse_number(args[2].c_str())) {
+            snprintf(tmp, sizeof(tmp), "%u", sim_firmware_alarm_active());
+            fail("alarm_active is %s", tmp);
+        }
+    } else if ((what == "nvram") && (args.size() == 4)) {
+        uint8_t value = sim_rtc_nvram_read(parse_number(args[2].c_str()));
+        if (value != parse_number(args[3].c_str())) {
+            snprintf(tmp, sizeof(tmp), "0x%02x", value);
+            fail("NVRAM contains %s", tmp);
+        }
+    } else if ((what == "rtc") && (args.size() == 3)) {
+        uint32_t now = sim_rtc_get();
+        unsigned h, m, s = 0;
+        if (sscanf(args[2].c_str(), "%u:%u:%u", &h, &m, &s) < 2) {
+            fail("invalid time '%s'", args[2].c_str());
+        }
+        if ((now % 86400) != ((h * 3600) + (m * 60) + s)) {
+            snprintf(tmp, sizeof(tmp), "%02u:%02u:%02u",
+                     (unsigned) ((now / 3600) % 24), (unsigned) ((now / 60) % 60), (unsigned) (now % 60));
+            fail("RTC time is %s", tmp);
+        }
+    } else {
+        fail("invalid expectation '%s'", rest.c_str());
+    }
+}
+
+static void command_line(const std::string& line)
+{
+    std::vector<std::string> args;
+    size_t pos = 0;
+
+    while (pos < line.size()) {
+        size_t start = line.find_first_not_of(" \t", pos);
+        if (start == std::string::npos) {
+            break;
+        }
+        size_t end = line.find_first_of(" \t", start);
+        if (end == std::string::npos) {
+            end = line.size();
+        }
+        args.push_back(line.substr(start, end - start));
+        pos = end;
+    }
+    if (args.empty() || (args[0][0] == '#')) {
+        return;
+    }
+
+    const std::string& cmd = args[0];
+    if ((cmd == "rtc") && (args.size() == 3)) {
+        struct tm tm;
+        memset(&tm, 0, sizeof(tm));
+        if (sscanf((args[1] + " " + args[2]).c_str(), "%d-%d-%d %d:%d:%d",
+                   &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+            fail("invalid date and time '%s'", line.c_str());
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        sim_rtc_set((uint32_t) timegm(&tm));
+    } else if ((cmd == "drift") && (args.size() == 2)) {
+        uint32_t now = sim_rtc_get();
+        rtc_drift_ppm = strtod(args[1].c_str(), NULL);
+        sim_rtc_set(now);
+    } else if ((cmd == "nvram") && (args.size() == 3)) {
+        sim_rtc_nvram_write(parse_number(args[1].c_str()), parse_number(args[2].c_str()));
+    } else if ((cmd == "boot") && (args.size() == 1)) {
+        if (booted) {
+            fail("%s", "already booted");
+        }
+        booted = true;
+        sim_firmware_setup();
+    } else if ((cmd == "run") && (args.size() == 2)) {
+        run_loop(sim_time + parse_duration(args[1].c_str()));
+    } else if ((cmd == "until") && (args.size() == 2)) {
+        uint32_t now = sim_rtc_get();
+        unsigned h, m, s = 0;
+        if (sscanf(args[1].c_str(), "%u:%u:%u", &h, &m, &s) < 2) {
+            fail("invalid time '%s'", args[1].c_str());
+        }
+        uint32_t target = now - (now % 86400) + (h * 3600) + (m * 60) + s;
+        if (target <= now) {
+            target += 86400;
+        }
+        run_until_rtc(target);
+    } else if ((cmd == "edges") && (args.size() == 2)) {
+        load_edges(args[1].c_str());
+    } else if ((cmd == "send") && (args.size() >= 2)) {
+        uint8_t payload[FRAGMENT_MAX_PAYLOAD + 1];
+        std::string text = line.substr(line.find("send") + 4);
+        text.erase(0, text.find_first_not_of(" \t"));
+        transmit(payload, parse_payload(text.c_str(), payload, sizeof(payload)));
+    } else if ((cmd == "resync") && (args.size() == 1)) {
+        transmit_packet(NULL, 0, true);
+    } else if ((cmd == "counter") && (args.size() == 2)) {
+        tx_counter = parse_number(args[1].c_str());
+    } else if ((cmd == "press") && (args.size() == 3)) {
+        sim_event_type_t button = SIM_EVENT_LEFT;
+        if (args[1] == "right") {
+            button = SIM_EVENT_RIGHT;
+        } else if (args[1] == "ext") {
+            button = SIM_EVENT_EXT;
+        } else if (args[1] != "left") {
+            fail("unknown button '%s'", args[1].c_str());
+        }
+        sim_schedule(sim_time, button, 1);
+        sim_schedule(sim_time + parse_duration(args[2].c_str()), button, 0);
+    } else if ((cmd == "switch") && (args.size() == 2)) {
+        sim_schedule(sim_time, SIM_EVENT_SWITCH, args[1] == "on");
+    } else if ((cmd == "serial") && (args.size() == 2)) {
+        serial_input += args[1];
+    } else if ((cmd == "trace") && (args.size() == 2)) {
+        trace = (args[1] == "on");
+    } else if ((cmd == "dump") && (args.size() <= 2)) {
+        dump((args.size() == 2) ? args[1].c_str() : NULL);
+    } else if (cmd == "expect") {
+        expect(args, line);
+    } else if (cmd == "echo") {
+        print_time(stdout);
+        printf("%s\n", line.c_str() + line.find("echo") + 4 + ((line.size() > 5) ? 1 : 0));
+    } else {
+        fail("invalid command '%s'", line.c_str());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    FILE* fd = stdin;
+    char buffer[BUFSIZ];
+    struct timespec start, end;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: %s [script]\n", argv[0]);
+        return 1;
+    }
+    script_name = "<stdin>";
+    if (argc == 2) {
+        script_name = argv[1];
+        fd = fopen(script_name, "rt");
+        if (!fd) {
+            perror("unable to read script");
+            return 1;
+        }
+    }
+    // DS1307 NVRAM contents are undefined at power on
+    memset(rtc_nvram, 0xff, sizeof(rtc_nvram));
+    if (!ncrs_init()) {
+        fprintf(stderr, "ncrs_init() failed\n");
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (fgets(buffer, sizeof(buffer), fd)) {
+        std::string line = buffer;
+        script_line++;
+        while ((!line.empty()) && ((line.back() == '\n') || (line.back() == '\r'))) {
+            line.pop_back();
+        }
+        command_line(line);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double elapsed = (double) (end.tv_sec - start.tv_sec) + ((double) (end.tv_nsec - start.tv_nsec) * 1e-9);
+    printf("simulated %.1f s in %.2f s: %llu loops, %llu I2C bytes (%.1f%% of the time), "
+           "%llu NeoPixel updates, %llu tones\n",
+           (double) sim_time / 1e6, elapsed, (unsigned long long) loops,
+           (unsigned long long) i2c_bytes, sim_time ? (100.0 * i2c_time / sim_time) : 0.0,
+           (unsigned long long) neopixel_updates, (unsigned long long) tones);
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef SIM_H
+#define SIM_H
+
+// Host simulation of the cpeclock firmware: virtual time, events and devices
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SIM_SCREEN_WIDTH    128
+#define SIM_SCREEN_PAGES    8
+#define SIM_NUM_LEDS        10
+#define SIM_NVRAM_SIZE      56
+
+typedef enum {
+    SIM_EVENT_EDGE,         // rising edge from the 433MHz receiver
+    SIM_EVENT_LEFT,         // arg = button state
+    SIM_EVENT_RIGHT,
+    SIM_EVENT_EXT,
+    SIM_EVENT_SWITCH,
+} sim_event_type_t;
+
+// Virtual time in microseconds since the simulation began
+extern uint64_t sim_time;
+
+// Schedule an event
+void sim_schedule(uint64_t when, sim_event_type_t type, int arg);
+
+// Move virtual time forwards to "until", delivering events on the way.
+// If interrupts are disabled, an interrupt is delivered at the end instead.
+void sim_advance(uint64_t until, bool interrupts_enabled);
+
+// Time spent by the CPU or a bus transfer
+void sim_spend(uint32_t us);
+
+// Until the next event, or the next SysTick (1ms)
+void sim_wait_for_interrupt(void);
+
+// Interrupts
+void sim_attach_interrupt(uint8_t pin, void (*handler)(void), int mode);
+void sim_set_interrupts_enabled(bool enabled);
+bool sim_interrupts_enabled(void);
+
+// Inputs
+bool sim_input(sim_event_type_t type);
+
+// Devices
+void sim_i2c_transfer(uint8_t address, const uint8_t* data, size_t size, uint32_t clock);
+void sim_i2c_read(uint8_t address, size_t size, uint32_t clock);
+void sim_neopixel_show(const uint8_t* pixels, uint16_t count, bool interrupts_enabled);
+void sim_tone(uint16_t freq, uint16_t time, bool enabled);
+void sim_serial_write(const char* text);
+void sim_serial_write_binary(const uint8_t* data, size_t size);
+int sim_serial_available(void);
+int sim_serial_read(void);
+
+// DS1307
+uint32_t sim_rtc_get(void);
+void sim_rtc_set(uint32_t unixtime);
+void sim_rtc_set_sqw(bool enabled);
+uint8_t sim_rtc_nvram_read(uint8_t address);
+void sim_rtc_nvram_write(uint8_t address, uint8_t data);
+
+// Text drawn by Adafruit_GFX since the display was last cleared
+void sim_text_clear(void);
+void sim_text_add(char c);
+
+// Provided by firmware.cpp
+void sim_firmware_setup(void);
+void sim_firmware_loop(void);
+unsigned sim_firmware_alarm_active(void);
+
+#endif
@@ -0,0 +1,695 @@
+// Host simulation: implementations of the Arduino and library APIs used by
+// cpeclock.ino. Anything involving time or hardware is passed to sim.cpp.
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "Adafruit_GFX.h"
+#include "Adafruit_SSD1306.h"
+#include "Adafruit_NeoPixel.h"
+#include "Adafruit_NeoPixel_ZeroDMA.h"
+#include "Adafruit_CircuitPlayground.h"
+#include "RTClib.h"
+
+#include "sim.h"
+
+#define I2C_DEFAULT_CLOCK   100000
+#define SSD1306_CHUNK_SIZE  31          // WIRE_MAX - 1 in Adafruit_SSD1306
+#define DS1307_ADDRESS      0x68
+
+SimSerial Serial;
+TwoWire Wire(0);
+TwoWire Wire1(1);
+Adafruit_CircuitPlayground CircuitPlayground;
+
+static uint8_t pin_output[NUM_PINS];
+
+// Arduino core
+
+extern "C" uint32_t millis(void)
+{
+    return (uint32_t) (sim_time / 1000);
+}
+
+extern "C" uint32_t micros(void)
+{
+    return (uint32_t) sim_time;
+}
+
+extern "C" void delay(uint32_t ms)
+{
+    sim_advance(sim_time + ((uint64_t) ms * 1000), true);
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    if (pin < NUM_PINS) {
+        pin_output[pin] = value;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    if (pin == PIN_A3) {
+        // extension button
+        return sim_input(SIM_EVENT_EXT) ? HIGH : LOW;
+    }
+    return (pin < NUM_PINS) ? pin_output[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode)
+{
+    sim_attach_interrupt(interrupt, handler, mode);
+}
+
+void noInterrupts(void)
+{
+    sim_set_interrupts_enabled(false);
+}
+
+void interrupts(void)
+{
+    sim_set_interrupts_enabled(true);
+}
+
+void __WFI(void)
+{
+    sim_wait_for_interrupt();
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return sim_interrupts_enabled() ? 0 : 1;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+    sim_set_interrupts_enabled(!(primask & 1));
+}
+
+void __disable_irq(void)
+{
+    sim_set_interrupts_enabled(false);
+}
+
+// SysTick counts down once per millisecond. Virtual time does not move while
+// interrupts are disabled, so a SysTick interrupt is never pending.
+
+SysTick_Type* sim_systick(void)
+{
+    static SysTick_Type systick;
+    uint32_t cycles_per_us = F_CPU / 1000000;
+
+    systick.LOAD = (F_CPU / 1000) - 1;
+    systick.VAL = systick.LOAD - ((uint32_t) (sim_time % 1000) * cycles_per_us);
+    return &systick;
+}
+
+SCB_Type* sim_scb(void)
+{
+    static SCB_Type scb;
+    return &scb;
+}
+
+// Serial
+
+void SimSerial::begin(unsigned long baud) {}
+void SimSerial::flush(void) {}
+int SimSerial::available(void) { return sim_serial_available(); }
+int SimSerial::read(void) { return sim_serial_read(); }
+
+size_t SimSerial::write(const uint8_t* data, size_t size)
+{
+    sim_serial_write_binary(data, size);
+    return size;
+}
+
+void SimSerial::print(const char* text)
+{
+    sim_serial_write(text);
+}
+
+void SimSerial::print(char c)
+{
+    char tmp[2] = {c, '\0'};
+    sim_serial_write(tmp);
+}
+
+void SimSerial::print(int value) { print((long) value); }
+void SimSerial::print(unsigned value) { print((unsigned long) value); }
+
+void SimSerial::print(long value)
+{
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), "%ld", value);
+    sim_serial_write(tmp);
+}
+
+void SimSerial::print(unsigned long value)
+{
+    char tmp[24];
+    snprintf(tmp, sizeof(tmp), "%lu", value);
+    sim_serial_write(tmp);
+}
+
+void SimSerial::println(void) { sim_serial_write("\n"); }
+void SimSerial::println(const char* text) { print(text); println(); }
+void SimSerial::println(int value) { print(value); println(); }
+void SimSerial::println(unsigned value) { print(value); println(); }
+void SimSerial::println(long value) { print(value); println(); }
+void SimSerial::println(unsigned long value) { print(value); println(); }
+
+// I2C
+
+TwoWire::TwoWire(uint8_t bus) : bus(bus), address(0), clock(I2C_DEFAULT_CLOCK), size(0) {}
+
+void TwoWire::begin(void) {}
+
+void TwoWire::setClock(uint32_t clock)
+{
+    this->clock = clock;
+}
+
+uint32_t TwoWire::getClock(void) const
+{
+    return clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    this->address = address;
+    size = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (size >= sizeof(buffer)) {
+        return 0;
+    }
+    buffer[size++] = data;
+    return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool stop)
+{
+    sim_i2c_transfer(address, buffer, size, clock);
+    size = 0;
+    return 0;
+}
+
+// Adafruit_GFX: text with GFX fonts
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+    : _width(w), _height(h), cursor_x(0), cursor_y(0), textcolor(1),
+      textsize(1), wrap(true), gfxFont(NULL) {}
+
+void Adafruit_GFX::setCursor(int16_t x, int16_t y)
+{
+    cursor_x = x;
+    cursor_y = y;
+}
+
+void Adafruit_GFX::setTextColor(uint16_t color) { textcolor = color; }
+void Adafruit_GFX::setTextSize(uint8_t size) { textsize = (size > 0) ? size : 1; }
+void Adafruit_GFX::setTextWrap(bool wrap) { this->wrap = wrap; }
+void Adafruit_GFX::setFont(const GFXfont* font) { gfxFont = font; }
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, uint8_t c, uint16_t color, uint8_t size)
+{
+    const GFXglyph* glyph = &gfxFont->glyph[c - gfxFont->first];
+    const uint8_t* bitmap = &gfxFont->bitmap[glyph->bitmapOffset];
+    uint8_t bits = 0;
+    uint16_t bit = 0;
+
+    for (uint8_t yy = 0; yy < glyph->height; yy++) {
+        for (uint8_t xx = 0; xx < glyph->width; xx++) {
+            if (!(bit++ & 7)) {
+                bits = *bitmap++;
+            }
+            if (bits & 0x80) {
+                for (uint8_t sy = 0; sy < size; sy++) {
+                    for (uint8_t sx = 0; sx < size; sx++) {
+                        drawPixel(x + ((glyph->xOffset + xx) * size) + sx,
+                                  y + ((glyph->yOffset + yy) * size) + sy, color);
+                    }
+                }
+            }
+            bits <<= 1;
+        }
+    }
+}
+
+size_t Adafruit_GFX::write(uint8_t c)
+{
+    if (!gfxFont) {
+        return 1;
+    }
+    sim_text_add(c);
+    if (c == '\n') {
+        cursor_x = 0;
+        cursor_y += (int16_t) textsize * gfxFont->yAdvance;
+    } else if ((c != '\r') && (c >= gfxFont->first) && (c <= gfxFont->last)) {
+        const GFXglyph* glyph = &gfxFont->glyph[c - gfxFont->first];
+        if (glyph->width && glyph->height) {
+            if (wrap && ((cursor_x + textsize * (glyph->xOffset + glyph->width)) > _width)) {
+                cursor_x = 0;
+                cursor_y += (int16_t) textsize * gfxFont->yAdvance;
+            }
+            drawChar(cursor_x, cursor_y, c, textcolor, textsize);
+        }
+        cursor_x += glyph->xAdvance * (int16_t) textsize;
+    }
+    return 1;
+}
+
+void Adafruit_GFX::print(const char* text)
+{
+    while (*text) {
+        write(*text++);
+    }
+}
+
+void Adafruit_GFX::println(const char* text)
+{
+    print(text);
+    write('\n');
+}
+
+void Adafruit_GFX::getTextBounds(const char* text, int16_t x, int16_t y,
+                                 int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h)
+{
+    int16_t minx = 0x7fff, miny = 0x7fff, maxx = -1, maxy = -1;
+
+    *x1 = x;
+    *y1 = y;
+    *w = *h = 0;
+    if (!gfxFont) {
+        return;
+    }
+    for (; *text; text++) {
+        uint8_t c = *text;
+        if (c == '\n') {
+            x = 0;
+            y += textsize * gfxFont->yAdvance;
+        } else if ((c != '\r') && (c >= gfxFont->first) && (c <= gfxFont->last)) {
+            const GFXglyph* glyph = &gfxFont->glyph[c - gfxFont->first];
+            int16_t gx1 = x + glyph->xOffset * textsize;
+            int16_t gy1 = y + glyph->yOffset * textsize;
+            int16_t gx2 = gx1 + glyph->width * textsize - 1;
+            int16_t gy2 = gy1 + glyph->height * textsize - 1;
+            if (glyph->width && glyph->height) {
+                minx = (gx1 < minx) ? gx1 : minx;
+                miny = (gy1 < miny) ? gy1 : miny;
+                maxx = (gx2 > maxx) ? gx2 : maxx;
+                maxy = (gy2 > maxy) ? gy2 : maxy;
+            }
+            x += glyph->xAdvance * textsize;
+        }
+    }
+    if (maxx >= minx) {
+        *x1 = minx;
+        *w = maxx - minx + 1;
+    }
+    if (maxy >= miny) {
+        *y1 = miny;
+        *h = maxy - miny + 1;
+    }
+}
+
+// Adafruit_SSD1306
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t rst_pin,
+                                   uint32_t clkDuring, uint32_t clkAfter)
+    : Adafruit_GFX(w, h), wire(twi), buffer(NULL), i2caddr(0), vccstate(0),
+      wireClk(clkDuring), restoreClk(clkAfter) {}
+
+Adafruit_SSD1306::~Adafruit_SSD1306()
+{
+    free(buffer);
+}
+
+bool Adafruit_SSD1306::begin(uint8_t switchvcc, uint8_t i2caddr, bool reset, bool periphBegin)
+{
+    static const uint8_t init[] = {
+        SSD1306_DISPLAYOFF, SSD1306_CHARGEPUMP, 0x14,
+        SSD1306_MEMORYMODE, 0x00, SSD1306_SETCONTRAST, 0xcf, SSD1306_DISPLAYON,
+    };
+
+    buffer = (uint8_t*) calloc(1, _width * ((_height + 7) / 8));
+    if (!buffer) {
+        return false;
+    }
+    this->i2caddr = i2caddr;
+    vccstate = switchvcc;
+    for (size_t i = 0; i < sizeof(init); i++) {
+        ssd1306_command(init[i]);
+    }
+    return true;
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c)
+{
+    // The real library raises the clock for each transaction, then restores it
+    wire->setClock(wireClk);
+    wire->beginTransmission(i2caddr);
+    wire->write((uint8_t) 0x00);
+    wire->write(c);
+    wire->endTransmission();
+    wire->setClock(restoreClk);
+}
+
+void Adafruit_SSD1306::display(void)
+{
+    size_t size = _width * ((_height + 7) / 8);
+
+    ssd1306_command(SSD1306_PAGEADDR);
+    ssd1306_command(0);
+    ssd1306_command(0xff);
+    ssd1306_command(SSD1306_COLUMNADDR);
+    ssd1306_command(0);
+    ssd1306_command(_width - 1);
+    wire->setClock(wireClk);
+    for (size_t i = 0; i < size; i += SSD1306_CHUNK_SIZE) {
+        wire->beginTransmission(i2caddr);
+        wire->write((uint8_t) 0x40);
+        for (size_t j = i; (j < size) && (j < (i + SSD1306_CHUNK_SIZE)); j++) {
+            wire->write(buffer[j]);
+        }
+        wire->endTransmission();
+    }
+    wire->setClock(restoreClk);
+}
+
+void Adafruit_SSD1306::clearDisplay(void)
+{
+    memset(buffer, 0, _width * ((_height + 7) / 8));
+    sim_text_clear();
+}
+
+void Adafruit_SSD1306::dim(bool dim)
+{
+    ssd1306_command(SSD1306_SETCONTRAST);
+    ssd1306_command(dim ? 0 : ((vccstate == SSD1306_EXTERNALVCC) ? 0x9f : 0xcf));
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+    if ((x < 0) || (x >= _width) || (y < 0) || (y >= _height)) {
+        return;
+    }
+    uint8_t* byte = &buffer[x + (y / 8) * _width];
+    uint8_t mask = 1 << (y & 7);
+    switch (color) {
+        case SSD1306_WHITE: *byte |= mask; break;
+        case SSD1306_BLACK: *byte &= ~mask; break;
+        case SSD1306_INVERSE: *byte ^= mask; break;
+    }
+}
+
+uint8_t* Adafruit_SSD1306::getBuffer(void)
+{
+    return buffer;
+}
+
+// Adafruit_NeoPixel
+
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t pin, uint16_t type)
+    : numLEDs(n), brightness(0)
+{
+    pixels = (uint8_t*) calloc(3, n);
+}
+
+Adafruit_NeoPixel::~Adafruit_NeoPixel()
+{
+    free(pixels);
+}
+
+bool Adafruit_NeoPixel::begin(void)
+{
+    return true;
+}
+
+void Adafruit_NeoPixel::show(void)
+{
+    sim_neopixel_show(pixels, numLEDs, false);
+}
+
+void Adafruit_NeoPixel_ZeroDMA::show(void)
+{
+    sim_neopixel_show(pixels, numLEDs, true);
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b)
+{
+    if (n >= numLEDs) {
+        return;
+    }
+    if (brightness) {
+        r = (r * brightness) >> 8;
+        g = (g * brightness) >> 8;
+        b = (b * brightness) >> 8;
+    }
+    pixels[(n * 3) + 0] = r;
+    pixels[(n * 3) + 1] = g;
+    pixels[(n * 3) + 2] = b;
+}
+
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c)
+{
+    setPixelColor(n, (uint8_t) (c >> 16), (uint8_t) (c >> 8), (uint8_t) c);
+}
+
+void Adafruit_NeoPixel::fill(uint32_t c, uint16_t first, uint16_t count)
+{
+    uint16_t end = (count == 0) ? numLEDs : (first + count);
+    for (uint16_t i = first; (i < end) && (i < numLEDs); i++) {
+        setPixelColor(i, c);
+    }
+}
+
+void Adafruit_NeoPixel::clear(void)
+{
+    memset(pixels, 0, numLEDs * 3);
+}
+
+// As in the real library, the stored colours are rescaled, losing precision
+void Adafruit_NeoPixel::setBrightness(uint8_t b)
+{
+    uint8_t newBrightness = b + 1;
+    if (newBrightness != brightness) {
+        uint8_t oldBrightness = brightness - 1;
+        uint16_t scale;
+        if (oldBrightness == 0) {
+            scale = 0;
+        } else if (b == 255) {
+            scale = 65535 / oldBrightness;
+        } else {
+            scale = (((uint16_t) newBrightness << 8) - 1) / oldBrightness;
+        }
+        for (uint16_t i = 0; i < (numLEDs * 3); i++) {
+            pixels[i] = (pixels[i] * scale) >> 8;
+        }
+        brightness = newBrightness;
+    }
+}
+
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const
+{
+    if (n >= numLEDs) {
+        return 0;
+    }
+    return Color(pixels[(n * 3) + 0], pixels[(n * 3) + 1], pixels[(n * 3) + 2]);
+}
+
+// Adafruit_CircuitPlayground
+
+bool Adafruit_CircuitPlayground::begin(uint8_t brightness)
+{
+    strip.begin();
+    strip.show();
+    strip.setBrightness(brightness);
+    return true;
+}
+
+bool Adafruit_CircuitPlayground::slideSwitch(void)
+{
+    return sim_input(SIM_EVENT_SWITCH);
+}
+
+bool Adafruit_CircuitPlayground::leftButton(void)
+{
+    return sim_input(SIM_EVENT_LEFT);
+}
+
+bool Adafruit_CircuitPlayground::rightButton(void)
+{
+    return sim_input(SIM_EVENT_RIGHT);
+}
+
+void Adafruit_CircuitPlayground::playTone(uint16_t freq, uint16_t time, bool wait)
+{
+    sim_tone(freq, time, speaker.enabled);
+    if (wait) {
+        delay(time);
+    }
+}
+
+// RTClib
+
+static const uint8_t days_in_month[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30};
+
+static uint16_t date2days(uint16_t y, uint8_t m, uint8_t d)
+{
+    if (y >= 2000U) {
+        y -= 2000U;
+    }
+    uint16_t days = d;
+    for (uint8_t i = 1; i < m; ++i) {
+        days += days_in_month[i - 1];
+    }
+    if ((m > 2) && ((y % 4) == 0)) {
+        ++days;
+    }
+    return days + 365 * y + (y + 3) / 4 - 1;
+}
+
+TimeSpan::TimeSpan(int32_t seconds) : _seconds(seconds) {}
+
+TimeSpan::TimeSpan(int16_t days, int8_t hours, int8_t minutes, int8_t seconds)
+    : _seconds((int32_t) days * 86400L + (int32_t) hours * 3600 + (int32_t) minutes * 60 + seconds) {}
+
+TimeSpan TimeSpan::operator+(const TimeSpan& right) const
+{
+    return TimeSpan(_seconds + right._seconds);
+}
+
+TimeSpan TimeSpan::operator-(const TimeSpan& right) const
+{
+    return TimeSpan(_seconds - right._seconds);
+}
+
+DateTime::DateTime(uint32_t t)
+{
+    t -= SECONDS_FROM_1970_TO_2000;
+    ss = t % 60;
+    t /= 60;
+    mm = t % 60;
+    t /= 60;
+    hh = t % 24;
+    uint16_t days = t / 24;
+    uint8_t leap;
+    for (yOff = 0;; ++yOff) {
+        leap = (yOff % 4) == 0;
+        if (days < (365U + leap)) {
+            break;
+        }
+        days -= 365 + leap;
+    }
+    for (m = 1; m < 12; ++m) {
+        uint8_t month_days = days_in_month[m - 1];
+        if (leap && (m == 2)) {
+            ++month_days;
+        }
+        if (days < month_days) {
+            break;
+        }
+        days -= month_days;
+    }
+    d = days + 1;
+}
+
+DateTime::DateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t min, uint8_t sec)
+{
+    if (year >= 2000U) {
+        year -= 2000U;
+    }
+    yOff = year;
+    m = month;
+    d = day;
+    hh = hour;
+    mm = min;
+    ss = sec;
+}
+
+uint8_t DateTime::dayOfTheWeek(void) const
+{
+    uint16_t day = date2days(yOff, m, d);
+    return (day + 6) % 7; // Jan 1, 2000 is a Saturday
+}
+
+uint32_t DateTime::unixtime(void) const
+{
+    uint16_t days = date2days(yOff, m, d);
+    return ((((uint32_t) days * 24 + hh) * 60 + mm) * 60 + ss) + SECONDS_FROM_1970_TO_2000;
+}
+
+DateTime DateTime::operator+(const TimeSpan& span) const
+{
+    return DateTime(unixtime() + span.totalseconds());
+}
+
+DateTime DateTime::operator-(const TimeSpan& span) const
+{
+    return DateTime(unixtime() - span.totalseconds());
+}
+
+TimeSpan DateTime::operator-(const DateTime& right) const
+{
+    return TimeSpan((int32_t) (unixtime() - right.unixtime()));
+}
+
+bool RTC_DS1307::begin(TwoWire* wire)
+{
+    this->wire = wire;
+    return true;
+}
+
+uint8_t RTC_DS1307::isrunning(void)
+{
+    return 1;
+}
+
+void RTC_DS1307::adjust(const DateTime& dt)
+{
+    uint8_t data[8] = {0};
+    sim_i2c_transfer(DS1307_ADDRESS, data, sizeof(data), wire->getClock());
+    sim_rtc_set(dt.unixtime());
+}
+
+DateTime RTC_DS1307::now(void)
+{
+    uint8_t data[1] = {0};
+    sim_i2c_transfer(DS1307_ADDRESS, data, sizeof(data), wire->getClock());
+    sim_i2c_read(DS1307_ADDRESS, 7, wire->getClock());
+    return DateTime(sim_rtc_get());
+}
+
+Ds1307SqwPinMode RTC_DS1307::readSqwPinMode(void)
+{
+    return DS1307_OFF;
+}
+
+void RTC_DS1307::writeSqwPinMode(Ds1307SqwPinMode mode)
+{
+    uint8_t data[2] = {7, (uint8_t) mode};
+    sim_i2c_transfer(DS1307_ADDRESS, data, sizeof(data), wire->getClock());
+    sim_rtc_set_sqw(mode == DS1307_SquareWave1HZ);
+}
+
+uint8_t RTC_DS1307::readnvram(uint8_t address)
+{
+    uint8_t data[1] = {(uint8_t) (address + 8)};
+    sim_i2c_transfer(DS1307_ADDRESS, data, sizeof(data), wire->getClock());
+    sim_i2c_read(DS1307_ADDRESS, 1, wire->getClock());
+    return sim_rtc_nvram_read(address);
+}
+
+void RTC_DS1307::writenvram(uint8_t address, uint8_t data)
+{
+    uint8_t tmp[2] = {(uint8_t) (address + 8), data};
+    sim_i2c_transfer(DS1307_ADDRESS, tmp, sizeof(tmp), wire->getClock());
+    sim_rtc_nvram_write(address, data);
+}
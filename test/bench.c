@@ -0,0 +1,342 @@
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ticks.h"
+#include "rx433.h"
+#include "ncrs.h"
+#include "rslib.h"
+#include "sha256.h"
+#include "hmac.h"
+#include "hmac433.h"
+#include "libnc.h"
+
+// Microbenchmarks for the receive path. Each benchmark is timed in samples of
+// "batch" operations; after some warm-up samples, the median and 99th percentile
+// of the time per operation are reported as JSON. Usage:
+//
+//   ./bench.exe [-o results.json] [-c baseline.json] [-t percent]
+//
+// With -c, a benchmark fails if its median is more than "percent" (default 10)
+// slower than in the baseline.
+
+#define WARM_UP         20
+#define SAMPLES         200
+#define MAX_BENCHMARKS  16
+#define NAME_SIZE       32
+
+#define MESSAGE_GAP     10000   // microseconds between new codes
+#define MAX_EDGES       LIBNC_NC_MAX_PULSES
+
+#define SECRET_DATA     "secret"
+#define SECRET_SIZE     6
+
+typedef struct result_s {
+    char        name[NAME_SIZE];
+    double      median;
+    double      p99;
+    unsigned    batch;
+} result_t;
+
+static result_t results[MAX_BENCHMARKS];
+static unsigned num_results = 0;
+static volatile uint32_t sink = 0;
+
+// rx433_interrupt input: the rising edges of a new code
+uint32_t test_time = 0;
+static uint32_t edges[MAX_EDGES];
+static unsigned num_edges = 0;
+static unsigned edge_index = 0;
+static uint32_t edge_offset = 0;
+
+static uint8_t TEST_CODE[NC_DATA_SIZE] =
+    {6, 23, 31, 29, 26, 21, 1, 18, 1, 4, 20, 27, 22, 27, 29, 16, 9, 22, 25, 28, 20, 13, 15, 18, 16, 21, 17, 31, 1, 1, 2};
+
+// ncrs and decode_rs8 input
+static struct rs_control* rs = NULL;
+static uint8_t encoded[NC_DATA_SIZE];
+static uint8_t damaged[NC_DATA_SIZE];
+static uint8_t packed[RX433_PACKED_SIZE];
+static uint8_t decoded[DECODED_DATA_BYTES];
+static uint8_t rs_data[MSG_SYMBOLS];
+static uint16_t rs_parity[NROOTS];
+
+// sha256, hmac and hmac433 input
+static SHA256_CTX sha;
+static uint8_t block[64];
+static uint8_t digest[HMAC_DIGEST_SIZE];
+static hmac433_packet_t packet;
+static uint64_t packet_counter = 0;
+
+
+uint32_t micros()
+{
+    return test_time;
+}
+
+static void fail(const char* what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(1);
+}
+
+// Edges of the pulse table which txnc433 sends for the test code
+static void make_edges(void)
+{
+    libnc_pulse_t pulses[LIBNC_NC_MAX_PULSES];
+    size_t count = libnc_nc_pulses(TEST_CODE, NULL, pulses, LIBNC_NC_MAX_PULSES);
+
+    if (count == 0) {
+        fail("libnc_nc_pulses");
+    }
+    num_edges = libnc_edges(pulses, count, edges);
+}
+
+static void op_rx433_interrupt(void)
+{
+    test_time = edge_offset + edges[edge_index];
+    rx433_interrupt();
+    edge_index++;
+    if (edge_index >= num_edges) {
+        edge_index = 0;
+        edge_offset = test_time + MESSAGE_GAP;
+    }
+}
+
+static void op_ncrs_encode(void)
+{
+    ncrs_encode(encoded, decoded);
+}
+
+static void op_ncrs_decode(void)
+{
+    sink += ncrs_decode(decoded, encoded);
+}
+
+static void op_ncrs_decode_damaged(void)
+{
+    sink += ncrs_decode(decoded, damaged);
+}
+
+static void op_ncrs_decode_packed(void)
+{
+    sink += ncrs_decode_packed(decoded, packed);
+}
+
+static void op_decode_rs8(void)
+{
+    uint8_t data[MSG_SYMBOLS];
+    uint16_t parity[NROOTS];
+
+    memcpy(data, rs_data, sizeof(data));
+    memcpy(parity, rs_parity, sizeof(parity));
+    sink += decode_rs8(rs, data, parity, MSG_SYMBOLS, NULL, 0, NULL, 0, NULL);
+}
+
+static void op_sha256_block(void)
+{
+    // one call to sha256_transform per update
+    sha256_update(&sha, block, sizeof(block));
+}
+
+static void op_hmac_sha256(void)
+{
+    hmac_sha256((const uint8_t*) SECRET_DATA, SECRET_SIZE, &packet_counter,
+                packet.payload, PACKET_PAYLOAD_SIZE, digest);
+}
+
+static void op_hmac433_authenticate(void)
+{
+    uint64_t counter = packet_counter;
+    sink += hmac433_authenticate((const uint8_t*) SECRET_DATA, SECRET_SIZE,
+                                 &packet, &counter);
+}
+
+static void setup(void)
+{
+    uint64_t counter = 0;
+    unsigned i;
+
+    make_edges();
+
+    if (!ncrs_init()) {
+        fail("ncrs_init");
+    }
+    rs = init_rs(SYMBOL_SIZE, GFPOLY, FCR, PRIM, NROOTS);
+    if (!rs) {
+        fail("init_rs");
+    }
+    for (i = 0; i < DECODED_DATA_BYTES; i++) {
+        decoded[i] = i * 37;
+    }
+    ncrs_encode(encoded, decoded);
+    ncrs_pack(packed, encoded);
+    memcpy(damaged, encoded, NC_DATA_SIZE);
+    damaged[3] ^= 1;
+    damaged[17] ^= 4;
+    if ((ncrs_decode(decoded, encoded) != 1) || (ncrs_decode(decoded, damaged) <= 1)) {
+        fail("ncrs_decode");
+    }
+
+    // Same interleaving as ncrs_decode, with two errors to correct
+    for (i = 0; i < NROOTS; i++) {
+        rs_data[i * 2 + 0] = encoded[i * 3 + 0];
+        rs_data[i * 2 + 1] = encoded[i * 3 + 1];
+        rs_parity[i] = encoded[i * 3 + 2];
+    }
+    rs_data[NROOTS * 2] = encoded[NROOTS * 3];
+    rs_data[1] ^= 2;
+    rs_data[9] ^= 8;
+
+    sha256_init(&sha);
+    memset(block, 0x5a, sizeof(block));
+
+    memset(&packet, 0, sizeof(packet));
+    memcpy(packet.payload, "bench!", PACKET_PAYLOAD_SIZE);
+    hmac433_encode((const uint8_t*) SECRET_DATA, SECRET_SIZE, &packet, &counter);
+    packet_counter = 0;
+    if (!hmac433_authenticate((const uint8_t*) SECRET_DATA, SECRET_SIZE, &packet, &counter)) {
+        fail("hmac433_authenticate");
+    }
+}
+
+static int compare_double(const void* a, const void* b)
+{
+    double x = *((const double*) a);
+    double y = *((const double*) b);
+    return (x > y) - (x < y);
+}
+
+static void run(const char* name, void (*op)(void), unsigned batch)
+{
+    double samples[SAMPLES];
+    result_t* r;
+    unsigned i, j;
+
+    if (num_results >= MAX_BENCHMARKS) {
+        fail("too many benchmarks");
+    }
+    for (i = 0; i < (WARM_UP + SAMPLES); i++) {
+        uint64_t start = ticks();
+        for (j = 0; j < batch; j++) {
+            op();
+        }
+        if (i >= WARM_UP) {
+            samples[i - WARM_UP] = (double) (ticks() - start) / batch;
+        }
+    }
+    qsort(samples, SAMPLES, sizeof(double), compare_double);
+
+    r = &results[num_results++];
+    snprintf(r->name, NAME_SIZE, "%s", name);
+    r->median = samples[SAMPLES / 2];
+    r->p99 = samples[(SAMPLES * 99) / 100];
+    r->batch = batch;
+    printf("%-24s median %10.1f p99 %10.1f %s\n", name, r->median, r->p99, TICK_UNIT);
+}
+
+static void write_json(const char* file_name)
+{
+    FILE* fd = fopen(file_name, "wt");
+    unsigned i;
+
+    if (!fd) {
+        perror("unable to write results");
+        exit(1);
+    }
+    // One benchmark per line: compare() relies on this
+    fprintf(fd, "{\n  \"unit\": \"%s\",\n  \"samples\": %u,\n  \"benchmarks\": [\n",
+            TICK_UNIT, SAMPLES);
+    for (i = 0; i < num_results; i++) {
+        fprintf(fd, "    {\"name\": \"%s\", \"median\": %.2f, \"p99\": %.2f, \"batch\": %u}%s\n",
+                results[i].name, results[i].median, results[i].p99, results[i].batch,
+                (i + 1) < num_results ? "," : "");
+    }
+    fprintf(fd, "  ]\n}\n");
+    fclose(fd);
+}
+
+// Returns the number of regressions against the baseline
+static unsigned compare(const char* file_name, double threshold)
+{
+    FILE* fd = fopen(file_name, "rt");
+    char line[256];
+    char unit[NAME_SIZE] = "";
+    unsigned regressions = 0;
+    unsigned i;
+
+    if (!fd) {
+        perror("unable to read baseline");
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), fd)) {
+        char name[NAME_SIZE];
+        double median;
+
+        if (sscanf(line, " \"unit\": \"%31[^\"]\"", unit) == 1) {
+            if (strcmp(unit, TICK_UNIT) != 0) {
+                fprintf(stderr, "baseline is measured in %s, not %s\n", unit, TICK_UNIT);
+                exit(1);
+            }
+        } else if (sscanf(line, " {\"name\": \"%31[^\"]\", \"median\": %lf", name, &median) == 2) {
+            for (i = 0; i < num_results; i++) {
+                if (strcmp(name, results[i].name) == 0) {
+                    double change = ((results[i].median / median) - 1.0) * 100.0;
+                    int slower = change > threshold;
+                    printf("%-24s %10.1f -> %10.1f %+6.1f%%%s\n", name,
+                           median, results[i].median, change,
+                           slower ? " REGRESSION" : "");
+                    regressions += slower;
+                }
+            }
+        }
+    }
+    fclose(fd);
+    return regressions;
+}
+
+int main(int argc, char** argv)
+{
+    const char* output = NULL;
+    const char* baseline = NULL;
+    double threshold = 10.0;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-o") == 0) && ((i + 1) < argc)) {
+            output = argv[++i];
+        } else if ((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc)) {
+            baseline = argv[++i];
+        } else if ((strcmp(argv[i], "-t") == 0) && ((i + 1) < argc)) {
+            threshold = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [-o results.json] [-c baseline.json] [-t percent]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    setup();
+    run("rx433_interrupt", op_rx433_interrupt, 1000);
+    if (!rx433_new_code_ready) {
+        fail("rx433_interrupt did not receive the new code");
+    }
+    run("ncrs_encode", op_ncrs_encode, 100);
+    run("ncrs_decode", op_ncrs_decode, 100);
+    run("ncrs_decode_damaged", op_ncrs_decode_damaged, 100);
+    run("ncrs_decode_packed", op_ncrs_decode_packed, 100);
+    run("decode_rs8", op_decode_rs8, 100);
+    run("sha256_block", op_sha256_block, 100);
+    run("hmac_sha256", op_hmac_sha256, 100);
+    run("hmac433_authenticate", op_hmac433_authenticate, 100);
+
+    if (output) {
+        write_json(output);
+    }
+    if (baseline && (compare(baseline, threshold) != 0)) {
+        fprintf(stderr, "slower than the baseline by more than %.1f%%\n", threshold);
+        return 1;
+    }
+    return 0;
+}
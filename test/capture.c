@@ -0,0 +1,116 @@
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+
+static uint32_t get32(const uint8_t* in)
+{
+    return (uint32_t) in[0] | ((uint32_t) in[1] << 8)
+        | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+static uint16_t get16(const uint8_t* in)
+{
+    return (uint16_t) (in[0] | (in[1] << 8));
+}
+
+static int fail(capture_t* cap, const char** error, const char* message)
+{
+    if (error) {
+        *error = message;
+    }
+    capture_close(cap);
+    return 0;
+}
+
+int capture_open(capture_t* cap, const char* filename, const char** error)
+{
+    struct stat st;
+    const uint8_t* in;
+    uint32_t data_size;
+    int fd;
+
+    memset(cap, 0, sizeof(capture_t));
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return fail(cap, error, "unable to open the file");
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size < CAPTURE_HEADER_SIZE)) {
+        close(fd);
+        return fail(cap, error, "the file is too small");
+    }
+    cap->map_size = (size_t) st.st_size;
+    cap->map = mmap(NULL, cap->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (cap->map == MAP_FAILED) {
+        cap->map = NULL;
+        return fail(cap, error, "mmap failed");
+    }
+
+    in = (const uint8_t*) cap->map;
+    if (memcmp(in, CAPTURE_MAGIC, 4) != 0) {
+        return fail(cap, error, "not a capture file");
+    }
+    cap->tick_hz = get32(&in[4]);
+    cap->sample_hz = get32(&in[8]);
+    cap->count = get32(&in[12]);
+    data_size = get32(&in[16]);
+    cap->metadata_size = get16(&in[20]);
+    if (get16(&in[22]) != 0) {
+        return fail(cap, error, "unsupported flags");
+    }
+    if (((uint64_t) CAPTURE_HEADER_SIZE + cap->metadata_size + data_size) > cap->map_size) {
+        return fail(cap, error, "the file is truncated");
+    }
+    cap->metadata = (const char*) &in[CAPTURE_HEADER_SIZE];
+    cap->data = &in[CAPTURE_HEADER_SIZE + cap->metadata_size];
+    cap->data_end = cap->data + data_size;
+    capture_rewind(cap);
+    return 1;
+}
+
+int capture_next(capture_t* cap, uint32_t* time)
+{
+    const uint8_t* in = cap->next;
+    uint32_t delta = 0;
+    unsigned shift = 0;
+
+    if (cap->index >= cap->count) {
+        return 0;
+    }
+    do {
+        if ((in >= cap->data_end) || (shift >= (CAPTURE_MAX_VARINT * 7))) {
+            // damaged: stop here
+            cap->index = cap->count;
+            return 0;
+        }
+        delta |= (uint32_t) (*in & 0x7f) << shift;
+        shift += 7;
+    } while (*in++ & 0x80);
+
+    cap->next = in;
+    cap->index++;
+    cap->time += delta;
+    *time = cap->time;
+    return 1;
+}
+
+void capture_rewind(capture_t* cap)
+{
+    cap->next = cap->data;
+    cap->index = 0;
+    cap->time = 0;
+}
+
+void capture_close(capture_t* cap)
+{
+    if (cap->map) {
+        munmap(cap->map, cap->map_size);
+    }
+    memset(cap, 0, sizeof(capture_t));
+}
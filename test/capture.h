@@ -0,0 +1,66 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary capture of rising edges from the 433MHz receiver (.cap), written by
+// capture.py. All values are little endian:
+//
+//   0   "EDG1"
+//   4   tick rate (Hz): the unit of the timestamps, 1000000 for micros()
+//   8   sample rate (Hz) of the original recording, 0 if unknown
+//   12  number of edges
+//   16  size of the edge data (bytes)
+//   20  size of the metadata (bytes, 2 bytes)
+//   22  flags (2 bytes, 0)
+//   24  metadata: text, e.g. "source=test5.csv"
+//   ... edge data: the time of each edge, as the difference from the previous
+//       edge (or from 0 for the first edge), each a LEB128 varint
+//
+// The reader maps the file into memory and decodes the edges from there.
+
+#define CAPTURE_MAGIC           "EDG1"
+#define CAPTURE_HEADER_SIZE     24
+#define CAPTURE_MAX_VARINT      5       // bytes for a 32 bit value
+
+typedef struct capture_s {
+    // from the header
+    uint32_t        tick_hz;
+    uint32_t        sample_hz;
+    uint32_t        count;
+    const char*     metadata;           // not terminated
+    uint16_t        metadata_size;
+
+    // reader state
+    const uint8_t*  data;
+    const uint8_t*  data_end;
+    const uint8_t*  next;
+    uint32_t        index;
+    uint32_t        time;
+
+    void*           map;
+    size_t          map_size;
+} capture_t;
+
+// Returns 1 if the file is a valid capture, otherwise 0 (with an error
+// message in "error", if not NULL)
+int capture_open(capture_t* cap, const char* filename, const char** error);
+
+// Returns 1 and the time of the next edge, or 0 at the end of the capture
+// (or if the edge data is damaged)
+int capture_next(capture_t* cap, uint32_t* time);
+
+// Go back to the first edge
+void capture_rewind(capture_t* cap);
+
+void capture_close(capture_t* cap);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,92 @@
+
+# Binary capture of rising edges from the 433MHz receiver (.cap).
+# See capture.h for the format.
+
+from readcode import read_edges
+import csv
+import math
+import struct
+import sys
+import typing
+
+MAGIC = b"EDG1"
+HEADER = struct.Struct("<4sIIIIHH")
+TICK_HZ = 1000000
+
+def encode_varint(value: int) -> bytes:
+    assert 0 <= value < (1 << 32)
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7f) | 0x80)
+        value >>= 7
+    out.append(value)
+    return bytes(out)
+
+def write_capture(filename: str, times: typing.List[int],
+                  sample_hz: int = 0, metadata: str = "") -> None:
+    """Write the times of rising edges (microseconds, in order)"""
+    data = bytearray()
+    previous = 0
+    for time in times:
+        assert time >= previous
+        data += encode_varint(time - previous)
+        previous = time
+
+    meta = metadata.encode("ascii")
+    with open(filename, "wb") as fd:
+        fd.write(HEADER.pack(MAGIC, TICK_HZ, sample_hz, len(times),
+                             len(data), len(meta), 0))
+        fd.write(meta)
+        fd.write(data)
+
+def read_capture(filename: str) -> typing.Tuple[typing.List[int], int, str]:
+    """Returns the times of rising edges (microseconds), sample rate and metadata"""
+    with open(filename, "rb") as fd:
+        raw = fd.read()
+
+    (magic, tick_hz, sample_hz, count, data_size, meta_size, flags) = HEADER.unpack_from(raw)
+    if (magic != MAGIC) or (tick_hz != TICK_HZ) or (flags != 0):
+        raise ValueError("{} is not a supported capture file".format(filename))
+    metadata = raw[HEADER.size:HEADER.size + meta_size].decode("ascii")
+    data = raw[HEADER.size + meta_size:HEADER.size + meta_size + data_size]
+
+    times = []
+    time = delta = shift = 0
+    for byte in data:
+        delta |= (byte & 0x7f) << shift
+        shift += 7
+        if not (byte & 0x80):
+            time += delta
+            times.append(time)
+            delta = shift = 0
+    if len(times) != count:
+        raise ValueError("{} is truncated".format(filename))
+    return (times, sample_hz, metadata)
+
+def rising_edge_times(edges: typing.List[typing.Tuple[float, bool]],
+                      offset: float = 0.0) -> typing.List[int]:
+    """Times of rising edges (microseconds) from the start of the recording, plus offset"""
+    (start, _) = edges[0]
+    return [max(0, int(math.floor((offset + time - start) * 1e6)))
+            for (time, high) in edges if high]
+
+def csv_sample_hz(filename: str, scale_time: float) -> int:
+    """Sample rate of an oscilloscope recording, from the first two samples"""
+    with open(filename, "rt", newline="") as fd:
+        rows = [row for row in csv.reader(fd) if len(row) >= 2][2:4]
+    return int(round(1.0 / ((float(rows[1][0]) - float(rows[0][0])) * scale_time)))
+
+def main() -> None:
+    if len(sys.argv) not in (3, 4):
+        print("usage: capture.py <recording.csv> <output.cap> [time scale, default 1e-3]")
+        sys.exit(1)
+
+    (csv_filename, cap_filename) = sys.argv[1:3]
+    scale_time = float(sys.argv[3]) if len(sys.argv) == 4 else 1e-3
+    times = rising_edge_times(read_edges(csv_filename, scale_time))
+    write_capture(cap_filename, times, csv_sample_hz(csv_filename, scale_time),
+                  "source={}".format(csv_filename))
+    print("{}: {} edges".format(cap_filename, len(times)))
+
+if __name__ == "__main__":
+    main()
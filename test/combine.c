@@ -0,0 +1,199 @@
+
+#include <stdint.h>
+#include <string.h>
+
+#include "combine.h"
+
+#define WEIGHT_ONE          256
+#define INCOMPLETE_SHIFT    3       // a symbol which was not received has 1/8 of the vote
+#define SYMBOL_VALUES       (1 << SYMBOL_SIZE)
+
+static uint32_t symbol_time(uint8_t version)
+{
+    return (version == 2) ? NC2_SYMBOL_TIME : NC_SYMBOL_TIME;
+}
+
+int combine_init(combine_t* c, unsigned receivers, uint32_t hold_us)
+{
+    unsigned r;
+
+    memset(c, 0, sizeof(combine_t));
+    if ((receivers == 0) || (receivers > COMBINE_MAX_RECEIVERS)) {
+        return 0;
+    }
+    c->receivers = receivers;
+    c->hold_us = hold_us;
+    for (r = 0; r < receivers; r++) {
+        rx433_init(&c->decoder[r]);
+    }
+    return 1;
+}
+
+int combine_edge(combine_t* c, unsigned receiver, uint32_t time)
+{
+    rx433_decoder_t* rx = &c->decoder[receiver];
+    combine_frame_t frame;
+
+    rx433_decode(rx, time);
+    if (!rx->new_code_ready) {
+        return 1;
+    }
+    rx->new_code_ready = 0;
+    frame.time = rx->new_code_time;
+    frame.received = rx->new_code_received;
+    frame.version = rx->new_code_version;
+    ncrs_unpack(frame.symbols, RX433_NEW_CODE(rx));
+    return combine_frame(c, receiver, &frame);
+}
+
+int combine_frame(combine_t* c, unsigned receiver, const combine_frame_t* frame)
+{
+    uint32_t sym = symbol_time(frame->version);
+    int32_t align = (sym * COMBINE_MAX_SHIFT) + (sym / 2);
+    combine_group_t* group = NULL;
+    unsigned g;
+
+    // Join a group of frames of the same message from other receivers
+    for (g = 0; g < c->groups; g++) {
+        int32_t offset = (int32_t) (frame->time - c->group[g].time);
+
+        if ((c->group[g].version == frame->version)
+        && (!(c->group[g].present & (1 << receiver)))
+        && (offset > -align) && (offset < align)) {
+            group = &c->group[g];
+            if (offset < 0) {
+                group->time = frame->time;
+            }
+            break;
+        }
+    }
+    if (!group) {
+        if (c->groups >= COMBINE_MAX_GROUPS) {
+            return 0;
+        }
+        group = &c->group[c->groups++];
+        memset(group, 0, sizeof(combine_group_t));
+        group->time = frame->time;
+        group->version = frame->version;
+    }
+    group->frame[receiver] = *frame;
+    group->present |= 1 << receiver;
+    c->stats[receiver].frames++;
+    return 1;
+}
+
+// Position of the decoded message within the combined frame: ncrs_decode may
+// have found it at a shift
+static int best_offset(const uint8_t* symbols, const uint8_t* encoded)
+{
+    int offset, best = 0;
+    unsigned i, matches, most = 0;
+
+    for (offset = -COMBINE_MAX_SHIFT; offset <= COMBINE_MAX_SHIFT; offset++) {
+        matches = 0;
+        for (i = 0; i < NC_DATA_SIZE; i++) {
+            int j = (int) i - offset;
+            matches += (j >= 0) && (j < NC_DATA_SIZE) && (symbols[i] == encoded[j]);
+        }
+        if (matches > most) {
+            most = matches;
+            best = offset;
+        }
+    }
+    return best;
+}
+
+int combine_next(combine_t* c, uint32_t now, combine_result_t* result)
+{
+    combine_group_t* group = &c->group[0];
+    uint32_t weight[COMBINE_MAX_RECEIVERS];
+    uint32_t shift[COMBINE_MAX_RECEIVERS];
+    uint32_t sym;
+    unsigned i, r;
+
+    if (c->groups == 0) {
+        return 0;
+    }
+    if ((group->present != ((1U << c->receivers) - 1))
+    && ((int32_t) (now - group->time) <= (int32_t) c->hold_us)) {
+        // Wait for the other receivers
+        return 0;
+    }
+
+    memset(result, 0, sizeof(combine_result_t));
+    result->time = group->time;
+    result->version = group->version;
+    sym = symbol_time(result->version);
+
+    for (r = 0; r < c->receivers; r++) {
+        const combine_frame_t* frame = &group->frame[r];
+        const combine_stats_t* stats = &c->stats[r];
+
+        if (!(group->present & (1 << r))) {
+            c->stats[r].missed++;
+            continue;
+        }
+        result->frames++;
+        if (ncrs_decode(result->message, frame->symbols)) {
+            result->alone++;
+            c->stats[r].decoded++;
+        }
+        // Symbols which were lost at the start of the frame
+        shift[r] = (frame->time - group->time + (sym / 2)) / sym;
+        // Fraction of the receiver's symbols which were correct (1/2 at first)
+        weight[r] = (WEIGHT_ONE * (stats->symbols - stats->errors + 1)) / (stats->symbols + 2);
+    }
+
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        uint32_t tally[SYMBOL_VALUES];
+        uint32_t best = 0;
+        unsigned value;
+
+        memset(tally, 0, sizeof(tally));
+        for (r = 0; r < c->receivers; r++) {
+            const combine_frame_t* frame = &group->frame[r];
+            unsigned j = i - shift[r];
+
+            if ((!(group->present & (1 << r))) || (i < shift[r])) {
+                continue;
+            }
+            tally[frame->symbols[j] & (SYMBOL_VALUES - 1)] +=
+                ((frame->received >> j) & 1) ? weight[r] : (weight[r] >> INCOMPLETE_SHIFT);
+        }
+        for (value = 0; value < SYMBOL_VALUES; value++) {
+            if (tally[value] > best) {
+                best = tally[value];
+                result->symbols[i] = value;
+            }
+        }
+    }
+
+    result->decoded = ncrs_decode(result->message, result->symbols);
+    if (result->decoded) {
+        // Compare each receiver's symbols with the decoded message
+        uint8_t encoded[NC_DATA_SIZE];
+        int offset;
+
+        ncrs_encode(encoded, result->message);
+        offset = best_offset(result->symbols, encoded);
+        for (r = 0; r < c->receivers; r++) {
+            const combine_frame_t* frame = &group->frame[r];
+
+            if (!(group->present & (1 << r))) {
+                continue;
+            }
+            for (i = 0; i < NC_DATA_SIZE; i++) {
+                int j = (int) (i + shift[r]) - offset;
+
+                if (((frame->received >> i) & 1) && (j >= 0) && (j < NC_DATA_SIZE)) {
+                    c->stats[r].symbols++;
+                    c->stats[r].errors += frame->symbols[i] != encoded[j];
+                }
+            }
+        }
+    }
+
+    c->groups--;
+    memmove(&c->group[0], &c->group[1], c->groups * sizeof(combine_group_t));
+    return 1;
+}
@@ -0,0 +1,89 @@
+#ifndef COMBINE_H
+#define COMBINE_H
+
+#include <stdint.h>
+
+#include "rx433.h"
+#include "ncrs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Diversity combining of new codes received by several receivers (on the host).
+//
+// Each receiver has its own decoder. The frames that they produce are grouped
+// by the time of their first symbol, which also gives the position of each frame
+// within the group if its first symbols were lost. Then each symbol is chosen
+// by a weighted vote: a receiver's vote is weighted by the fraction of its
+// symbols which were correct in earlier frames, and reduced if the decoder did
+// not receive the whole symbol. The combined frame is decoded by ncrs_decode.
+
+#define COMBINE_MAX_RECEIVERS   8
+#define COMBINE_MAX_GROUPS      8
+#define COMBINE_MAX_SHIFT       5       // symbols lost at the start of a frame
+
+typedef struct combine_frame_s {
+    uint32_t        time;                   // start of the first symbol received
+    uint32_t        received;               // bit i is set if symbol i was received
+    uint8_t         version;                // line coding: 1 or 2
+    uint8_t         symbols[NC_DATA_SIZE];
+} combine_frame_t;
+
+typedef struct combine_stats_s {
+    uint32_t        frames;                 // frames received
+    uint32_t        missed;                 // combined frames without a frame from this receiver
+    uint32_t        decoded;                // frames which ncrs_decode accepted alone
+    uint32_t        symbols;                // symbols received, in combined frames which were decoded
+    uint32_t        errors;                 // ... and which differed from the decoded message
+} combine_stats_t;
+
+typedef struct combine_result_s {
+    uint32_t        time;                   // start of the combined frame
+    uint8_t         version;
+    uint8_t         frames;                 // receivers which contributed a frame
+    uint8_t         alone;                  // receivers whose frame could be decoded alone
+    int             decoded;                // ncrs_decode result for the combined frame
+    uint8_t         symbols[NC_DATA_SIZE];  // combined frame
+    uint8_t         message[DECODED_DATA_BYTES];
+} combine_result_t;
+
+typedef struct combine_group_s {
+    uint32_t        time;                   // the earliest frame
+    uint32_t        present;                // bit r is set if receiver r has a frame
+    uint8_t         version;
+    combine_frame_t frame[COMBINE_MAX_RECEIVERS];
+} combine_group_t;
+
+typedef struct combine_s {
+    unsigned        receivers;
+    uint32_t        hold_us;
+    unsigned        groups;                 // in order of their first frame
+    combine_group_t group[COMBINE_MAX_GROUPS];
+    rx433_decoder_t decoder[COMBINE_MAX_RECEIVERS];
+    combine_stats_t stats[COMBINE_MAX_RECEIVERS];
+} combine_t;
+
+// A group of frames is combined when every receiver has contributed a frame, or
+// "hold_us" after its first frame began. This should be longer than a frame,
+// as a decoder may only finish an incomplete frame when the next edge arrives.
+// Returns 0 if there are too many receivers. ncrs_init must have been called.
+int combine_init(combine_t* c, unsigned receivers, uint32_t hold_us);
+
+// Decode an edge from a receiver. Edges from each receiver must be in order, and
+// edges from different receivers should be passed in order of time.
+// Returns 0 if a frame was received, but all groups are in use: call combine_next.
+int combine_edge(combine_t* c, unsigned receiver, uint32_t time);
+
+// Add a frame from a receiver (as done by combine_edge). Returns 0 if all groups
+// are in use.
+int combine_frame(combine_t* c, unsigned receiver, const combine_frame_t* frame);
+
+// Returns 1 and the combined frame of the first group, if it is complete at
+// time "now"; otherwise 0
+int combine_next(combine_t* c, uint32_t now, combine_result_t* result);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,454 @@
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "ticks.h"
+#include "rx433.h"
+#include "ncrs.h"
+#include "hmac433.h"
+#include "mail.h"
+#include "libnc.h"
+#include "secret.h"
+
+// End-to-end simulation of the radio link. Packets are encoded by libnc_encode
+// (as txnc433 does), turned into the pulse table of tx433_driver.py's write_nc
+// using version 1 or version 2 line coding, passed through a noisy channel, and received by rx433_interrupt and
+// mail_receive_messages, which calls ncrs_decode_packed, hmac433_authenticate and
+// finally new_packet. Each packet is a message for the screen, so it is
+// delivered when display_message shows its number. Usage:
+//
+//   ./linksim.exe [-p packets] [-s SNR dB] [-j jitter us] [-k skew ppm]
+//                 [-l lost symbols] [-r seed] [-m minimum success %] [-c version]
+//
+// The channel model is crude. With SNR, the receiver output is noise plus a
+// signal of amplitude 10^(SNR/20), compared with a threshold at half of the
+// amplitude. Each NOISE_INTERVAL, noise crosses the threshold with probability
+// Q(amplitude / 2), causing a spurious rising edge; each pulse of the signal
+// is missed with the same probability. Jitter is Gaussian, skew is the
+// difference between the transmitter and receiver clocks, and lost symbols
+// are missing from the start of the message (e.g. while the receiver's
+// automatic gain control settles). A version 2 message begins with a sync
+// word, so if anything is lost, the whole message is lost.
+
+#define MAX_PULSES      LIBNC_NC_MAX_PULSES
+#define GAP_TIME        20000   // microseconds of silence before and after each packet
+#define NOISE_INTERVAL  10.0    // microseconds: approximate receiver bandwidth
+#define MAX_EDGES       4096
+#define NVRAM_SIZE      64
+#define TEXT_LENGTH     (PACKET_PAYLOAD_SIZE - 1)
+#define MAX_PACKETS     100000  // numbers with TEXT_LENGTH digits
+
+typedef enum {
+    STAGE_ENCODE, STAGE_CHANNEL, STAGE_RX433, STAGE_NCRS, STAGE_HMAC, STAGE_DISPATCH,
+    NUM_STAGES,
+} stage_t;
+
+static const char* stage_names[NUM_STAGES] = {
+    "libnc_encode", "channel", "rx433_interrupt", "ncrs_decode",
+    "hmac433_authenticate", "new_packet",
+};
+
+typedef struct pulse_s {
+    uint32_t    start;      // microseconds from the start of the message (transmitter clock)
+    uint32_t    high;       // microseconds
+} pulse_t;
+
+// Channel
+static double snr_db = INFINITY;
+static double jitter = 0.0;
+static double skew_ppm = 0.0;
+static unsigned lost_symbols = 0;
+static unsigned version = 1;
+static uint64_t random_state = 1;
+
+// Receiver
+static uint64_t sim_time = 0;
+static uint8_t nvram[NVRAM_SIZE];
+static unsigned num_packets = 1000;
+static uint64_t* message_start = NULL;  // sim_time at the start of each packet
+static uint64_t* latency = NULL;        // 1 + microseconds from message_start to delivery
+
+// Results
+static uint64_t stage_ticks[NUM_STAGES];
+static unsigned stage_calls[NUM_STAGES];
+static unsigned received_count = 0;
+static unsigned decoded_count = 0;
+static unsigned corrected_count = 0;
+static unsigned authenticated_count = 0;
+static unsigned delivered_count = 0;
+static unsigned home_easy_count = 0;
+
+
+uint32_t micros()
+{
+    return (uint32_t) sim_time;
+}
+
+uint32_t millis()
+{
+    return (uint32_t) (sim_time / 1000);
+}
+
+void disable_interrupts(void) {}
+void enable_interrupts(void) {}
+void clock_set(uint8_t hour, uint8_t minute, uint8_t second) {}
+
+uint8_t nvram_read(uint8_t addr)
+{
+    return (addr < NVRAM_SIZE) ? nvram[addr] : 0;
+}
+
+void nvram_write(uint8_t addr, uint8_t data)
+{
+    if (addr < NVRAM_SIZE) {
+        nvram[addr] = data;
+    }
+}
+
+void display_message(const char* msg)
+{
+    // Each packet shows its number. Usually it is delivered while it is being
+    // received, but a damaged packet may only be completed by later edges.
+    char* end = NULL;
+    unsigned long number = strtoul(msg, &end, 10);
+
+    if ((strlen(msg) == TEXT_LENGTH) && (*end == '\0')
+    && (number < num_packets) && (!latency[number])) {
+        latency[number] = (sim_time - message_start[number]) + 1;
+        delivered_count++;
+    }
+}
+
+void display_message_lp(const char* msg)
+{
+    if (strncmp(msg, "HE ", 3) == 0) {
+        home_easy_count++;
+    }
+}
+
+// mail.c is built to call these instead of ncrs_decode_packed and hmac433_authenticate
+int linksim_ncrs_decode_packed(uint8_t *original_message, const uint8_t *packed_message)
+{
+    uint64_t start = ticks();
+    int rc = ncrs_decode_packed(original_message, packed_message);
+
+    stage_ticks[STAGE_NCRS] += ticks() - start;
+    stage_calls[STAGE_NCRS]++;
+    if (rc > 0) {
+        decoded_count++;
+        corrected_count += (rc > 1);
+    }
+    return rc;
+}
+
+int linksim_hmac433_authenticate(
+        const uint8_t* secret_data,
+        size_t secret_size,
+        const hmac433_packet_t* packet,
+        uint64_t* counter)
+{
+    uint64_t start = ticks();
+    int rc = hmac433_authenticate(secret_data, secret_size, packet, counter);
+
+    stage_ticks[STAGE_HMAC] += ticks() - start;
+    stage_calls[STAGE_HMAC]++;
+    authenticated_count += rc;
+    return rc;
+}
+
+static void fail(const char* what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(1);
+}
+
+static double uniform(void)
+{
+    // xorshift64*
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return (double) ((random_state * 0x2545F4914F6CDD1DULL) >> 11) / (double) (1ULL << 53);
+}
+
+static double gaussian(void)
+{
+    return sqrt(-2.0 * log(1.0 - uniform())) * cos(2.0 * M_PI * uniform());
+}
+
+// Pulses sent by tx433_driver.py's write_nc
+static unsigned make_pulses(const uint8_t* message, pulse_t* pulses)
+{
+    libnc_pulse_t table[MAX_PULSES];
+    uint32_t starts[MAX_PULSES];
+    size_t i, j, count;
+
+    if (version == 1) {
+        count = libnc_nc_pulses(message, NULL, table, MAX_PULSES);
+    } else {
+        count = libnc_nc2_pulses(message, NULL, table, MAX_PULSES);
+    }
+    if (count == 0) {
+        fail("unable to make the pulse table");
+    }
+    libnc_edges(table, count, starts);
+    for (i = j = 0; i < count; i++) {
+        if (table[i].high_us) {
+            pulses[j].start = starts[j];
+            pulses[j].high = table[i].high_us;
+            j++;
+        }
+    }
+    return j;
+}
+
+static int compare_edges(const void* a, const void* b)
+{
+    uint64_t x = *((const uint64_t*) a);
+    uint64_t y = *((const uint64_t*) b);
+    return (x > y) - (x < y);
+}
+
+// Rising edges seen by the receiver, for a message starting at "start"
+static unsigned channel(const pulse_t* pulses, unsigned num_pulses,
+                        uint64_t start, uint64_t finish, uint64_t* edges)
+{
+    double threshold = pow(10.0, snr_db / 20.0) / 2.0;
+    double crossing = 0.5 * erfc(threshold / sqrt(2.0));
+    double scale = 1.0 + (skew_ppm * 1e-6);
+    uint32_t lost_time = lost_symbols * ((version == 1) ? NC_SYMBOL_TIME : NC2_SYMBOL_TIME);
+    unsigned i, j, count = 0;
+
+    for (i = 0; i < num_pulses; i++) {
+        double time = start + (pulses[i].start * scale) + (jitter * gaussian());
+
+        if ((pulses[i].start < lost_time)
+        || (uniform() < crossing)
+        || (time < (start - GAP_TIME))) {
+            continue;
+        }
+        edges[count++] = (uint64_t) time;
+    }
+
+    if (crossing > 0.0) {
+        // Spurious edges at random, except while the signal is already high
+        double mean_gap = NOISE_INTERVAL / crossing;
+        double time = (double) (start - GAP_TIME);
+
+        while (count < MAX_EDGES) {
+            int high = 0;
+
+            time += -log(1.0 - uniform()) * mean_gap;
+            if (time >= finish) {
+                break;
+            }
+            for (j = 0; j < num_pulses; j++) {
+                double pulse_start = start + (pulses[j].start * scale);
+                if ((time >= pulse_start) && (time < (pulse_start + (pulses[j].high * scale)))) {
+                    high = 1;
+                    break;
+                }
+            }
+            if (!high) {
+                edges[count++] = (uint64_t) time;
+            }
+        }
+    }
+    qsort(edges, count, sizeof(uint64_t), compare_edges);
+    return count;
+}
+
+static void receive(void)
+{
+    uint64_t start = ticks();
+    uint64_t inner = stage_ticks[STAGE_NCRS] + stage_ticks[STAGE_HMAC];
+
+    mail_receive_messages();
+    stage_ticks[STAGE_DISPATCH] += (ticks() - start)
+        - ((stage_ticks[STAGE_NCRS] + stage_ticks[STAGE_HMAC]) - inner);
+    stage_calls[STAGE_DISPATCH]++;
+}
+
+static void make_secret_file(char* dir_name)
+{
+    char file_name[BUFSIZ];
+    uint64_t counter = 1;
+    FILE* fd;
+
+    if (!mkdtemp(dir_name)) {
+        fail("mkdtemp");
+    }
+    snprintf(file_name, sizeof(file_name), "%s/.hmac433.dat", dir_name);
+    fd = fopen(file_name, "wb");
+    if ((!fd)
+    || (fwrite(&counter, 1, sizeof(counter), fd) != sizeof(counter))
+    || (fwrite(SECRET_DATA, 1, SECRET_SIZE, fd) != SECRET_SIZE)
+    || (fclose(fd) != 0)) {
+        fail("unable to write the secret file");
+    }
+    setenv("HOME", dir_name, 1);
+    unsetenv("APPDATA");
+}
+
+static void remove_secret_file(const char* dir_name)
+{
+    char file_name[BUFSIZ];
+
+    snprintf(file_name, sizeof(file_name), "%s/.hmac433.dat", dir_name);
+    unlink(file_name);
+    rmdir(dir_name);
+}
+
+static void print_stage(const char* name, unsigned count, unsigned previous)
+{
+    printf("%-22s %8u %7.2f%%\n", name, count,
+           previous ? (100.0 * count) / previous : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    static uint64_t edges[MAX_EDGES];
+    pulse_t pulses[MAX_PULSES];
+    char dir_name[] = "/tmp/linksimXXXXXX";
+    double min_success = 0.0;
+    uint32_t airtime = 0;
+    unsigned i, j, stage;
+    int arg;
+
+    for (arg = 1; arg < argc; arg++) {
+        int more = (arg + 1) < argc;
+        if ((strcmp(argv[arg], "-p") == 0) && more) {
+            num_packets = atoi(argv[++arg]);
+        } else if ((strcmp(argv[arg], "-s") == 0) && more) {
+            snr_db = atof(argv[++arg]);
+        } else if ((strcmp(argv[arg], "-j") == 0) && more) {
+            jitter = atof(argv[++arg]);
+        } else if ((strcmp(argv[arg], "-k") == 0) && more) {
+            skew_ppm = atof(argv[++arg]);
+        } else if ((strcmp(argv[arg], "-l") == 0) && more) {
+            lost_symbols = atoi(argv[++arg]);
+        } else if ((strcmp(argv[arg], "-r") == 0) && more) {
+            random_state = strtoull(argv[++arg], NULL, 0) | 1;
+        } else if ((strcmp(argv[arg], "-m") == 0) && more) {
+            min_success = atof(argv[++arg]);
+        } else if ((strcmp(argv[arg], "-c") == 0) && more) {
+            version = atoi(argv[++arg]);
+        } else {
+            fprintf(stderr, "usage: %s [-p packets] [-s SNR dB] [-j jitter us] [-k skew ppm]\n"
+                            "       [-l lost symbols] [-r seed] [-m minimum success %%] [-c version]\n", argv[0]);
+            return 1;
+        }
+    }
+    if ((num_packets == 0) || (num_packets > MAX_PACKETS)) {
+        fail("the number of packets must be 1 .. 100000");
+    }
+    if ((version != 1) && (version != 2)) {
+        fail("the version must be 1 or 2");
+    }
+    message_start = calloc(num_packets, sizeof(uint64_t));
+    latency = calloc(num_packets, sizeof(uint64_t));
+    if ((!message_start) || (!latency)) {
+        fail("out of memory");
+    }
+
+    make_secret_file(dir_name);
+    if (!libnc_init()) {
+        remove_secret_file(dir_name);
+        fail("libnc_init");
+    }
+    if (!mail_init()) {
+        fail("mail_init");
+    }
+
+    sim_time = GAP_TIME;
+    for (i = 0; i < num_packets; i++) {
+        uint8_t payload[PACKET_PAYLOAD_SIZE];
+        uint8_t message[NC_DATA_SIZE];
+        char text[16];
+        uint64_t start, message_finish;
+        unsigned num_pulses, num_edges;
+
+        // Transmitter
+        snprintf(text, sizeof(text), "%05u", i);
+        payload[0] = 'M';
+        memcpy(&payload[1], text, TEXT_LENGTH);
+        start = ticks();
+        if (!libnc_encode(payload, sizeof(payload), message, sizeof(message))) {
+            fail("libnc_encode");
+        }
+        stage_ticks[STAGE_ENCODE] += ticks() - start;
+        stage_calls[STAGE_ENCODE]++;
+
+        // Channel
+        start = ticks();
+        num_pulses = make_pulses(message, pulses);
+        message_start[i] = sim_time + GAP_TIME;
+        airtime = pulses[num_pulses - 1].start + pulses[num_pulses - 1].high;
+        message_finish = message_start[i] + pulses[num_pulses - 1].start + GAP_TIME;
+        num_edges = channel(pulses, num_pulses, message_start[i], message_finish, edges);
+        stage_ticks[STAGE_CHANNEL] += ticks() - start;
+        stage_calls[STAGE_CHANNEL]++;
+
+        // Receiver
+        for (j = 0; j < num_edges; j++) {
+            sim_time = edges[j];
+            start = ticks();
+            rx433_interrupt();
+            stage_ticks[STAGE_RX433] += ticks() - start;
+            stage_calls[STAGE_RX433]++;
+            if (rx433_new_code_ready) {
+                received_count++;
+                receive();
+            }
+        }
+        sim_time = message_finish;
+        receive();
+
+    }
+    remove_secret_file(dir_name);
+
+    printf("channel: SNR %.1f dB, jitter %.1f us, skew %.0f ppm, %u lost symbols\n",
+           snr_db, jitter, skew_ppm, lost_symbols);
+    printf("version %u line coding: %.1f ms per message\n",
+           version, airtime / 1000.0);
+    print_stage("packets sent", num_packets, num_packets);
+    print_stage("new codes received", received_count, num_packets);
+    print_stage("RS decoded", decoded_count, received_count);
+    print_stage("HMAC authenticated", authenticated_count, decoded_count);
+    print_stage("delivered", delivered_count, authenticated_count);
+    printf("RS corrections needed: %u, spurious Home Easy codes: %u\n",
+           corrected_count, home_easy_count);
+
+    // Latency: from the start of the message until delivery
+    for (i = j = 0; i < num_packets; i++) {
+        if (latency[i]) {
+            latency[j++] = latency[i] - 1;
+        }
+    }
+    if (j) {
+        qsort(latency, j, sizeof(uint64_t), compare_edges);
+        printf("latency (ms): median %.1f, p99 %.1f, max %.1f\n",
+               latency[j / 2] / 1000.0, latency[(j * 99) / 100] / 1000.0,
+               latency[j - 1] / 1000.0);
+    }
+    free(latency);
+    free(message_start);
+
+    printf("%-22s %8s %12s %s/call\n", "stage", "calls", "total", TICK_UNIT);
+    for (stage = 0; stage < NUM_STAGES; stage++) {
+        printf("%-22s %8u %12llu %10.1f\n", stage_names[stage], stage_calls[stage],
+               (unsigned long long) stage_ticks[stage],
+               stage_calls[stage] ? (double) stage_ticks[stage] / stage_calls[stage] : 0.0);
+    }
+
+    if (((100.0 * delivered_count) / num_packets) < min_success) {
+        fprintf(stderr, "success rate %.2f%% is below %.2f%%\n",
+                (100.0 * delivered_count) / num_packets, min_success);
+        return 1;
+    }
+    return 0;
+}
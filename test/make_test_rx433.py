@@ -1,6 +1,6 @@
 
 from readcode import read_edges_in_zip, read_edges
-import math
+from capture import rising_edge_times, write_capture
 import typing
 
 SYMBOL_SIZE = 5
@@ -68,15 +68,14 @@ def main():
         [(i * 0.001, True) for i in range(100)],
     ]
 
-    with open("test_rx433.txt", "wt") as fd:
-        time = offset = 0.0
-        for edges in recordings:
-            (start, _) = edges[0]
-            for (time, high) in edges:
-                if high:
-                    fd.write("{:08x}\n".format(max(0,
-                            int(math.floor((offset + time - start) * 1e6)))))
-            offset += time - start
+    times = []
+    offset = 0.0
+    for edges in recordings:
+        times.extend(rising_edge_times(edges, offset))
+        ((start, _), (finish, _)) = (edges[0], edges[-1])
+        offset += finish - start
+
+    write_capture("test_rx433.cap", times, 0, "test_rx433")
 
 if __name__ == "__main__":
     main()
@@ -14,10 +14,18 @@ static uint8_t states_covered[256];
 static uint8_t now_minute = 0;
 static uint8_t now_hour = 0;
 
+#define SCHEDULE_END (NVRAM_SCHEDULE_BASE + ((ALARM_SCHEDULE_SIZE - 1) * NVRAM_SCHEDULE_ENTRY_SIZE))
+
+static int is_alarm_address(uint8_t addr)
+{
+    return (addr == NVRAM_ALARM_HI) || (addr == NVRAM_ALARM_LO)
+        || (addr == NVRAM_ALARM_STATE)
+        || ((addr >= NVRAM_SCHEDULE_BASE) && (addr < SCHEDULE_END));
+}
+
 uint8_t nvram_read(uint8_t addr)
 {
-    if ((addr != NVRAM_ALARM_HI) && (addr != NVRAM_ALARM_LO)
-    && (addr != NVRAM_ALARM_STATE)) {
+    if (!is_alarm_address(addr)) {
         fprintf(stderr, "error: read from unexpected address 0x%x\n", addr);
         exit(1);
     }
@@ -26,8 +34,7 @@ uint8_t nvram_read(uint8_t addr)
 
 void nvram_write(uint8_t addr, uint8_t data)
 {
-    if ((addr != NVRAM_ALARM_HI) && (addr != NVRAM_ALARM_LO)
-    && (addr != NVRAM_ALARM_STATE)) {
+    if (!is_alarm_address(addr)) {
         fprintf(stderr, "error: write to unexpected address 0x%x\n", addr);
         exit(1);
     }
@@ -107,6 +114,51 @@ static void power_off_time_skip(uint8_t hour, uint8_t minute)
     now_minute = minute;
 }
 
+// Run for a whole week with the scheduled alarms, checking that alarm_update_due
+// is never false when alarm_update_weekday would do something.
+// Returns the number of minutes when the alarm was sounding on each weekday.
+static void run_week(const char* test, unsigned sounding[7])
+{
+    uint8_t weekday;
+
+    for (weekday = 0; weekday < 7; weekday++) {
+        sounding[weekday] = 0;
+        do {
+            int due = alarm_update_due(weekday, now_hour, now_minute);
+            uint8_t state = test_nvram[NVRAM_ALARM_STATE];
+            uint8_t schedule[SCHEDULE_END - NVRAM_SCHEDULE_BASE];
+            unsigned rc;
+
+            memcpy(schedule, &test_nvram[NVRAM_SCHEDULE_BASE], sizeof(schedule));
+            rc = alarm_update_weekday(weekday, now_hour, now_minute);
+            if ((!due) && (rc || (state != test_nvram[NVRAM_ALARM_STATE])
+                    || memcmp(schedule, &test_nvram[NVRAM_SCHEDULE_BASE], sizeof(schedule)))) {
+                fprintf(stderr, "error: %s: update was not due on day %u at %02u:%02u\n",
+                                test, weekday, now_hour, now_minute);
+                exit(1);
+            }
+            if (rc) {
+                sounding[weekday]++;
+            }
+            advance();
+        } while (now_hour || now_minute);
+    }
+}
+
+static void check_week(const char* test, const unsigned sounding[7], uint8_t weekdays)
+{
+    uint8_t weekday;
+
+    for (weekday = 0; weekday < 7; weekday++) {
+        unsigned expect = ((weekdays >> weekday) & 1) ? ALARM_SOUNDS_FOR : 0;
+        if (sounding[weekday] != expect) {
+            fprintf(stderr, "error: %s: alarm sounded for %u minutes on day %u, expected %u\n",
+                            test, sounding[weekday], weekday, expect);
+            exit(1);
+        }
+    }
+}
+
 
 int main(void)
 {
@@ -383,6 +435,72 @@ int main(void)
     }
 
 
+    // test: scheduled alarms are rejected if the parameters are invalid
+    if (alarm_schedule_set(0, 7, 0, ALARM_EVERY_DAY)
+    || alarm_schedule_set(ALARM_SCHEDULE_SIZE, 7, 0, ALARM_EVERY_DAY)
+    || alarm_schedule_set(1, 24, 0, ALARM_EVERY_DAY)
+    || alarm_schedule_set(1, 7, 60, ALARM_EVERY_DAY)) {
+        fprintf(stderr, "error: invalid scheduled alarm was accepted\n");
+        exit(1);
+    }
+
+    // test: scheduled alarm on weekdays (Monday .. Friday) at 07:00, sounds every week
+    {
+        unsigned sounding[7];
+        const uint8_t weekdays = 0x3e;
+
+        alarm_unset();
+        alarm_schedule_set(1, 7, 0, weekdays);
+        run_week("weekdays", sounding);
+        check_week("weekdays", sounding, weekdays);
+        run_week("weekdays", sounding);
+        check_week("weekdays", sounding, weekdays);
+
+        // test: scheduled alarm across midnight, only on Saturday
+        // It sounds for 5 minutes on Saturday and 5 minutes on Sunday.
+        alarm_schedule_set(2, 23, 55, 0x40);
+        power_off_time_skip(0, 0);
+        run_week("saturday", sounding);
+        run_week("saturday", sounding);
+        if ((sounding[0] != (ALARM_SOUNDS_FOR / 2))
+        || (sounding[6] != (ALARM_SOUNDS_FOR / 2))) {
+            fprintf(stderr, "error: saturday: alarm sounded for %u + %u minutes\n",
+                            sounding[6], sounding[0]);
+            exit(1);
+        }
+        sounding[0] = sounding[6] = 0;
+        check_week("saturday", sounding, weekdays);
+
+        // test: left button silences the scheduled alarm only until next time
+        now_hour = 7;
+        alarm_update_weekday(1, now_hour, now_minute);
+        if (alarm_update_weekday(1, now_hour, now_minute) != 1) {
+            fprintf(stderr, "error: scheduled alarm did not sound on Monday at 07:00\n");
+            exit(1);
+        }
+        if ((alarm_unset() != 1)
+        || alarm_update_due(1, now_hour, now_minute) != 1
+        || alarm_update_weekday(1, now_hour, now_minute) != 0) {
+            fprintf(stderr, "error: scheduled alarm was not silenced\n");
+            exit(1);
+        }
+        now_hour = 0;
+        for (i = 0; i < 6; i++) {
+            alarm_update_weekday(2 + i, now_hour, now_minute);
+        }
+        if (alarm_update_weekday(1, 7, 1) != 2) {
+            fprintf(stderr, "error: scheduled alarm did not sound again\n");
+            exit(1);
+        }
+
+        // test: scheduled alarms are removed with an empty weekday mask
+        alarm_schedule_set(1, 0, 0, 0);
+        alarm_schedule_set(2, 0, 0, 0);
+        power_off_time_skip(0, 0);
+        run_week("removed", sounding);
+        check_week("removed", sounding, 0);
+    }
+
     for (i = 0; i < FINAL_VALID_STATE; i++) {
         if (!states_covered[i]) {
             fprintf(stderr, "error: no coverage of state %d\n", i);
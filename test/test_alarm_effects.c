@@ -0,0 +1,224 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alarm_effects.h"
+
+#define ONE_MINUTE  60000
+#define NUM_MINUTES 30
+
+// Reference: the original implementation of the alarm effects, with the
+// brightness and colour of the NeoPixels combined as Adafruit_NeoPixel would
+typedef struct reference_s {
+    uint32_t    last_running_time;
+    uint32_t    strobe_trigger;
+    uint32_t    sound_trigger;
+    uint32_t    brightness;
+    uint8_t     colour[3];
+    uint8_t     rgb[3];
+    uint8_t     sound;
+    uint8_t     tone;
+} reference_t;
+
+static int try_subtract(reference_t* ref, uint32_t how_often)
+{
+    if (ref->strobe_trigger >= how_often) {
+        ref->strobe_trigger -= how_often;
+        return 1;
+    }
+    return 0;
+}
+
+static void set_colour(reference_t* ref, uint8_t red, uint8_t green, uint8_t blue)
+{
+    ref->colour[0] = red;
+    ref->colour[1] = green;
+    ref->colour[2] = blue;
+}
+
+static void reference_update(reference_t* ref, uint32_t running_time)
+{
+    uint32_t millisecond_delta = running_time - ref->last_running_time;
+    const uint32_t TOTAL_PHASE_TIME = 30000;
+    const uint32_t TOTAL_PULSE_TIME = 2000;
+    uint32_t phase = running_time / TOTAL_PHASE_TIME;
+    uint32_t phase_time = running_time % TOTAL_PHASE_TIME;
+    uint32_t pulse_time = phase_time % TOTAL_PULSE_TIME;
+    uint32_t brightness = ref->brightness;
+    uint32_t how_often = 0;
+    unsigned i;
+
+    ref->last_running_time = running_time;
+    ref->strobe_trigger += millisecond_delta;
+    ref->sound_trigger += millisecond_delta;
+
+    switch ((phase <= 4) ? phase : (((phase - 1) % 4) + 1)) {
+        case 0:
+            if (try_subtract(ref, 250)) {
+                brightness = ((phase_time * 255) / TOTAL_PHASE_TIME);
+            }
+            break;
+        case 1:
+            if (try_subtract(ref, 250)) {
+                if (pulse_time < (TOTAL_PULSE_TIME / 2)) {
+                    brightness = (255 - ((pulse_time * 255) / (TOTAL_PULSE_TIME / 2)));
+                } else {
+                    brightness = (((pulse_time - (TOTAL_PULSE_TIME / 2)) * 255) / (TOTAL_PULSE_TIME / 2));
+                }
+            }
+            break;
+        case 2:
+            brightness = try_subtract(ref, 2000) ? 255 : 0;
+            break;
+        case 3:
+            brightness = try_subtract(ref, 500) ? 255 : 0;
+            break;
+        default:
+            brightness = try_subtract(ref, 250) ? 255 : 0;
+            break;
+    }
+    if (brightness != ref->brightness) {
+        ref->brightness = brightness;
+        if (phase <= 4) {
+            set_colour(ref, 255, 255, 0);
+        } else if ((phase <= 8) || (pulse_time < (TOTAL_PULSE_TIME / 2))) {
+            set_colour(ref, 255, 255, 255);
+        } else {
+            set_colour(ref, 255, 0, 0);
+        }
+    }
+    for (i = 0; i < 3; i++) {
+        ref->rgb[i] = ((uint32_t) ref->colour[i] * (ref->brightness + 1)) >> 8;
+    }
+
+    switch (phase) {
+        case 0: case 1: case 2:
+            how_often = 0;
+            ref->sound_trigger = 0;
+            break;
+        case 3: how_often = 10000; break;
+        case 4: how_often = 5000; break;
+        case 5: how_often = 3000; break;
+        case 6: how_often = 2000; break;
+        case 7: how_often = 1000; break;
+        case 8: how_often = 500; break;
+        case 9: how_often = 200; break;
+        default: how_often = 100; break;
+    }
+    ref->sound = (phase >= 3);
+    ref->tone = 0;
+    if ((ref->sound_trigger >= how_often) && (how_often > 0)) {
+        ref->sound_trigger -= how_often;
+        ref->tone = 1;
+    }
+}
+
+// Run the alarm for NUM_MINUTES, comparing against the reference. The time between
+// updates is step + (random in 0 .. jitter - 1). The brightness of fades and pulses
+// is updated at fixed steps by alarm_effects, so it may differ by the tolerance.
+static void run(const char* test, uint32_t step, uint32_t jitter, int tolerance)
+{
+    reference_t ref;
+    alarm_effects_t effects;
+    uint32_t running_time = 0;
+    uint8_t rgb[3] = {0, 0, 0};
+    unsigned tones = 0;
+    unsigned updates = 0;
+    unsigned changes = 0;
+    unsigned i;
+
+    memset(&ref, 0, sizeof(ref));
+    alarm_effects_reset();
+    while (running_time < (NUM_MINUTES * ONE_MINUTE)) {
+        int changed;
+
+        reference_update(&ref, running_time);
+        changed = alarm_effects_update(running_time, &effects);
+        updates++;
+
+        if ((effects.sound != ref.sound) || (effects.tone != ref.tone)) {
+            fprintf(stderr, "error: %s: sound %d %d tone %d %d at time %u\n", test,
+                    effects.sound, ref.sound, effects.tone, ref.tone, running_time);
+            exit(1);
+        }
+        for (i = 0; i < 3; i++) {
+            int difference = (int) effects.red - (int) ref.rgb[0];
+            if (i == 1) {
+                difference = (int) effects.green - (int) ref.rgb[1];
+            } else if (i == 2) {
+                difference = (int) effects.blue - (int) ref.rgb[2];
+            }
+            if (abs(difference) > tolerance) {
+                fprintf(stderr, "error: %s: colour %d %d %d expected %d %d %d at time %u\n", test,
+                        effects.red, effects.green, effects.blue,
+                        ref.rgb[0], ref.rgb[1], ref.rgb[2], running_time);
+                exit(1);
+            }
+        }
+        if (changed != ((effects.red != rgb[0]) || (effects.green != rgb[1]) || (effects.blue != rgb[2]))) {
+            fprintf(stderr, "error: %s: changed = %d at time %u\n", test, changed, running_time);
+            exit(1);
+        }
+        rgb[0] = effects.red;
+        rgb[1] = effects.green;
+        rgb[2] = effects.blue;
+        tones += effects.tone;
+        changes += changed;
+        running_time += step + ((jitter > 0) ? (rand() % jitter) : 0);
+    }
+    if ((tones == 0) || (changes == 0) || (changes >= updates)) {
+        fprintf(stderr, "error: %s: %u tones, %u changes, %u updates\n", test, tones, changes, updates);
+        exit(1);
+    }
+}
+
+int main(void)
+{
+    alarm_effects_t effects;
+    uint32_t running_time;
+    unsigned tones;
+
+    // test: updates every 10ms give exactly the same effects as the reference
+    run("10ms", 10, 0, 0);
+    run("1ms", 1, 0, 0);
+    run("50ms", 50, 0, 0);
+
+    // test: irregular updates; brightness may differ by up to 255 * 20 / 1000
+    srand(1);
+    run("jitter", 5, 16, 5);
+
+    // test: the time jumps backwards (a new alarm) or forwards (the clock is set)
+    alarm_effects_reset();
+    alarm_effects_update(0, &effects);
+    alarm_effects_update(ONE_MINUTE * 10, &effects);
+    if (!effects.sound) {
+        fprintf(stderr, "error: jump forwards: no sound\n");
+        exit(1);
+    }
+    tones = 0;
+    for (running_time = (ONE_MINUTE * 10) + 10; running_time <= (ONE_MINUTE * 10) + 1000; running_time += 10) {
+        alarm_effects_update(running_time, &effects);
+        tones += effects.tone;
+    }
+    if (tones != 10) {
+        fprintf(stderr, "error: jump forwards: %u tones\n", tones);
+        exit(1);
+    }
+    alarm_effects_update(1000, &effects);
+    if (effects.sound) {
+        fprintf(stderr, "error: jump backwards: sound\n");
+        exit(1);
+    }
+
+    // test: after a reset, the lights start from darkness
+    alarm_effects_reset();
+    if (alarm_effects_update(ONE_MINUTE * 3, &effects)
+    || effects.red || effects.green || effects.blue || effects.tone) {
+        fprintf(stderr, "error: reset: not dark\n");
+        exit(1);
+    }
+
+    printf("ok\n");
+    return 0;
+}
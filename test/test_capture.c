@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+#define FILENAME    "test_capture.cap"
+#define NUM_EDGES   1000
+
+static uint8_t file_data[CAPTURE_HEADER_SIZE + 64 + (NUM_EDGES * CAPTURE_MAX_VARINT)];
+static uint32_t times[NUM_EDGES];
+
+static void check(const char* test, uint32_t got, uint32_t expected)
+{
+    if (got != expected) {
+        fprintf(stderr, "error: %s: got %u expected %u\n", test, got, expected);
+        exit(1);
+    }
+}
+
+static void put32(uint8_t* out, uint32_t value)
+{
+    out[0] = value;
+    out[1] = value >> 8;
+    out[2] = value >> 16;
+    out[3] = value >> 24;
+}
+
+// Build a capture of the first "count" edges in memory, returning its size
+static size_t build(uint32_t count, const char* metadata)
+{
+    size_t metadata_size = strlen(metadata);
+    uint8_t* out = &file_data[CAPTURE_HEADER_SIZE + metadata_size];
+    uint32_t previous = 0;
+    uint32_t i;
+
+    memset(file_data, 0, CAPTURE_HEADER_SIZE);
+    memcpy(file_data, CAPTURE_MAGIC, 4);
+    put32(&file_data[4], 1000000);
+    put32(&file_data[8], 48828);
+    put32(&file_data[12], count);
+    file_data[20] = metadata_size;
+    memcpy(&file_data[CAPTURE_HEADER_SIZE], metadata, metadata_size);
+
+    for (i = 0; i < count; i++) {
+        uint32_t delta = times[i] - previous;
+        previous = times[i];
+        while (delta >= 0x80) {
+            *out++ = (delta & 0x7f) | 0x80;
+            delta >>= 7;
+        }
+        *out++ = delta;
+    }
+    put32(&file_data[16], out - &file_data[CAPTURE_HEADER_SIZE + metadata_size]);
+    return out - file_data;
+}
+
+static void save(size_t size)
+{
+    FILE* fd = fopen(FILENAME, "wb");
+    if ((!fd) || (fwrite(file_data, 1, size, fd) != size) || (fclose(fd) != 0)) {
+        perror("unable to write " FILENAME);
+        exit(1);
+    }
+}
+
+static void test_round_trip(void)
+{
+    capture_t cap;
+    uint32_t i, time = 0;
+
+    save(build(NUM_EDGES, "source=test"));
+    check("open", capture_open(&cap, FILENAME, NULL), 1);
+    check("tick_hz", cap.tick_hz, 1000000);
+    check("sample_hz", cap.sample_hz, 48828);
+    check("count", cap.count, NUM_EDGES);
+    check("metadata_size", cap.metadata_size, 11);
+    check("metadata", memcmp(cap.metadata, "source=test", 11), 0);
+
+    for (i = 0; i < NUM_EDGES; i++) {
+        check("next", capture_next(&cap, &time), 1);
+        check("time", time, times[i]);
+    }
+    check("end", capture_next(&cap, &time), 0);
+    check("end again", capture_next(&cap, &time), 0);
+
+    capture_rewind(&cap);
+    check("rewind", capture_next(&cap, &time), 1);
+    check("rewind time", time, times[0]);
+    capture_close(&cap);
+}
+
+static void test_empty(void)
+{
+    capture_t cap;
+    uint32_t time = 0;
+
+    save(build(0, ""));
+    check("open empty", capture_open(&cap, FILENAME, NULL), 1);
+    check("next empty", capture_next(&cap, &time), 0);
+    capture_close(&cap);
+}
+
+static void test_errors(void)
+{
+    capture_t cap;
+    const char* error = NULL;
+    uint32_t count, time = 0;
+    size_t size;
+
+    check("missing", capture_open(&cap, "missing.cap", &error), 0);
+    check("missing error", error != NULL, 1);
+
+    // header only partly present
+    save(build(NUM_EDGES, ""));
+    save(CAPTURE_HEADER_SIZE - 1);
+    check("short", capture_open(&cap, FILENAME, NULL), 0);
+
+    // bad magic number
+    size = build(NUM_EDGES, "");
+    file_data[0] = 'X';
+    save(size);
+    check("magic", capture_open(&cap, FILENAME, NULL), 0);
+
+    // unknown flags
+    size = build(NUM_EDGES, "");
+    file_data[22] = 1;
+    save(size);
+    check("flags", capture_open(&cap, FILENAME, NULL), 0);
+
+    // edge data is cut short
+    size = build(NUM_EDGES, "");
+    save(size - 1);
+    check("truncated", capture_open(&cap, FILENAME, &error), 0);
+    check("truncated error", strcmp(error, "the file is truncated"), 0);
+
+    // edge count is larger than the edge data: decoding stops at the end
+    size = build(10, "");
+    put32(&file_data[12], 11);
+    save(size);
+    check("open overcount", capture_open(&cap, FILENAME, NULL), 1);
+    for (count = 0; capture_next(&cap, &time); count++) {}
+    check("overcount", count, 10);
+    capture_close(&cap);
+
+    // varint longer than 32 bits
+    build(1, "");
+    memset(&file_data[CAPTURE_HEADER_SIZE], 0xff, CAPTURE_MAX_VARINT + 1);
+    file_data[CAPTURE_HEADER_SIZE + CAPTURE_MAX_VARINT + 1] = 0;
+    put32(&file_data[16], CAPTURE_MAX_VARINT + 2);
+    save(CAPTURE_HEADER_SIZE + CAPTURE_MAX_VARINT + 2);
+    check("open long varint", capture_open(&cap, FILENAME, NULL), 1);
+    check("long varint", capture_next(&cap, &time), 0);
+    capture_close(&cap);
+}
+
+int main(void)
+{
+    uint32_t i, time = 0;
+
+    // Deltas of every varint size, including the largest
+    srand(1);
+    for (i = 0; i < NUM_EDGES; i++) {
+        switch (i % 5) {
+            case 0: time += rand() % 0x80; break;
+            case 1: time += rand() % 0x4000; break;
+            case 2: time += rand() % 0x200000; break;
+            default: time += rand() % 0x1000; break;
+        }
+        times[i] = time;
+    }
+    times[NUM_EDGES - 1] = 0xffffffffU;   // five byte varint
+
+    test_round_trip();
+    test_empty();
+    test_errors();
+    remove(FILENAME);
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "combine.h"
+#include "capture.h"
+
+// Diversity combining of new codes from several receivers. Usage:
+//
+//   ./test_combine.exe                     test with the recordings below
+//   ./test_combine.exe a.cap b.cap ...     combine captures from several receivers,
+//                                          printing the frames and statistics
+//
+// The test makes three receivers from each recording. Each receiver has a
+// burst of interference (extra edges) over a different part of the frame, and
+// some receivers lose the first symbol or the last symbols. No receiver has a
+// frame which could be decoded alone, but the combined frame is correct.
+
+#define EPSILON         ((NC_PULSE * 3) / 8)  // as in rx433.c
+#define START_TIME      (NC_PULSE * 3)      // from the first edge of a symbol to its timebase
+#define RECEIVERS       3
+#define MAX_EDGES       65536
+#define MAX_RESULTS     64
+#define GAP_TIME        100000              // microseconds between recordings
+#define HOLD_TIME       250000
+#define JITTER          10      // microseconds added to the edges of receivers 1 ..
+
+typedef struct edges_s {
+    uint32_t    time[MAX_EDGES];
+    unsigned    count;
+} edges_t;
+
+typedef struct damage_s {
+    int32_t     offset_us;              // receiver's timestamps, relative to receiver 0
+    unsigned    first_symbol;           // symbols received
+    unsigned    last_symbol;
+    unsigned    first_damaged;          // symbols with interference
+    unsigned    last_damaged;
+} damage_t;
+
+static const damage_t DAMAGE[RECEIVERS] = {
+    {0, 0, NC_DATA_SIZE, 2, 10},
+    {250, 1, 28, 12, 20},
+    {-180, 0, 27, 20, 26},
+};
+
+static const char* RECORDINGS[] = {
+    "test5.cap", "test6a.cap", "test7.cap", "test9.cap",
+};
+#define NUM_RECORDINGS (sizeof(RECORDINGS) / sizeof(RECORDINGS[0]))
+
+static edges_t recording;
+static edges_t edges[COMBINE_MAX_RECEIVERS];
+static combine_t combine;
+static combine_result_t results[MAX_RESULTS];
+static uint32_t random_state = 1;
+
+
+uint32_t micros()
+{
+    // rx433_interrupt is not used
+    return 0;
+}
+
+void display_message(const char* m)
+{
+    fprintf(stderr, "message: %s\n", m);
+    exit(1);
+}
+
+static void fail(const char* what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(1);
+}
+
+static void check(const char* test, unsigned long got, unsigned long expected)
+{
+    if (got != expected) {
+        fprintf(stderr, "error: %s: got %lu expected %lu\n", test, got, expected);
+        exit(1);
+    }
+}
+
+static uint32_t jitter(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state % ((JITTER * 2) + 1);
+}
+
+static void add_edge(edges_t* e, uint32_t time)
+{
+    if (e->count >= MAX_EDGES) {
+        fail("too many edges");
+    }
+    e->time[e->count++] = time;
+}
+
+static void load(edges_t* e, const char* filename, uint32_t offset)
+{
+    capture_t cap;
+    const char* error = "";
+    uint32_t time;
+
+    if (!capture_open(&cap, filename, &error)) {
+        fprintf(stderr, "unable to read %s: %s\n", filename, error);
+        exit(1);
+    }
+    while (capture_next(&cap, &time)) {
+        add_edge(e, time + offset);
+    }
+    capture_close(&cap);
+}
+
+static int compare_time(const void* a, const void* b)
+{
+    uint32_t x = *((const uint32_t*) a);
+    uint32_t y = *((const uint32_t*) b);
+    return (x > y) - (x < y);
+}
+
+static uint32_t last_time(unsigned receivers)
+{
+    uint32_t last = 0;
+    unsigned r;
+
+    for (r = 0; r < receivers; r++) {
+        if (edges[r].count && (edges[r].time[edges[r].count - 1] > last)) {
+            last = edges[r].time[edges[r].count - 1];
+        }
+    }
+    return last;
+}
+
+// Pass the edges of every receiver to the combiner in order of time, returning
+// the number of combined frames
+static unsigned run(unsigned receivers)
+{
+    unsigned next[COMBINE_MAX_RECEIVERS];
+    unsigned count = 0;
+    uint32_t end = last_time(receivers) + GAP_TIME;
+    unsigned r;
+
+    memset(next, 0, sizeof(next));
+    if (!combine_init(&combine, receivers, HOLD_TIME)) {
+        fail("combine_init");
+    }
+    while (1) {
+        unsigned first = receivers;
+        uint32_t time = end;
+
+        for (r = 0; r < receivers; r++) {
+            if ((next[r] < edges[r].count) && (edges[r].time[next[r]] < time)) {
+                time = edges[r].time[next[r]];
+                first = r;
+            }
+        }
+        if (first >= receivers) {
+            break;
+        }
+        next[first]++;
+        if (!combine_edge(&combine, first, time)) {
+            fail("combine_edge: all groups are in use");
+        }
+        while ((count < MAX_RESULTS) && combine_next(&combine, time, &results[count])) {
+            count++;
+        }
+    }
+    // the decoders finish incomplete frames at the next edge
+    for (r = 0; r < receivers; r++) {
+        combine_edge(&combine, r, end);
+    }
+    while ((count < MAX_RESULTS) && combine_next(&combine, end + HOLD_TIME + 1, &results[count])) {
+        count++;
+    }
+    return count;
+}
+
+static void print_results(unsigned count, unsigned receivers)
+{
+    unsigned i, r;
+
+    for (i = 0; i < count; i++) {
+        printf("%u: version %u, %u frames, %u decoded alone, ncrs_decode %d:",
+               results[i].time, results[i].version, results[i].frames,
+               results[i].alone, results[i].decoded);
+        for (r = 0; r < NC_DATA_SIZE; r++) {
+            printf(" %u", results[i].symbols[r]);
+        }
+        printf("\n");
+    }
+    printf("receiver    frames    missed   decoded   symbols    errors\n");
+    for (r = 0; r < receivers; r++) {
+        const combine_stats_t* s = &combine.stats[r];
+        printf("%8u %9u %9u %9u %9u %9u\n", r, s->frames, s->missed, s->decoded,
+               s->symbols, s->errors);
+    }
+}
+
+// Decode a recording alone: the reference for the combined frame
+static void reference(combine_frame_t* frame)
+{
+    rx433_decoder_t rx;
+    unsigned i;
+
+    rx433_init(&rx);
+    for (i = 0; i < recording.count; i++) {
+        rx433_decode(&rx, recording.time[i]);
+    }
+    rx433_decode(&rx, recording.time[recording.count - 1] + GAP_TIME);
+    check("reference ready", rx.new_code_ready, 1);
+    check("reference received", rx.new_code_received, (1UL << NC_DATA_SIZE) - 1);
+    frame->time = rx.new_code_time;
+    frame->received = rx.new_code_received;
+    frame->version = rx.new_code_version;
+    ncrs_unpack(frame->symbols, RX433_NEW_CODE(&rx));
+}
+
+static uint32_t distance(uint32_t a, uint32_t b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+// The edge closest to "time"
+static uint32_t nearest(uint32_t time)
+{
+    uint32_t best = recording.time[0];
+    unsigned i;
+
+    for (i = 1; i < recording.count; i++) {
+        if (distance(recording.time[i], time) < distance(best, time)) {
+            best = recording.time[i];
+        }
+    }
+    return best;
+}
+
+// Add a damaged copy of the recording to a receiver's edges: interference sets
+// every bit of the damaged symbols
+static void add_damaged(edges_t* e, const damage_t* d, const uint32_t* timebase, uint32_t offset)
+{
+    uint32_t first = (d->first_symbol > 0)
+                    ? (timebase[d->first_symbol] - START_TIME - (NC_PULSE / 2)) : 0;
+    uint32_t last = (d->last_symbol < NC_DATA_SIZE)
+                    ? (timebase[d->last_symbol] - START_TIME - (NC_PULSE / 2)) : ~0;
+    unsigned i, j, start = e->count;
+
+    for (i = 0; i < recording.count; i++) {
+        if ((recording.time[i] >= first) && (recording.time[i] < last)) {
+            add_edge(e, recording.time[i]);
+        }
+    }
+    for (i = d->first_damaged; i < d->last_damaged; i++) {
+        for (j = 1; j <= SYMBOL_SIZE; j++) {
+            uint32_t time = timebase[i] + (NC_PULSE * 2 * j);
+
+            if (distance(nearest(time), time) > EPSILON) {
+                add_edge(e, time);
+            }
+        }
+    }
+    qsort(&e->time[start], e->count - start, sizeof(uint32_t), compare_time);
+    for (i = start; i < e->count; i++) {
+        e->time[i] += offset + d->offset_us + ((e == &edges[0]) ? 0 : jitter());
+    }
+}
+
+static void test_recordings(void)
+{
+    combine_frame_t expect[NUM_RECORDINGS];
+    unsigned errors[RECEIVERS];
+    uint32_t offset = GAP_TIME;
+    unsigned i, k, r, count;
+
+    memset(errors, 0, sizeof(errors));
+    for (i = 0; i < NUM_RECORDINGS; i++) {
+        uint32_t timebase[NC_DATA_SIZE];
+
+        recording.count = 0;
+        load(&recording, RECORDINGS[i], 0);
+        reference(&expect[i]);
+        expect[i].time += offset;
+
+        // Follow the transmitter's clock from one symbol to the next
+        timebase[0] = expect[i].time - offset;
+        for (k = 1; k < NC_DATA_SIZE; k++) {
+            timebase[k] = nearest(timebase[k - 1] + NC_SYMBOL_TIME);
+        }
+        for (r = 0; r < RECEIVERS; r++) {
+            add_damaged(&edges[r], &DAMAGE[r], timebase, offset);
+        }
+        if (ncrs_decode(results[0].message, expect[i].symbols)) {
+            // Damaged symbols which can be checked against the decoded message
+            for (r = 0; r < RECEIVERS; r++) {
+                for (k = DAMAGE[r].first_damaged; k < DAMAGE[r].last_damaged; k++) {
+                    errors[r] += expect[i].symbols[k] != ((1 << SYMBOL_SIZE) - 1);
+                }
+            }
+        }
+        offset = last_time(RECEIVERS) + GAP_TIME;
+    }
+
+    count = run(RECEIVERS);
+    print_results(count, RECEIVERS);
+    check("frames", count, NUM_RECORDINGS);
+    for (i = 0; i < NUM_RECORDINGS; i++) {
+        // receiver 2 is the earliest
+        check("time", distance(results[i].time, expect[i].time + DAMAGE[2].offset_us) <= JITTER * 2, 1);
+        check("frames combined", results[i].frames, RECEIVERS);
+        check("decoded alone", results[i].alone, 0);
+        check("symbols", memcmp(results[i].symbols, expect[i].symbols, NC_DATA_SIZE), 0);
+        check("decoded", results[i].decoded != 0,
+              ncrs_decode(results[i].message, expect[i].symbols) != 0);
+    }
+    for (r = 0; r < RECEIVERS; r++) {
+        check("receiver frames", combine.stats[r].frames, NUM_RECORDINGS);
+        check("receiver missed", combine.stats[r].missed, 0);
+        check("receiver decoded", combine.stats[r].decoded, 0);
+        check("receiver errors", combine.stats[r].errors, errors[r]);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int i;
+
+    if (!ncrs_init()) {
+        fail("ncrs_init");
+    }
+    if (argc > 1) {
+        if ((argc - 1) > COMBINE_MAX_RECEIVERS) {
+            fail("too many receivers");
+        }
+        for (i = 1; i < argc; i++) {
+            load(&edges[i - 1], argv[i], 0);
+        }
+        print_results(run(argc - 1), argc - 1);
+        return 0;
+    }
+    test_recordings();
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,162 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "deferred.h"
+#include "nvram.h"
+#include "alarm.h"
+
+#define NVRAM_SIZE  0x38    // DS1307
+
+static uint8_t test_nvram[256];
+
+uint8_t nvram_read(uint8_t addr)
+{
+    return test_nvram[addr];
+}
+
+void nvram_write(uint8_t addr, uint8_t data)
+{
+    if ((addr < NVRAM_DEFERRED_CHECK) || (addr >= NVRAM_SIZE)) {
+        fprintf(stderr, "error: write to unexpected address 0x%x\n", addr);
+        exit(1);
+    }
+    test_nvram[addr] = data;
+}
+
+void display_message(const char* msg)
+{
+}
+
+static void check(const char* test, unsigned long got, unsigned long expected)
+{
+    if (got != expected) {
+        fprintf(stderr, "error: %s: got %lu expected %lu\n", test, got, expected);
+        exit(1);
+    }
+}
+
+static void add(const char* test, uint8_t hour, uint8_t minute, const char* action, int expected)
+{
+    check(test, deferred_add(hour, minute, (const uint8_t*) action, strlen(action)), expected);
+}
+
+// Run the main loop from one time of day until another (exclusive), checking
+// that the actions are run in the expected order
+static void run(const char* test, uint16_t from, uint16_t to, const char* expected)
+{
+    char got[256] = "";
+    uint16_t time;
+
+    for (time = from; time != to; time = (time + 1) % WHOLE_DAY) {
+        uint8_t action[DEFERRED_MAX_SIZE + 1];
+        uint8_t size;
+
+        while ((size = deferred_next(time / 60, time % 60, action)) != 0) {
+            unsigned i;
+
+            for (i = size; i < DEFERRED_MAX_SIZE; i++) {
+                check(test, action[i], 0);
+            }
+            action[size] = '\0';
+            snprintf(got + strlen(got), sizeof(got) - strlen(got), "%02u:%02u %s;",
+                     time / 60, time % 60, (const char*) action);
+        }
+    }
+    if (strcmp(got, expected) != 0) {
+        fprintf(stderr, "error: %s: got '%s' expected '%s'\n", test, got, expected);
+        exit(1);
+    }
+}
+
+static void reset(void)
+{
+    memset(test_nvram, 0xff, sizeof(test_nvram));
+    deferred_init();
+}
+
+int main(void)
+{
+    unsigned i;
+
+    // test: the queue is empty after NVRAM was not initialised
+    reset();
+    check("empty", deferred_count(), 0);
+    run("empty", 0, WHOLE_DAY - 1, "");
+
+    // test: actions run at their time, in order of time, not of arrival
+    reset();
+    add("order", 7, 30, "A1", 1);
+    add("order", 6, 0, "a", 1);
+    add("order", 7, 30, "A2", 1);
+    check("order", deferred_count(), 3);
+    run("order", 5 * 60, 8 * 60, "06:00 a;07:30 A1;07:30 A2;");
+    check("order", deferred_count(), 0);
+
+    // test: the queue is full, then has space again
+    reset();
+    add("full", 1, 0, "TTTT", 1);
+    add("full", 2, 0, "SSSS", 1);
+    add("full", 3, 0, "a", 0);
+    run("full", 0, 61, "01:00 TTTT;");
+    add("full", 3, 0, "a", 1);
+    run("full", 61, 4 * 60, "02:00 SSSS;03:00 a;");
+
+    // test: invalid parameters
+    reset();
+    add("invalid", 24, 0, "a", 0);
+    add("invalid", 0, 60, "a", 0);
+    add("invalid", 0, 0, "", 0);
+    add("invalid", 0, 0, "NNNNNNN", 0);
+    add("invalid", 23, 59, "NNNNNN", 1);
+
+    // test: an action received a little late runs at once, but not one
+    // which is much later: that waits for the next day
+    reset();
+    add("late", 12, 0, "A", 1);
+    add("late", 11, 45, "B", 1);
+    run("late", 12 * 60 + DEFERRED_LATE - 1, 12 * 60 + DEFERRED_LATE, "12:09 A;");
+    run("late", 12 * 60 + DEFERRED_LATE, 11 * 60 + 50, "11:45 B;");
+
+    // test: the time passes midnight, and the clock is set forwards
+    reset();
+    add("midnight", 0, 5, "A", 1);
+    add("midnight", 23, 55, "B", 1);
+    run("midnight", 23 * 60 + 50, 0, "23:55 B;");
+    run("midnight", 0, 4, "");
+    run("midnight", 6, 7, "00:06 A;");
+
+    // test: the queue is kept after a reboot
+    reset();
+    add("reboot", 9, 15, "A12", 1);
+    add("reboot", 8, 0, "a", 1);
+    deferred_init();
+    check("reboot", deferred_count(), 2);
+    run("reboot", 7 * 60, 10 * 60, "08:00 a;09:15 A12;");
+    deferred_init();
+    check("reboot", deferred_count(), 0);
+
+    // test: clear
+    reset();
+    add("clear", 9, 15, "A12", 1);
+    deferred_clear();
+    run("clear", 0, WHOLE_DAY - 1, "");
+
+    // test: invalid NVRAM contents are replaced, and damage is detected
+    for (i = 0; i < 256; i++) {
+        memset(test_nvram, i, sizeof(test_nvram));
+        deferred_init();
+        check("garbage", deferred_count(), 0);
+    }
+    for (i = 0; i < (DEFERRED_QUEUE_SIZE * 8); i++) {
+        reset();
+        add("damage", 9, 15, "A12", 1);
+        add("damage", 10, 0, "a", 1);
+        test_nvram[NVRAM_DEFERRED_QUEUE + (i / 8)] ^= 1 << (i % 8);
+        deferred_init();
+        check("damage", deferred_count(), 0);
+    }
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,215 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "drift.h"
+#include "nvram.h"
+
+#define ONE_DAY     86400
+#define ONE_WEEK    (7 * ONE_DAY)
+#define START_TIME  1700000000
+
+static uint8_t test_nvram[256];
+
+// Simulated RTC: the RTC time is the true time plus an offset, which
+// changes by the drift rate every second
+static uint32_t true_time = START_TIME;
+static double rtc_offset = 0.0;
+static double rtc_drift = 0.0; // ppm, positive if the RTC is slow
+static int32_t total_adjust = 0;
+
+uint8_t nvram_read(uint8_t addr)
+{
+    return test_nvram[addr];
+}
+
+void nvram_write(uint8_t addr, uint8_t data)
+{
+    if ((addr < NVRAM_DRIFT_SYNC) || (addr > NVRAM_DRIFT_MANUAL)) {
+        fprintf(stderr, "error: write to unexpected address 0x%x\n", addr);
+        exit(1);
+    }
+    test_nvram[addr] = data;
+}
+
+void display_message(const char* msg)
+{
+}
+
+static uint32_t rtc_time(void)
+{
+    return (uint32_t) floor((double) true_time + rtc_offset);
+}
+
+// Run for some seconds, calling drift_update every second like the main loop
+static void run(const char* test, uint32_t seconds)
+{
+    while (seconds > 0) {
+        int adjust;
+
+        true_time++;
+        rtc_offset -= rtc_drift * 1e-6;
+        adjust = drift_update(rtc_time());
+        if (adjust) {
+            uint8_t second = rtc_time() % 60;
+            if ((second < DRIFT_ADJUST_FROM) || (second > DRIFT_ADJUST_TO)
+            || ((adjust != 1) && (adjust != -1))) {
+                fprintf(stderr, "error: %s: adjustment %d at second %u\n", test, adjust, second);
+                exit(1);
+            }
+            rtc_offset += adjust;
+            total_adjust += adjust;
+        }
+        seconds--;
+    }
+}
+
+// Set the clock to the correct time (to the nearest second) and return the correction
+static int32_t set_clock(uint32_t new_time)
+{
+    int32_t correction = (int32_t) (new_time - rtc_time());
+
+    drift_clock_set(rtc_time(), new_time);
+    rtc_offset = (double) new_time - (double) true_time + (rtc_offset - floor(rtc_offset));
+    return correction;
+}
+
+static void check_estimate(const char* test, int expect, int tolerance)
+{
+    int estimate = drift_get_estimate();
+
+    if (abs(estimate - expect) > tolerance) {
+        fprintf(stderr, "error: %s: estimate %d, expected %d +/- %d\n",
+                        test, estimate, expect, tolerance);
+        exit(1);
+    }
+}
+
+static void check_correction(const char* test, int32_t correction, int32_t tolerance)
+{
+    if (labs((long) correction) > tolerance) {
+        fprintf(stderr, "error: %s: correction %d, expected at most %d\n",
+                        test, (int) correction, (int) tolerance);
+        exit(1);
+    }
+}
+
+static void reset(double drift)
+{
+    memset(test_nvram, 0xff, sizeof(test_nvram));
+    drift_init();
+    true_time = START_TIME;
+    rtc_offset = 0.0;
+    rtc_drift = drift;
+    total_adjust = 0;
+    set_clock(true_time);
+}
+
+// The clock is set every week; the estimate converges and the corrections become small
+static void weekly(const char* test, double drift)
+{
+    int32_t correction = 0;
+    unsigned i;
+
+    reset(drift);
+    for (i = 0; i < 10; i++) {
+        run(test, ONE_WEEK);
+        correction = set_clock(true_time);
+    }
+    check_estimate(test, (int) (drift * 10.0), 10);
+    check_correction(test, correction, 1);
+}
+
+int main(void)
+{
+    int32_t correction;
+    int16_t estimate;
+    unsigned i;
+
+    // test: no estimate, no adjustment
+    reset(0.0);
+    run("no drift", ONE_WEEK);
+    check_estimate("no drift", 0, 0);
+    if (total_adjust != 0) {
+        fprintf(stderr, "error: no drift: adjusted by %d\n", (int) total_adjust);
+        exit(1);
+    }
+
+    // test: the first measurement is the estimate, as there is no earlier one
+    // (a second in a week is 16.5 units)
+    reset(20.0);
+    run("first", ONE_WEEK);
+    set_clock(true_time);
+    check_estimate("first", 200, 17);
+
+    // test: estimates for slow and fast clocks
+    weekly("slow", 20.0);
+    weekly("fast", -35.0);
+    weekly("very slow", 180.0);
+    weekly("slight", 2.5);
+
+    // test: without the first clock setting, nothing is known
+    memset(test_nvram, 0xff, sizeof(test_nvram));
+    drift_init();
+    rtc_drift = 20.0;
+    run("not set", ONE_WEEK);
+    check_estimate("not set", 0, 0);
+
+    // test: a large change (e.g. summer time) does not affect the estimate
+    weekly("summer time", 20.0);
+    estimate = drift_get_estimate();
+    run("summer time", ONE_DAY * 3);
+    set_clock(true_time + 3600);
+    check_estimate("summer time", estimate, 0);
+    if (drift_get_applied() != 0) {
+        fprintf(stderr, "error: summer time: applied not reset\n");
+        exit(1);
+    }
+    run("summer time", ONE_WEEK);
+    correction = set_clock(true_time + 3600);
+    check_correction("summer time", correction, 1);
+    check_estimate("summer time", 200, 10);
+
+    // test: the estimate is still made if the clock is set every hour
+    reset(20.0);
+    for (i = 0; i < (24 * 28); i++) {
+        run("hourly", 3600);
+        set_clock(true_time);
+    }
+    check_estimate("hourly", 200, 20);
+
+    // test: the estimate and the adjustments are not lost after a reboot
+    weekly("reboot", -35.0);
+    for (i = 0; i < 7; i++) {
+        run("reboot", ONE_DAY);
+        drift_init();
+    }
+    correction = set_clock(true_time);
+    check_correction("reboot", correction, 1);
+    check_estimate("reboot", -350, 10);
+
+    // test: the clock is not set for a long time - adjustments stop at the limit
+    weekly("limit", 180.0);
+    run("limit", ONE_WEEK * 20);
+    if (drift_get_applied() != DRIFT_MAX_APPLIED) {
+        fprintf(stderr, "error: limit: applied %d\n", (int) drift_get_applied());
+        exit(1);
+    }
+
+    // test: invalid NVRAM contents are replaced
+    for (i = 0; i < 256; i++) {
+        memset(test_nvram, i, sizeof(test_nvram));
+        drift_init();
+        estimate = drift_get_estimate();
+        if ((estimate > DRIFT_MAX_ESTIMATE) || (estimate < -DRIFT_MAX_ESTIMATE)
+        || (drift_get_applied() > DRIFT_MAX_APPLIED) || (drift_get_applied() < -DRIFT_MAX_APPLIED)) {
+            fprintf(stderr, "error: invalid NVRAM: byte 0x%x\n", i);
+            exit(1);
+        }
+    }
+
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,152 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "night_day_time.h"
+#include "alarm.h"
+#include "nvram.h"
+
+static uint8_t test_nvram[256];
+
+uint8_t nvram_read(uint8_t addr)
+{
+    return test_nvram[addr];
+}
+
+void nvram_write(uint8_t addr, uint8_t data)
+{
+    test_nvram[addr] = data;
+}
+
+void display_message(const char* msg)
+{
+}
+
+// The original implementation, without caching or weekdays
+static int reference_test(uint16_t start_night_time, uint16_t start_day_time, uint16_t now_time)
+{
+    if (start_day_time == start_night_time) {
+        // permanent night time
+        return 1;
+    } else if (start_day_time < start_night_time) {
+        // e.g. day at 7am night at 11pm
+        return (now_time < start_day_time) || (now_time >= start_night_time);
+    } else {
+        // e.g. day at 9am night at 1am
+        return (now_time >= start_night_time) && (now_time < start_day_time);
+    }
+}
+
+static void check(const char* test, uint16_t night, uint16_t day,
+                  uint8_t weekday, uint16_t now_time)
+{
+    int expect = reference_test(night, day, now_time);
+    int got = night_day_time_test(weekday, now_time / 60, now_time % 60);
+
+    if (expect != got) {
+        fprintf(stderr, "error: %s: night %u day %u: expected %d at day %u %02u:%02u\n",
+                        test, night, day, expect, weekday, now_time / 60, now_time % 60);
+        exit(1);
+    }
+}
+
+static void set(uint16_t night, uint16_t day, uint8_t weekdays)
+{
+    night_day_time_set(night / 60, night % 60, day / 60, day % 60, weekdays);
+}
+
+int main(void)
+{
+    uint16_t night, day, now_time;
+    uint8_t weekday;
+    unsigned count = 0;
+
+    night_day_time_init();
+
+    // test: every setting gives the same results as the original implementation,
+    // checking the minutes around each transition, in time order, so that the
+    // cache is used. Every minute of the day is checked for some settings.
+    for (night = 0; night < WHOLE_DAY; night++) {
+        for (day = 0; day < WHOLE_DAY; day++) {
+            uint16_t times[8];
+            unsigned i, j;
+
+            set(night, day, 0);
+            weekday = count % 7;
+            count++;
+            if ((count % 101) == 0) {
+                for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+                    check("all", night, day, weekday, now_time);
+                }
+                continue;
+            }
+
+            times[0] = 0;
+            times[1] = night ? night - 1 : 0;
+            times[2] = night;
+            times[3] = (night + 1) % WHOLE_DAY;
+            times[4] = day ? day - 1 : 0;
+            times[5] = day;
+            times[6] = (day + 1) % WHOLE_DAY;
+            times[7] = WHOLE_DAY - 1;
+            for (i = 1; i < 8; i++) {
+                for (j = i; (j > 0) && (times[j - 1] > times[j]); j--) {
+                    now_time = times[j];
+                    times[j] = times[j - 1];
+                    times[j - 1] = now_time;
+                }
+            }
+            for (i = 0; i < 8; i++) {
+                check("transition", night, day, weekday, times[i]);
+            }
+        }
+    }
+
+    // test: settings are restored from NVRAM
+    set(23 * 60, 7 * 60, 0);
+    set(0, 9 * 60, 0x41);
+    night_day_time_init();
+    set(1, 2, 0x01);
+    memset(test_nvram, 0xff, sizeof(test_nvram));
+    set(23 * 60, 7 * 60, 0);
+    set(0, 9 * 60, 0x41);
+    night_day_time_init();
+
+    // test: different times at the weekend (Saturday and Sunday)
+    // Every minute of the week is checked, twice, then after a restart.
+    for (count = 0; count < 3; count++) {
+        for (weekday = 0; weekday < 7; weekday++) {
+            for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+                if ((weekday == 0) || (weekday == 6)) {
+                    check("weekend", 0, 9 * 60, weekday, now_time);
+                } else {
+                    check("weekday", 23 * 60, 7 * 60, weekday, now_time);
+                }
+            }
+        }
+        if (count == 1) {
+            night_day_time_init();
+        }
+    }
+
+    // test: setting times for every day removes the weekend times
+    set(22 * 60, 6 * 60, 0x7f);
+    for (weekday = 0; weekday < 7; weekday++) {
+        for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+            check("every day", 22 * 60, 6 * 60, weekday, now_time);
+        }
+    }
+
+    // test: invalid NVRAM contents are replaced (permanent night)
+    memset(test_nvram, 0xff, sizeof(test_nvram));
+    night_day_time_init();
+    for (weekday = 0; weekday < 7; weekday++) {
+        for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+            check("invalid", 0, 0, weekday, now_time);
+        }
+    }
+
+    printf("ok\n");
+    return 0;
+}
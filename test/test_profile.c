@@ -0,0 +1,134 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+#define CYCLES_PER_SECOND 48000000
+
+static int masked = 0;
+
+void disable_interrupts(void)
+{
+    masked++;
+}
+
+// As the firmware does, critical sections are recorded
+void enable_interrupts(void)
+{
+    masked--;
+    profile_record(PROFILE_MASKED, 1);
+}
+
+uint32_t profile_cycles(void)
+{
+    return 0;
+}
+
+uint32_t profile_cycles_per_second(void)
+{
+    return CYCLES_PER_SECOND;
+}
+
+static uint64_t get(const uint8_t* in, uint8_t size)
+{
+    uint64_t value = 0;
+
+    while (size > 0) {
+        size--;
+        value = (value << 8) | in[size];
+    }
+    return value;
+}
+
+static void check(const char* test, uint64_t got, uint64_t expected)
+{
+    if (got != expected) {
+        fprintf(stderr, "error: %s: got %llu expected %llu\n", test,
+                (unsigned long long) got, (unsigned long long) expected);
+        exit(1);
+    }
+}
+
+static const uint8_t* entry(const uint8_t* dump, profile_id_t id)
+{
+    return &dump[PROFILE_HEADER_SIZE + (id * PROFILE_ENTRY_SIZE)];
+}
+
+static uint64_t bucket(const uint8_t* dump, profile_id_t id, uint8_t index)
+{
+    return get(&entry(dump, id)[16 + (index * 2)], 2);
+}
+
+int main(void)
+{
+    static uint8_t dump[PROFILE_DUMP_SIZE];
+    uint32_t i;
+
+    // Header
+    check("dump size", profile_dump(dump), PROFILE_DUMP_SIZE);
+    check("magic", memcmp(dump, PROFILE_MAGIC, 4), 0);
+    check("cycles per second", get(&dump[4], 4), CYCLES_PER_SECOND);
+    check("histograms", dump[8], PROFILE_COUNT);
+    check("buckets", dump[9], PROFILE_BUCKETS);
+    check("empty", get(entry(dump, PROFILE_LOOP), 4), 0);
+
+    // Bucket n holds durations with n significant bits
+    profile_record(PROFILE_ISR, 0);
+    profile_record(PROFILE_ISR, 1);
+    profile_record(PROFILE_ISR, 2);
+    profile_record(PROFILE_ISR, 3);
+    profile_record(PROFILE_ISR, 4);
+    profile_record(PROFILE_ISR, 1000);
+    profile_record(PROFILE_ISR, 1023);
+    profile_record(PROFILE_ISR, 1024);
+    profile_record(PROFILE_ISR, 0xffffffff);
+    profile_dump(dump);
+    check("isr count", get(entry(dump, PROFILE_ISR), 4), 9);
+    check("isr max", get(&entry(dump, PROFILE_ISR)[4], 4), 0xffffffff);
+    check("isr total", get(&entry(dump, PROFILE_ISR)[8], 8),
+          0 + 1 + 2 + 3 + 4 + 1000 + 1023 + 1024 + 0xffffffffULL);
+    check("bucket 0", bucket(dump, PROFILE_ISR, 0), 1);
+    check("bucket 1", bucket(dump, PROFILE_ISR, 1), 1);
+    check("bucket 2", bucket(dump, PROFILE_ISR, 2), 2);
+    check("bucket 3", bucket(dump, PROFILE_ISR, 3), 1);
+    check("bucket 10", bucket(dump, PROFILE_ISR, 10), 2);
+    check("bucket 11", bucket(dump, PROFILE_ISR, 11), 1);
+    check("last bucket", bucket(dump, PROFILE_ISR, PROFILE_BUCKETS - 1), 1);
+    check("other histogram", get(entry(dump, PROFILE_MAIL), 4), 0);
+
+    // Every power of two, and one less
+    for (i = 1; i < PROFILE_BUCKETS; i++) {
+        profile_reset();
+        profile_record(PROFILE_DISPLAY, (1 << i) - 1);
+        profile_record(PROFILE_DISPLAY, 1 << (i - 1));
+        profile_dump(dump);
+        check("power of two", bucket(dump, PROFILE_DISPLAY, i), 2);
+    }
+
+    // Buckets saturate, and reset clears everything
+    for (i = 0; i < 70000; i++) {
+        profile_record(PROFILE_BUTTONS, 100);
+    }
+    profile_dump(dump);
+    check("count", get(entry(dump, PROFILE_BUTTONS), 4), 70000);
+    check("saturated", bucket(dump, PROFILE_BUTTONS, 7), 0xffff);
+    profile_reset();
+    profile_dump(dump);
+    for (i = 0; i < PROFILE_COUNT; i++) {
+        check("reset", get(entry(dump, i), 4), 0);
+        check("reset max", get(&entry(dump, i)[4], 4), 0);
+    }
+    check("interrupts enabled", masked, 0);
+
+    // The critical sections of reset and dump are not recorded, others are
+    check("masked not sampled", get(entry(dump, PROFILE_MASKED), 4), 0);
+    disable_interrupts();
+    enable_interrupts();
+    profile_dump(dump);
+    profile_dump(dump);
+    check("masked sampled", get(entry(dump, PROFILE_MASKED), 4), 1);
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,442 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libnc.h"
+#include "ncrs.h"
+#include "rx433.h"
+
+#define NC_TIME         ((NC_DATA_SIZE * NC_SYMBOL_TIME) + (NC_PULSE * 2))
+#define NC2_TIME        (NC2_SYNC_1 + NC2_SYNC_2 + (NC_DATA_SIZE * NC2_SYMBOL_TIME) + (NC_PULSE * 2))
+#define MAX_PULSES      (LIBNC_HE_MAX_ATTEMPTS * LIBNC_HE_PULSES)
+#define LOST_SYMBOLS    4
+#define ALL_SYMBOLS     ((1UL << NC_DATA_SIZE) - 1)
+#define HE_CODE         0x4022b83
+#define HE_TIME         (220 * 66 + 2700 + (1330 + 320) * 32 + 10270)
+#define NOISE_TIME      160     // from a timebase: outside EPSILON, within one pulse
+
+static uint32_t test_time = 0;
+
+uint32_t micros()
+{
+    return test_time;
+}
+
+static void check(const char* test, unsigned long got, unsigned long expected)
+{
+    if (got != expected) {
+        fprintf(stderr, "error: %s: got %lu expected %lu\n", test, got, expected);
+        exit(1);
+    }
+}
+
+// Compare the first symbols of the new code, which is packed
+static int compare_new_code(const uint8_t* message, size_t size)
+{
+    uint8_t symbols[NC_DATA_SIZE];
+
+    ncrs_unpack(symbols, rx433_new_code);
+    return memcmp(message, symbols, size);
+}
+
+static void send_times(uint32_t start, const uint32_t* times, size_t from, size_t to)
+{
+    size_t i;
+
+    for (i = from; i < to; i++) {
+        test_time = start + times[i];
+        rx433_interrupt();
+    }
+}
+
+// Send the rising edges of a pulse table to rx433_interrupt, returning the duration
+static uint32_t send_edges(const libnc_pulse_t* pulses, size_t count)
+{
+    uint32_t times[MAX_PULSES];
+    uint32_t start = test_time;
+    uint32_t duration = 0;
+    size_t i;
+
+    check("pulse table size", count <= MAX_PULSES, 1);
+    send_times(start, times, 0, libnc_edges(pulses, count, times));
+    for (i = 0; i < count; i++) {
+        duration += pulses[i].high_us + pulses[i].low_us;
+    }
+    test_time = start + duration;
+    // an incomplete new code is finished at the next edge
+    rx433_interrupt();
+    test_time += 100000;
+    return test_time - start - 100000;
+}
+
+// As send_edges, after taking any earlier codes
+static uint32_t receive(const libnc_pulse_t* pulses, size_t count)
+{
+    rx433_home_easy = 0;
+    rx433_new_code_ready = 0;
+    return send_edges(pulses, count);
+}
+
+static void test_nc(void)
+{
+    libnc_pulse_t pulses[LIBNC_NC_MAX_PULSES];
+    uint8_t packet[DECODED_DATA_BYTES];
+    uint8_t message[NC_DATA_SIZE];
+    libnc_timing_t timing;
+    size_t i, count, ones = 0;
+    uint32_t start;
+
+    for (i = 0; i < DECODED_DATA_BYTES; i++) {
+        packet[i] = i * 71;
+    }
+    ncrs_encode(message, packet);
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        ones += __builtin_popcount(message[i]);
+    }
+
+    // one entry per high pulse: the idle periods of 0 bits are merged
+    count = libnc_nc_pulses(message, NULL, pulses, LIBNC_NC_MAX_PULSES);
+    check("nc count", count, (NC_DATA_SIZE * 2) + ones + 1);
+    check("nc first high", pulses[0].high_us, NC_PULSE * 2);
+    start = test_time;
+    check("nc time", receive(pulses, count), NC_TIME);
+    check("nc ready", rx433_new_code_ready, 1);
+    check("nc code", compare_new_code(message, NC_DATA_SIZE), 0);
+    check("nc version", rx433_decoder.new_code_version, 1);
+    check("nc received", rx433_decoder.new_code_received, ALL_SYMBOLS);
+    check("nc start", rx433_decoder.new_code_time, start + (NC_PULSE * 3));
+
+    // high pulses are longer, but the period is the same
+    timing.high_adjust_us = 40;
+    timing.clock_ppm = 0;
+    check("nc adjust count", libnc_nc_pulses(message, &timing, pulses, LIBNC_NC_MAX_PULSES), count);
+    check("nc adjust high", pulses[0].high_us, (NC_PULSE * 2) + 40);
+    check("nc adjust time", receive(pulses, count), NC_TIME);
+    check("nc adjust code", compare_new_code(message, NC_DATA_SIZE), 0);
+
+    // clock correction
+    timing.high_adjust_us = 0;
+    timing.clock_ppm = 10000;
+    check("nc clock count", libnc_nc_pulses(message, &timing, pulses, LIBNC_NC_MAX_PULSES), count);
+    check("nc clock high", pulses[0].high_us, ((NC_PULSE * 2) * 101) / 100);
+    check("nc clock ready", (receive(pulses, count), rx433_new_code_ready), 1);
+
+    // the receiver follows a transmitter whose clock is a few percent out
+    timing.clock_ppm = 40000;
+    libnc_nc_pulses(message, &timing, pulses, LIBNC_NC_MAX_PULSES);
+    check("nc fast ready", (receive(pulses, count), rx433_new_code_ready), 1);
+    check("nc fast code", compare_new_code(message, NC_DATA_SIZE), 0);
+    timing.clock_ppm = -40000;
+    libnc_nc_pulses(message, &timing, pulses, LIBNC_NC_MAX_PULSES);
+    check("nc slow ready", (receive(pulses, count), rx433_new_code_ready), 1);
+    check("nc slow code", compare_new_code(message, NC_DATA_SIZE), 0);
+
+    // errors
+    check("nc too small", libnc_nc_pulses(message, NULL, pulses, count - 1), 0);
+    timing.high_adjust_us = -NC_PULSE;
+    timing.clock_ppm = 0;
+    check("nc bad adjust", libnc_nc_pulses(message, &timing, pulses, LIBNC_NC_MAX_PULSES), 0);
+}
+
+// Add an edge, keeping the times in order
+static size_t add_time(uint32_t* times, size_t n, uint32_t time)
+{
+    size_t i = n;
+
+    while ((i > 0) && (times[i - 1] > time)) {
+        times[i] = times[i - 1];
+        i--;
+    }
+    times[i] = time;
+    return n + 1;
+}
+
+// The new code is the encoded packet
+static int decodes(const uint8_t* packet)
+{
+    uint8_t decoded[DECODED_DATA_BYTES];
+
+    return rx433_new_code_ready
+        && (ncrs_decode_packed(decoded, rx433_new_code) > 0)
+        && (memcmp(decoded, packet, DECODED_DATA_BYTES) == 0);
+}
+
+// Noise edges near the symbol boundaries, where start codes are expected
+static void test_nc_noise(void)
+{
+    libnc_pulse_t pulses[LIBNC_NC_MAX_PULSES];
+    uint8_t packet[DECODED_DATA_BYTES];
+    uint8_t message[NC_DATA_SIZE];
+    uint32_t times[LIBNC_NC_MAX_PULSES + 2];
+    size_t i, j, k, n, count;
+    uint32_t start;
+
+    for (i = 0; i < DECODED_DATA_BYTES; i++) {
+        packet[i] = i * 71;
+    }
+    ncrs_encode(message, packet);
+    ncrs_decode(packet, message);
+    count = libnc_nc_pulses(message, NULL, pulses, LIBNC_NC_MAX_PULSES);
+
+    for (k = 1; k < NC_DATA_SIZE; k++) {
+        // the timebase of symbol k is the second edge of its start code
+        uint32_t timebase = (NC_PULSE * 3) + (NC_SYMBOL_TIME * k);
+
+        // an edge soon after the timebase, in the start bit
+        rx433_new_code_ready = 0;
+        n = add_time(times, libnc_edges(pulses, count, times), timebase + NOISE_TIME);
+        start = test_time;
+        send_times(start, times, 0, n);
+        test_time = start + times[n - 1] + 100000;
+        rx433_interrupt();
+        check("noise in start bit", decodes(packet), 1);
+
+        // the start code is lost, and noise edges 3 pulses apart arrive outside
+        // EPSILON: they are not a start code, and do not move the estimate
+        for (j = 0; j < 2; j++) {
+            uint32_t noise = j ? (timebase + NOISE_TIME) : (timebase - NOISE_TIME);
+            uint32_t period, symbol_time;
+
+            rx433_new_code_ready = 0;
+            n = libnc_edges(pulses, count, times);
+            for (i = 0; (i < n) && (times[i] < (timebase - (NC_PULSE * 3))); i++) {}
+            check("noise start code", times[i + 1], timebase);
+            memmove(&times[i], &times[i + 2], (n - i - 2) * sizeof(uint32_t));
+            n = add_time(times, n - 2, noise - (NC_PULSE * 3));
+            n = add_time(times, n, noise);
+            start = test_time;
+            send_times(start, times, 0, i);
+            period = rx433_decoder.nc_period;
+            symbol_time = rx433_decoder.nc_timebase;
+            send_times(start, times, i, i + 2);
+            check("noise period", rx433_decoder.nc_period, period);
+            check("noise timebase", rx433_decoder.nc_timebase, symbol_time);
+            send_times(start, times, i + 2, n);
+            test_time = start + times[n - 1] + 100000;
+            rx433_interrupt();
+            if (k >= (NC_DATA_SIZE - LOST_SYMBOLS)) {
+                // the message ends early, and the lost symbols are corrected
+                check("noise lost start code", decodes(packet), 1);
+            }
+        }
+        test_time += 100000;
+    }
+}
+
+static void test_nc2(void)
+{
+    libnc_pulse_t pulses[LIBNC_NC2_MAX_PULSES];
+    libnc_pulse_t v1_pulses[LIBNC_NC_MAX_PULSES];
+    uint32_t times[LIBNC_NC2_MAX_PULSES];
+    uint8_t message[NC_DATA_SIZE];
+    libnc_timing_t timing;
+    size_t i, n, count, v1_count;
+    uint32_t time, start;
+
+    // every symbol value
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        message[i] = (i * 13) & 31;
+    }
+    count = libnc_nc2_pulses(message, NULL, pulses, LIBNC_NC2_MAX_PULSES);
+    check("nc2 sync", pulses[0].high_us + pulses[0].low_us, NC2_SYNC_1);
+    start = test_time;
+    check("nc2 time", receive(pulses, count), NC2_TIME);
+    check("nc2 ready", rx433_new_code_ready, 1);
+    check("nc2 code", compare_new_code(message, NC_DATA_SIZE), 0);
+    check("nc2 version", rx433_decoder.new_code_version, 2);
+    check("nc2 received", rx433_decoder.new_code_received, ALL_SYMBOLS);
+    check("nc2 start", rx433_decoder.new_code_time, start + NC2_SYNC_1 + NC2_SYNC_2);
+
+    // shorter than version 1
+    v1_count = libnc_nc_pulses(message, NULL, v1_pulses, LIBNC_NC_MAX_PULSES);
+    check("nc2 shorter", NC2_TIME < receive(v1_pulses, v1_count), 1);
+    check("nc2 then nc", compare_new_code(message, NC_DATA_SIZE), 0);
+
+    // calibration
+    timing.high_adjust_us = 40;
+    timing.clock_ppm = -10000;
+    check("nc2 timing count", libnc_nc2_pulses(message, &timing, pulses, LIBNC_NC2_MAX_PULSES), count);
+    check("nc2 timing ready", (receive(pulses, count), rx433_new_code_ready), 1);
+    check("nc2 timing code", compare_new_code(message, NC_DATA_SIZE), 0);
+
+    // the pulse in slot 0 after the last symbol ends the message, without
+    // waiting for a later edge, even if it is early
+    count = libnc_nc2_pulses(message, NULL, pulses, LIBNC_NC2_MAX_PULSES);
+    n = libnc_edges(pulses, count, times);
+    for (i = 0; i < 2; i++) {
+        rx433_new_code_ready = 0;
+        times[n - 1] -= i * NOISE_TIME;
+        send_times(test_time, times, 0, n);
+        check("nc2 end ready", rx433_new_code_ready, 1);
+        check("nc2 end code", compare_new_code(message, NC_DATA_SIZE), 0);
+        test_time += 100000;
+    }
+
+    // the last symbols may be lost
+    count = libnc_nc2_pulses(message, NULL, pulses, LIBNC_NC2_MAX_PULSES);
+    for (i = 0, time = 0; i < count; i++) {
+        if (time >= (NC2_SYNC_1 + NC2_SYNC_2 + ((NC_DATA_SIZE - LOST_SYMBOLS) * NC2_SYMBOL_TIME))) {
+            pulses[i].low_us += pulses[i].high_us;
+            pulses[i].high_us = 0;
+        }
+        time += pulses[i].high_us + pulses[i].low_us;
+    }
+    check("nc2 incomplete ready", (receive(pulses, count), rx433_new_code_ready), 1);
+    check("nc2 incomplete code", compare_new_code(message,
+                                        NC_DATA_SIZE - LOST_SYMBOLS), 0);
+    check("nc2 incomplete received", rx433_decoder.new_code_received,
+          ALL_SYMBOLS >> LOST_SYMBOLS);
+
+    // without the sync word, nothing is received
+    check("nc2 no sync", (receive(&pulses[2], count - 2), rx433_new_code_ready), 0);
+
+    check("nc2 too small", libnc_nc2_pulses(message, NULL, pulses, count - 1), 0);
+}
+
+static void test_he(void)
+{
+    libnc_pulse_t pulses[LIBNC_HE_MAX_ATTEMPTS * LIBNC_HE_PULSES];
+    const libnc_pulse_t* cached;
+    const libnc_pulse_t* again;
+    libnc_timing_t timing;
+    size_t count, cached_count;
+    unsigned i;
+
+    count = libnc_he_pulses(HE_CODE, 3, NULL, pulses, LIBNC_HE_MAX_ATTEMPTS * LIBNC_HE_PULSES);
+    check("he count", count, LIBNC_HE_PULSES * 3);
+    check("he time", receive(pulses, count), HE_TIME * 3);
+    check("he code", rx433_home_easy, HE_CODE);
+    check("he no attempts", libnc_he_pulses(HE_CODE, 0, NULL, pulses, LIBNC_HE_PULSES), 0);
+
+    // cached tables are reused for the same code, attempts and timing
+    cached = libnc_he_pulses_cached(HE_CODE, 3, NULL, &cached_count);
+    check("cached", cached != NULL, 1);
+    check("cached count", cached_count, count);
+    check("cached pulses", memcmp(cached, pulses, count * sizeof(libnc_pulse_t)), 0);
+    again = libnc_he_pulses_cached(HE_CODE, 3, NULL, &cached_count);
+    check("cached again", again == cached, 1);
+
+    memset(&timing, 0, sizeof(timing));
+    again = libnc_he_pulses_cached(HE_CODE, 3, &timing, &cached_count);
+    check("cached zero timing", again == cached, 1);
+    timing.high_adjust_us = 20;
+    again = libnc_he_pulses_cached(HE_CODE, 3, &timing, &cached_count);
+    check("cached other timing", again != cached, 1);
+    check("cached other timing high", again[0].high_us, 240);
+    again = libnc_he_pulses_cached(HE_CODE, 2, NULL, &cached_count);
+    check("cached other attempts", cached_count, LIBNC_HE_PULSES * 2);
+
+    // old tables are replaced
+    for (i = 0; i < LIBNC_HE_CACHE_SIZE; i++) {
+        libnc_he_pulses_cached(i, 1, NULL, &cached_count);
+    }
+    cached = libnc_he_pulses_cached(HE_CODE, 3, NULL, &cached_count);
+    check("rebuilt count", cached_count, count);
+    check("rebuilt pulses", memcmp(cached, pulses, count * sizeof(libnc_pulse_t)), 0);
+    check("too many attempts",
+          libnc_he_pulses_cached(HE_CODE, LIBNC_HE_MAX_ATTEMPTS + 1, NULL, &cached_count) == NULL, 1);
+}
+
+static void test_he_votes(void)
+{
+    libnc_pulse_t pulses[LIBNC_HE_MAX_ATTEMPTS * LIBNC_HE_PULSES];
+    rx433_he_stats_t before;
+    size_t count;
+
+    // a single copy is not enough
+    test_time += RX433_HE_BURST_TIME;
+    count = libnc_he_pulses(HE_CODE, 1, NULL, pulses, LIBNC_HE_PULSES);
+    check("one copy", (receive(pulses, count), rx433_home_easy), 0);
+
+    // a damaged copy is outvoted: the code is accepted at the third copy
+    test_time += RX433_HE_BURST_TIME;
+    memcpy(&before, (const void*) &rx433_he_stats, sizeof(before));
+    count = libnc_he_pulses(HE_CODE ^ 0x100, 1, NULL, pulses, LIBNC_HE_PULSES);
+    count += libnc_he_pulses(HE_CODE, 2, NULL, &pulses[count], LIBNC_HE_PULSES * 2);
+    check("damaged copy", (receive(pulses, count), rx433_home_easy), HE_CODE);
+    check("damaged copy unconfirmed", rx433_he_stats.unconfirmed, before.unconfirmed + 1);
+    check("damaged copy needed", rx433_he_stats.copies_needed[2], before.copies_needed[2] + 1);
+
+    // the rest of the burst is ignored
+    memcpy(&before, (const void*) &rx433_he_stats, sizeof(before));
+    count = libnc_he_pulses(HE_CODE, 10, NULL, pulses, LIBNC_HE_PULSES * 10);
+    check("burst", (receive(pulses, count), rx433_home_easy), 0);
+    check("burst copies", rx433_he_stats.copies, before.copies + 10);
+    check("burst suppressed", rx433_he_stats.suppressed, before.suppressed + 10);
+
+    // but not the next burst
+    test_time += RX433_HE_BURST_TIME;
+    memcpy(&before, (const void*) &rx433_he_stats, sizeof(before));
+    check("next burst", (receive(pulses, count), rx433_home_easy), HE_CODE);
+    check("next burst accepted", rx433_he_stats.accepted, before.accepted + 1);
+    check("next burst needed", rx433_he_stats.copies_needed[1], before.copies_needed[1] + 1);
+    check("next burst suppressed", rx433_he_stats.suppressed, before.suppressed + 8);
+}
+
+// Packed symbols, and the frames which pass new codes to the consumer
+static void test_frames(void)
+{
+    libnc_pulse_t pulses[LIBNC_NC_MAX_PULSES];
+    uint8_t message[NC_DATA_SIZE];
+    uint8_t symbols[NC_DATA_SIZE];
+    uint8_t packed[RX433_PACKED_SIZE];
+    uint8_t taken[RX433_PACKED_SIZE];
+    const uint8_t* owned;
+    size_t i, j, count;
+
+    // each symbol is 5 bits, most significant bit first
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        message[i] = (i * 7) & 31;
+    }
+    ncrs_pack(packed, message);
+    check("packed first", packed[0], (0 << 3) | (7 >> 2));
+    check("packed last", packed[RX433_PACKED_SIZE - 1], (((30 * 7) & 31) << 5) & 0xff);
+    ncrs_unpack(symbols, packed);
+    check("unpack", memcmp(message, symbols, NC_DATA_SIZE), 0);
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        check("symbol", ncrs_symbol(packed, i), message[i]);
+    }
+
+    // the consumer takes a new code, then keeps it while more are received
+    // (with both line codings) and are not taken, or are taken
+    count = libnc_nc2_pulses(message, NULL, pulses, LIBNC_NC_MAX_PULSES);
+    check("frames first", (receive(pulses, count), rx433_new_code_ready), 1);
+    owned = rx433_new_code;
+    rx433_new_code_ready = 0;
+    memcpy(taken, owned, RX433_PACKED_SIZE);
+    for (i = 0; i < 6; i++) {
+        for (j = 0; j < NC_DATA_SIZE; j++) {
+            symbols[j] = (j * (i + 3)) & 31;
+        }
+        if (i & 1) {
+            count = libnc_nc_pulses(symbols, NULL, pulses, LIBNC_NC_MAX_PULSES);
+        } else {
+            count = libnc_nc2_pulses(symbols, NULL, pulses, LIBNC_NC_MAX_PULSES);
+        }
+        check("frames ready", (send_edges(pulses, count), rx433_new_code_ready), 1);
+        check("frames code", compare_new_code(symbols, NC_DATA_SIZE), 0);
+        check("frames owned", memcmp(owned, taken, RX433_PACKED_SIZE), 0);
+        check("frames distinct", rx433_new_code != owned, 1);
+        if (i >= 3) {
+            // taken: the previous frame may now be reused
+            owned = rx433_new_code;
+            rx433_new_code_ready = 0;
+            memcpy(taken, owned, RX433_PACKED_SIZE);
+        }
+    }
+}
+
+int main(void)
+{
+    if (!ncrs_init()) {
+        return 1;
+    }
+    test_nc();
+    test_nc_noise();
+    test_nc2();
+    test_frames();
+    test_he();
+    test_he_votes();
+    printf("ok\n");
+    return 0;
+}
@@ -5,6 +5,8 @@
 #include <string.h>
 
 #include "rx433.h"
+#include "ncrs.h"
+#include "capture.h"
 
 uint32_t test_time = 0;
 extern void rx433_interrupt(void);
@@ -14,9 +16,17 @@ uint32_t micros()
     return test_time;
 }
 
+void display_message(const char* m)
+{
+    fprintf(stderr, "message: %s\n", m);
+}
+
 static int matches_test_code(const uint8_t* expect)
 {
-    return memcmp(expect, (const uint8_t*) rx433_new_code, NC_DATA_SIZE) == 0;
+    uint8_t packed[RX433_PACKED_SIZE];
+
+    ncrs_pack(packed, expect);
+    return memcmp(packed, rx433_new_code, RX433_PACKED_SIZE) == 0;
 }
 
 static uint8_t TEST_CODE_1[] =
@@ -41,17 +51,18 @@ static uint8_t TEST_CODE_9[] =
 
 int main(void)
 {
-    FILE* fd;
+    capture_t cap;
+    const char* error = "";
     unsigned test1_count = 0;
     unsigned test2_count = 0;
     unsigned test3_count = 0;
+    unsigned i;
 
-    fd = fopen("test_rx433.txt", "rt");
-    if (!fd) {
-        perror("unable to read test data");
+    if (!capture_open(&cap, "test_rx433.cap", &error)) {
+        fprintf(stderr, "unable to read test data: %s\n", error);
         return 1;
     }
-    while (fscanf(fd, "%x\n", &test_time) == 1) {
+    while (capture_next(&cap, &test_time)) {
         rx433_home_easy = 0;
         rx433_new_code_ready = 0;
         rx433_interrupt();
@@ -86,27 +97,41 @@ int main(void)
                 test3_count++;
                 printf("%d new code %d\n", test_time, c);
             } else {
-                unsigned i;
                 fprintf(stderr, "%d invalid new code received: ", test_time);
                 for (i = 0; i < NC_DATA_SIZE; i++) {
-                    fprintf(stderr, "%0d, ", rx433_new_code[i]);
+                    fprintf(stderr, "%0d, ", ncrs_symbol(rx433_new_code, i));
                 }
                 fprintf(stderr, "\n");
                 return 1;
             }
         }
     }
-    fclose(fd);
-    if ((test1_count < 15)
-    || (test2_count < 15)
+    capture_close(&cap);
+    // Each Home Easy recording is one burst of 15 .. 20 good copies of its code.
+    // Each code is accepted once, when its 2nd copy agrees with the 1st, and
+    // the rest of its copies are suppressed.
+    for (i = 0; i < RX433_HE_STATS_COPIES; i++) {
+        if (rx433_he_stats.copies_needed[i] != ((i == (RX433_HE_VOTES - 1)) ? 2 : 0)) {
+            fprintf(stderr, "incorrect copies needed: %u codes at copy %u\n",
+                        rx433_he_stats.copies_needed[i], i + 1);
+            return 1;
+        }
+    }
+    if ((test1_count != 1)
+    || (test2_count != 1)
     || (test3_count != 9)
-    || (test1_count > 20)
-    || (test2_count > 20)) {
-        fprintf(stderr, "incorrect results: %u %u %u\n",
-                    test1_count, test2_count, test3_count);
+    || (rx433_he_stats.accepted != 2)
+    || (rx433_he_stats.unconfirmed != 0)
+    || (rx433_he_stats.copies < 30)
+    || (rx433_he_stats.copies > 40)
+    || (rx433_he_stats.suppressed != (rx433_he_stats.copies - (2 * RX433_HE_VOTES)))) {
+        fprintf(stderr, "incorrect results: %u %u %u, %u copies, %u suppressed\n",
+                    test1_count, test2_count, test3_count, rx433_he_stats.copies,
+                    rx433_he_stats.suppressed);
         return 1;
     }
-    printf("ok %u %u %u\n", test1_count, test2_count, test3_count);
+    printf("ok %u %u %u, %u copies\n", test1_count, test2_count, test3_count,
+           rx433_he_stats.copies);
     return 0;
 }
 
@@ -0,0 +1,572 @@
+
+// Exhaustive checks for the alarm and night/day time modules.
+//
+// Each module is compared with a simple reference model over the whole of its
+// input space: every alarm time, current time and state, every NVRAM value
+// which might be found at boot, and every pair of night/day times. The work is
+// split into jobs which are shared between worker processes. The modules keep
+// their state in static variables, so each worker needs its own copy.
+//
+// Usage: test_state_space.exe [number of workers]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "alarm.h"
+#include "night_day_time.h"
+#include "nvram.h"
+
+#define DISABLED        0
+#define ENABLED         1
+#define ACTIVE          2
+#define RESET           3
+#define NUM_STATES      4
+
+#define WHOLE_WEEK      (7 * WHOLE_DAY)
+#define SCHEDULE_ADDR(slot) (NVRAM_SCHEDULE_BASE + (((slot) - 1) * NVRAM_SCHEDULE_ENTRY_SIZE))
+
+static uint8_t test_nvram[256];
+static const char* job_name = "";
+static unsigned job_index = 0;
+
+static void fail(const char* msg, unsigned a, unsigned b, unsigned c)
+{
+    fprintf(stderr, "error: %s job %u: %s (%u, %u, %u)\n", job_name, job_index, msg, a, b, c);
+    exit(1);
+}
+
+uint8_t nvram_read(uint8_t addr)
+{
+    return test_nvram[addr];
+}
+
+void nvram_write(uint8_t addr, uint8_t data)
+{
+    if ((addr == NVRAM_ALARM_STATE) && (data >= NUM_STATES)) {
+        fail("write of weird value to state", data, 0, 0);
+    }
+    if ((addr >= NVRAM_SCHEDULE_BASE) && (addr < SCHEDULE_ADDR(ALARM_SCHEDULE_SIZE))
+    && (((addr - NVRAM_SCHEDULE_BASE) % NVRAM_SCHEDULE_ENTRY_SIZE) == 1)
+    && ((data >> 3) >= NUM_STATES)) {
+        fail("write of weird value to scheduled state", addr, data, 0);
+    }
+    test_nvram[addr] = data;
+}
+
+void display_message(const char* msg)
+{
+}
+
+// Reference model for the alarms
+
+typedef struct ref_alarm_s {
+    uint16_t    time;
+    uint8_t     weekdays;
+    uint8_t     state;
+} ref_alarm_t;
+
+static ref_alarm_t ref[ALARM_SCHEDULE_SIZE];
+static unsigned last_rc = 0;
+
+// Alarm is sounding if it began at one of the last ALARM_SOUNDS_FOR minutes
+static unsigned ref_region(const ref_alarm_t* a, uint8_t weekday, uint16_t now_time)
+{
+    unsigned i;
+
+    if ((now_time >= WHOLE_DAY) || (a->state == DISABLED)) {
+        return 0;
+    }
+    for (i = 1; i <= ALARM_SOUNDS_FOR; i++) {
+        if ((now_time == a->time)
+        && ((weekday == ALARM_NO_WEEKDAY) || (a->weekdays & (1 << weekday)))) {
+            return i;
+        }
+        if (now_time == 0) {
+            now_time = WHOLE_DAY;
+            if (weekday != ALARM_NO_WEEKDAY) {
+                weekday = (weekday + 6) % 7;
+            }
+        }
+        now_time--;
+    }
+    return 0;
+}
+
+static unsigned ref_update(uint8_t weekday, uint16_t now_time)
+{
+    unsigned slot, sounding = 0;
+
+    for (slot = 0; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        ref_alarm_t* a = &ref[slot];
+        unsigned region = ref_region(a, weekday, now_time);
+
+        if ((a->state == ACTIVE) && !region) {
+            a->state = slot ? ENABLED : DISABLED;
+        } else if ((a->state == ENABLED) && region) {
+            a->state = ACTIVE;
+        } else if ((a->state == RESET) && !region) {
+            a->state = ENABLED;
+        }
+        if ((a->state == ACTIVE) && (region > sounding)) {
+            sounding = region;
+        }
+    }
+    return sounding;
+}
+
+static void ref_silence(void)
+{
+    unsigned slot;
+
+    for (slot = 1; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        if (ref[slot].state == ACTIVE) {
+            ref[slot].state = RESET;
+        }
+    }
+}
+
+static void ref_set(uint16_t alarm_time)
+{
+    ref[0].time = (alarm_time < WHOLE_DAY) ? alarm_time : 0;
+    ref[0].weekdays = ALARM_EVERY_DAY;
+    ref[0].state = RESET;
+    ref_silence();
+}
+
+static void ref_unset(void)
+{
+    ref[0].state = DISABLED;
+    ref_silence();
+}
+
+static void ref_schedule_set(uint8_t slot, uint8_t hour, uint8_t minute, uint8_t weekdays)
+{
+    if ((slot == 0) || (slot >= ALARM_SCHEDULE_SIZE) || (hour >= 24) || (minute >= 60)) {
+        return;
+    }
+    ref[slot].time = (hour * 60) + minute;
+    ref[slot].weekdays = weekdays & ALARM_EVERY_DAY;
+    ref[slot].state = ref[slot].weekdays ? RESET : DISABLED;
+}
+
+// Decode the NVRAM contents in the same way as alarm_init
+static void ref_init(void)
+{
+    unsigned slot;
+
+    ref[0].time = ((uint16_t) test_nvram[NVRAM_ALARM_HI] << 8) | test_nvram[NVRAM_ALARM_LO];
+    ref[0].state = test_nvram[NVRAM_ALARM_STATE];
+    ref[0].weekdays = ALARM_EVERY_DAY;
+    for (slot = 1; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        const uint8_t* entry = &test_nvram[SCHEDULE_ADDR(slot)];
+        ref[slot].weekdays = (entry[0] > ALARM_EVERY_DAY) ? 0 : entry[0];
+        ref[slot].state = ref[slot].weekdays ? (entry[1] >> 3) : DISABLED;
+        ref[slot].time = ((uint16_t) (entry[1] & 7) << 8) | entry[2];
+    }
+    for (slot = 0; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        if (ref[slot].time >= WHOLE_DAY) {
+            ref[slot].time = 0;
+        }
+        if (ref[slot].state >= NUM_STATES) {
+            ref[slot].state = DISABLED;
+        }
+    }
+}
+
+// Write the reference model to NVRAM, as if saved before a power failure
+static void ref_save(void)
+{
+    unsigned slot;
+
+    test_nvram[NVRAM_ALARM_HI] = ref[0].time >> 8;
+    test_nvram[NVRAM_ALARM_LO] = ref[0].time;
+    test_nvram[NVRAM_ALARM_STATE] = ref[0].state;
+    for (slot = 1; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        uint8_t* entry = &test_nvram[SCHEDULE_ADDR(slot)];
+        entry[0] = ref[slot].weekdays;
+        entry[1] = (ref[slot].state << 3) | (ref[slot].time >> 8);
+        entry[2] = ref[slot].time;
+    }
+}
+
+// The alarm module must have saved the same settings as the reference model
+static void ref_compare(const char* msg, unsigned a, unsigned b)
+{
+    unsigned slot;
+
+    if ((test_nvram[NVRAM_ALARM_STATE] != ref[0].state)
+    || ((((uint16_t) test_nvram[NVRAM_ALARM_HI] << 8) | test_nvram[NVRAM_ALARM_LO]) != ref[0].time)) {
+        fail(msg, a, b, 0);
+    }
+    for (slot = 1; slot < ALARM_SCHEDULE_SIZE; slot++) {
+        const uint8_t* entry = &test_nvram[SCHEDULE_ADDR(slot)];
+        if ((entry[0] != ref[slot].weekdays)
+        || ((entry[1] >> 3) != ref[slot].state)
+        || ((((uint16_t) (entry[1] & 7) << 8) | entry[2]) != ref[slot].time)) {
+            fail(msg, a, b, slot);
+        }
+    }
+}
+
+// Both models are updated; the results must match. If alarm_update_due
+// said that no update was needed, then the update must do nothing, and
+// the result must be the same as last time.
+static unsigned both_update(uint8_t weekday, uint16_t now_time)
+{
+    int due = alarm_update_due(weekday, now_time / 60, now_time % 60);
+    ref_alarm_t before[ALARM_SCHEDULE_SIZE];
+    unsigned expect, rc;
+
+    memcpy(before, ref, sizeof(ref));
+    expect = ref_update(weekday, now_time);
+    rc = alarm_update_weekday(weekday, now_time / 60, now_time % 60);
+    if (rc != expect) {
+        fail("alarm_update_weekday result is incorrect", weekday, now_time, rc);
+    }
+    ref_compare("state after update is incorrect", weekday, now_time);
+    if ((!due) && ((rc != last_rc) || memcmp(before, ref, sizeof(ref)))) {
+        fail("update was not due", weekday, now_time, rc);
+    }
+    last_rc = rc;
+    return rc;
+}
+
+static void clear_alarms(void)
+{
+    memset(ref, 0, sizeof(ref));
+    ref[0].weekdays = ALARM_EVERY_DAY;
+    ref_save();
+    alarm_init();
+}
+
+// Job: one step from every state, alarm time and current time, after a power failure.
+// The job index is the alarm time. Alarm 0 uses alarm_update, which ignores weekdays.
+static void alarm_step_job(unsigned alarm_time)
+{
+    unsigned state, now_time;
+
+    for (state = 0; state < NUM_STATES; state++) {
+        for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+            unsigned expect, rc;
+
+            memset(ref, 0, sizeof(ref));
+            ref[0].time = alarm_time;
+            ref[0].state = state;
+            ref[0].weekdays = ALARM_EVERY_DAY;
+            ref_save();
+            alarm_init();
+            expect = ref_update(ALARM_NO_WEEKDAY, now_time);
+            rc = alarm_update(now_time / 60, now_time % 60);
+            if (rc != expect) {
+                fail("alarm_update result is incorrect", state, now_time, rc);
+            }
+            ref_compare("state after alarm_update is incorrect", state, now_time);
+        }
+    }
+}
+
+// Job: as alarm_step_job, for a scheduled alarm. The weekday mask and the
+// weekdays are chosen so that every combination of today and yesterday is included.
+static void schedule_step_job(unsigned alarm_time)
+{
+    static const uint8_t weekdays[] = {0, 1, 2, 4};
+    unsigned state, now_time, i;
+
+    for (state = 0; state < NUM_STATES; state++) {
+        for (i = 0; i < sizeof(weekdays); i++) {
+            uint8_t weekday = weekdays[i];
+            for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+                memset(ref, 0, sizeof(ref));
+                ref[2].time = alarm_time;
+                ref[2].state = state;
+                ref[2].weekdays = 0x1a; // Monday, Wednesday, Thursday
+                ref_save();
+                alarm_init();
+                both_update(weekday, now_time);
+            }
+        }
+    }
+}
+
+// Job: any values in the NVRAM at boot. The job index is the state byte.
+static void alarm_corrupt_job(unsigned state)
+{
+    unsigned hi, lo;
+
+    for (hi = 0; hi < 256; hi++) {
+        for (lo = 0; lo < 256; lo++) {
+            uint16_t now_time = ((hi << 8) | lo) % WHOLE_DAY;
+
+            memset(test_nvram, 0xff, sizeof(test_nvram));
+            test_nvram[NVRAM_ALARM_HI] = hi;
+            test_nvram[NVRAM_ALARM_LO] = lo;
+            test_nvram[NVRAM_ALARM_STATE] = state;
+            test_nvram[SCHEDULE_ADDR(1) + 0] = hi;
+            test_nvram[SCHEDULE_ADDR(1) + 1] = state;
+            test_nvram[SCHEDULE_ADDR(1) + 2] = lo;
+            test_nvram[SCHEDULE_ADDR(2) + 0] = lo;
+            test_nvram[SCHEDULE_ADDR(2) + 1] = hi;
+            test_nvram[SCHEDULE_ADDR(2) + 2] = state;
+            ref_init();
+            alarm_init();
+            ref_compare("state after boot is incorrect", (hi << 8) | lo, state);
+            both_update(lo % 7, now_time);
+        }
+    }
+}
+
+// Job: alarm_set at every time relative to the alarm time. The alarm must not sound
+// immediately, even if set during the active region; it must sound for exactly
+// ALARM_SOUNDS_FOR minutes at the next opportunity; then it must be disabled.
+// The job index is the alarm time. Every set time is tested for some alarm times,
+// and the set times near the alarm time are tested for all of them.
+static void alarm_set_job(unsigned alarm_time)
+{
+    int offset, range;
+
+    range = ((alarm_time % 97) == 0) ? (WHOLE_DAY / 2) : (ALARM_SOUNDS_FOR + 2);
+
+    for (offset = -range; offset < range; offset++) {
+        unsigned set_time = (alarm_time + WHOLE_DAY + offset) % WHOLE_DAY;
+        unsigned now, sounding = 0;
+        int start;
+
+        clear_alarms();
+        alarm_set(alarm_time / 60, alarm_time % 60);
+        ref_set(alarm_time);
+
+        // First time the alarm should sound (minutes since 00:00 on the day of alarm_set).
+        // If the alarm time has passed, or the alarm is set during the active region,
+        // then this is tomorrow.
+        start = (int) set_time - offset;
+        if (offset >= 0) {
+            start += WHOLE_DAY;
+        }
+        for (now = set_time; now <= (unsigned) (start + ALARM_SOUNDS_FOR); now++) {
+            unsigned rc = both_update((now / WHOLE_DAY) % 7, now % WHOLE_DAY);
+
+            if (((int) now >= start) && ((int) now < (start + ALARM_SOUNDS_FOR))) {
+                if (rc != (now - start + 1)) {
+                    fail("alarm should be sounding", set_time, now, rc);
+                }
+                sounding++;
+            } else if (rc) {
+                fail("alarm should not be sounding", set_time, now, rc);
+            }
+        }
+        if ((sounding != ALARM_SOUNDS_FOR) || (test_nvram[NVRAM_ALARM_STATE] != DISABLED)) {
+            fail("alarm did not sound once", set_time, sounding, test_nvram[NVRAM_ALARM_STATE]);
+        }
+    }
+}
+
+// Job: scheduled alarm with each weekday mask, running for two weeks
+// (and a few minutes more, if the final alarm is still sounding).
+// The job index is the weekday mask.
+static void schedule_week_job(unsigned weekdays)
+{
+    static const uint16_t alarm_times[] = {0, 1, 9, 10, 600, 1430, 1431, 1439};
+    unsigned i, now;
+
+    for (i = 0; i < (sizeof(alarm_times) / sizeof(alarm_times[0])); i++) {
+        unsigned alarm_time = alarm_times[i];
+        unsigned sounding[7] = {0};
+
+        clear_alarms();
+        alarm_schedule_set(1, alarm_time / 60, alarm_time % 60, weekdays);
+        ref_schedule_set(1, alarm_time / 60, alarm_time % 60, weekdays);
+        for (now = 0; now < ((2 * WHOLE_WEEK) + ALARM_SOUNDS_FOR); now++) {
+            unsigned rc = both_update((now / WHOLE_DAY) % 7, now % WHOLE_DAY);
+            unsigned start = now + 1 - rc;
+
+            if (rc && (start < (2 * WHOLE_WEEK))) {
+                sounding[(start % WHOLE_WEEK) / WHOLE_DAY]++;
+            }
+        }
+        for (now = 0; now < 7; now++) {
+            unsigned expect = (weekdays & (1 << now)) ? (2 * ALARM_SOUNDS_FOR) : 0;
+            if ((now == 0) && (alarm_time == 0) && expect) {
+                expect -= ALARM_SOUNDS_FOR; // set at Sunday 00:00, so does not sound then
+            }
+            if (sounding[now] != expect) {
+                fail("scheduled alarm sounded for the wrong time", alarm_time, now, sounding[now]);
+            }
+        }
+    }
+}
+
+// Job: random sequences of messages, button presses, power failures and clock changes.
+// The job index is the random seed.
+static void alarm_random_job(unsigned seed)
+{
+    uint32_t x = seed + 1;
+    unsigned step, now = 0;
+
+    clear_alarms();
+    for (step = 0; step < 200000; step++) {
+        unsigned r;
+
+        x = (x * 1103515245) + 12345;
+        r = (x >> 8) & 0xffff;
+        switch (r % 64) {
+            case 0:
+                r >>= 6;
+                alarm_set((r % WHOLE_DAY) / 60, r % 60);
+                ref_set(r % WHOLE_DAY);
+                break;
+            case 1:
+                alarm_unset();
+                ref_unset();
+                break;
+            case 2:
+                alarm_reset();
+                ref_set(ref[0].time);
+                break;
+            case 3:
+                r >>= 6;
+                alarm_schedule_set(r % 4, (r * 7) % 25, r % 61, r >> 2);
+                ref_schedule_set(r % 4, (r * 7) % 25, r % 61, r >> 2);
+                break;
+            case 4:
+                // power failure
+                now += r;
+                alarm_init();
+                break;
+            case 5:
+                // clock is set
+                now += r;
+                break;
+            default:
+                now++;
+                break;
+        }
+        ref_compare("state after event is incorrect", step, seed);
+        both_update((now / WHOLE_DAY) % 7, now % WHOLE_DAY);
+    }
+}
+
+// Reference model for night and day times: the original implementation
+static int ref_night(uint16_t start_night_time, uint16_t start_day_time, uint16_t now_time)
+{
+    if (start_day_time == start_night_time) {
+        return 1;
+    } else if (start_day_time < start_night_time) {
+        return (now_time < start_day_time) || (now_time >= start_night_time);
+    } else {
+        return (now_time >= start_night_time) && (now_time < start_day_time);
+    }
+}
+
+// Job: every pair of night and day times, on every minute of a day.
+// The job index is the night time. The weekday changes so that the cache
+// is also tested across midnight.
+static void night_day_job(unsigned night)
+{
+    unsigned day, now_time;
+
+    night_day_time_init();
+    for (day = 0; day < WHOLE_DAY; day++) {
+        uint8_t weekday = (night + day) % 7;
+
+        night_day_time_set(night / 60, night % 60, day / 60, day % 60, 0);
+        for (now_time = 0; now_time < WHOLE_DAY; now_time++) {
+            if (night_day_time_test(weekday, now_time / 60, now_time % 60)
+                    != ref_night(night, day, now_time)) {
+                fail("night_day_time_test result is incorrect", day, weekday, now_time);
+            }
+        }
+    }
+}
+
+// Job: alternative times on some weekdays, for some default times, on every
+// minute of the week. The job index is the alternative night time.
+static void night_day_week_job(unsigned alt_night)
+{
+    unsigned alt_day, now;
+    unsigned night = (alt_night * 7) % WHOLE_DAY;
+    unsigned day = (alt_night * 13) % WHOLE_DAY;
+
+    night_day_time_init();
+    night_day_time_set(night / 60, night % 60, day / 60, day % 60, 0);
+    for (alt_day = alt_night % 97; alt_day < WHOLE_DAY; alt_day += 97) {
+        uint8_t weekdays = 1 + ((alt_night + alt_day) % 126);
+
+        night_day_time_set(alt_night / 60, alt_night % 60, alt_day / 60, alt_day % 60, weekdays);
+        if (alt_day & 1) {
+            night_day_time_init(); // reload from NVRAM
+        }
+        for (now = 0; now < WHOLE_WEEK; now++) {
+            uint8_t weekday = now / WHOLE_DAY;
+            uint16_t now_time = now % WHOLE_DAY;
+            int expect = (weekdays & (1 << weekday))
+                ? ref_night(alt_night, alt_day, now_time)
+                : ref_night(night, day, now_time);
+
+            if (night_day_time_test(weekday, now_time / 60, now_time % 60) != expect) {
+                fail("night_day_time_test result is incorrect on weekday", alt_day, weekday, now_time);
+            }
+        }
+    }
+}
+
+// Run a job for each index from 0 to count - 1, shared between the workers
+static void run_jobs(const char* name, void (* job) (unsigned), unsigned count, unsigned workers)
+{
+    unsigned worker, failed = 0;
+
+    printf("%s: %u jobs\n", name, count);
+    fflush(stdout);
+    for (worker = 0; worker < workers; worker++) {
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            job_name = name;
+            memset(test_nvram, 0, sizeof(test_nvram));
+            for (job_index = worker; job_index < count; job_index += workers) {
+                job(job_index);
+            }
+            exit(0);
+        }
+    }
+    for (worker = 0; worker < workers; worker++) {
+        int status = 0;
+
+        if ((wait(&status) < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+            failed = 1;
+        }
+    }
+    if (failed) {
+        fprintf(stderr, "error: %s failed\n", name);
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    long workers = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (argc > 1) {
+        workers = atoi(argv[1]);
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    run_jobs("alarm step", alarm_step_job, WHOLE_DAY, workers);
+    run_jobs("schedule step", schedule_step_job, WHOLE_DAY, workers);
+    run_jobs("alarm corrupt", alarm_corrupt_job, 256, workers);
+    run_jobs("alarm set", alarm_set_job, WHOLE_DAY, workers);
+    run_jobs("schedule week", schedule_week_job, ALARM_EVERY_DAY + 1, workers);
+    run_jobs("alarm random", alarm_random_job, 64, workers);
+    run_jobs("night day", night_day_job, WHOLE_DAY, workers);
+    run_jobs("night day week", night_day_week_job, WHOLE_DAY, workers);
+    printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,519 @@
+
+// Worst case execution time search for rx433_interrupt.
+//
+// rx433.c is compiled separately with -fsanitize-coverage=trace-pc,trace-cmp,
+// so that the functions below are called at the start of each basic block and
+// at each comparison, and with memcpy/memset renamed so that the bytes copied
+// can be counted. Its variables are all placed in the section "rx433_state",
+// so that the decoder state can be saved and restored.
+//
+// The search is coverage-guided fuzzing with a cost objective. Each corpus
+// entry is a decoder state, reached from the reset state by a sequence of edges.
+// A few more edges are added to a random entry, and the state after each call is
+// kept if the call found new coverage (a new transition between basic blocks,
+// a new hit count, or a new distance between the operands of a comparison, as
+// in libFuzzer's value profile) or if it was the most expensive call so far.
+//
+// The cost of a call is converted to an estimate of SAMD21 cycles, which is
+// checked against WCET_BOUND_CYCLES. The estimate uses the basic blocks of the
+// host build (-O0, so that they follow the source) and the averages below; it
+// is meant to catch changes which make the interrupt slower, not to be exact.
+//
+// Usage: test_wcet_rx433.exe [iterations [seed]]
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rx433.h"
+
+// SAMD21 cost model
+#define CPU_MHZ             48
+#define ENTRY_CYCLES        100     // exception entry and exit, and dispatch by the EIC handler
+#define MICROS_CYCLES       50      // micros()
+#define BLOCK_CYCLES        7       // average for a basic block (Cortex-M0+, -Os)
+#define BYTE_CYCLES         8       // memcpy/memset are byte loops in newlib-nano
+
+// Fails if a change raises the worst case above this (the worst case found is
+// 492 cycles; the margin is a few basic blocks)
+#define WCET_BOUND_CYCLES   520
+
+#define MAX_STATE           256
+#define MAX_STEPS           8       // edges added to a corpus entry at once
+#define MAX_EDGES           4096    // edges from the reset state to the worst case
+#define MAX_CORPUS          8192
+#define MAX_PATH            1024
+#define MAP_SIZE            65536
+#define DEFAULT_ITERATIONS  1000000
+#define DEFAULT_SEED        1
+
+typedef struct entry_s {
+    uint8_t     state[MAX_STATE];
+    uint32_t    time;               // micros() when the state was saved
+    int32_t     parent;             // -1 for the reset state
+    uint16_t    size;               // edges after the parent's state
+    uint32_t    delta[MAX_STEPS];   // microseconds since the previous rising edge
+} entry_t;
+
+typedef struct cost_s {
+    uint32_t    blocks;
+    uint32_t    bytes;
+    uint32_t    cycles;
+} cost_t;
+
+extern uint8_t __start_rx433_state[];
+extern uint8_t __stop_rx433_state[];
+
+static uint32_t test_time = 0;
+
+// Coverage and cost of the call in progress
+static int counting = 0;
+static uint32_t call_blocks = 0;
+static uint32_t call_bytes = 0;
+static uintptr_t previous_pc = 0;
+static uint32_t previous_compare = 0;
+static uint8_t trace_map[MAP_SIZE];
+static uint8_t virgin_map[MAP_SIZE];
+static uint32_t touched[MAP_SIZE];  // non-zero entries in trace_map
+static uint32_t touched_size = 0;
+
+// Path of the call being recorded
+static int recording = 0;
+static uintptr_t path[MAX_PATH];
+static uint32_t path_size = 0;
+
+static entry_t corpus[MAX_CORPUS];
+static uint32_t corpus_size = 0;
+static uint32_t random_state = DEFAULT_SEED;
+
+uint32_t micros()
+{
+    return test_time;
+}
+
+static void trace(uint32_t index)
+{
+    if (!trace_map[index]) {
+        touched[touched_size++] = index;
+    }
+    if (trace_map[index] != 0xff) {
+        trace_map[index]++;
+    }
+}
+
+void __sanitizer_cov_trace_pc(void)
+{
+    uintptr_t pc = (uintptr_t) __builtin_return_address(0);
+    uint32_t index;
+
+    if (!counting) {
+        return;
+    }
+    call_blocks++;
+    index = (uint32_t) (((pc ^ (previous_pc >> 1)) * 2654435761u) >> 16) % MAP_SIZE;
+    trace(index);
+    previous_pc = pc;
+    if (recording && (path_size < MAX_PATH)) {
+        path[path_size++] = pc;
+    }
+}
+
+// Small distances are exact, large ones are rounded to a power of two. The
+// previous comparison in the same call is included, so that (for example) the
+// timing of a start code is new coverage if it happens near the end of a message.
+static void trace_compare(uintptr_t pc, uint64_t a, uint64_t b)
+{
+    uint64_t distance = (a > b) ? (a - b) : (b - a);
+    uint32_t feature = (uint32_t) distance;
+
+    if (!counting) {
+        return;
+    }
+    if (distance >= 32) {
+        feature = 32;
+        while (distance) {
+            feature++;
+            distance >>= 1;
+        }
+    }
+    feature = (uint32_t) ((((pc * 97) + feature) * 2654435761u) >> 16);
+    trace((feature ^ (previous_compare >> 1)) % MAP_SIZE);
+    previous_compare = feature;
+}
+
+#define TRACE_COMPARE(name, type) \
+    void __sanitizer_cov_trace_##name(type a, type b) \
+    { \
+        trace_compare((uintptr_t) __builtin_return_address(0), a, b); \
+    }
+TRACE_COMPARE(cmp1, uint8_t)
+TRACE_COMPARE(cmp2, uint16_t)
+TRACE_COMPARE(cmp4, uint32_t)
+TRACE_COMPARE(cmp8, uint64_t)
+TRACE_COMPARE(const_cmp1, uint8_t)
+TRACE_COMPARE(const_cmp2, uint16_t)
+TRACE_COMPARE(const_cmp4, uint32_t)
+TRACE_COMPARE(const_cmp8, uint64_t)
+
+void __sanitizer_cov_trace_switch(uint64_t value, uint64_t* cases)
+{
+    uintptr_t pc = (uintptr_t) __builtin_return_address(0);
+    uint64_t i;
+
+    // cases[0] is the number of cases, cases[1] is the size in bits
+    for (i = 0; i < cases[0]; i++) {
+        trace_compare(pc + i, value, cases[i + 2]);
+    }
+}
+
+void* wcet_memcpy(void* dest, const void* src, size_t size)
+{
+    call_bytes += size;
+    return memcpy(dest, src, size);
+}
+
+void* wcet_memset(void* dest, int value, size_t size)
+{
+    call_bytes += size;
+    return memset(dest, value, size);
+}
+
+static uint32_t next_random(void)
+{
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+static uint32_t estimate_cycles(uint32_t blocks, uint32_t bytes)
+{
+    return ENTRY_CYCLES + MICROS_CYCLES + (blocks * BLOCK_CYCLES) + (bytes * BYTE_CYCLES);
+}
+
+// Reset: the first call abandons any message or Home Easy code which was being
+// received, and after that, the decoder state does not depend on what came before
+static void reset(void)
+{
+    test_time = 0;
+    rx433_interrupt();
+}
+
+// One call, with the coverage added to the trace map
+static void call(uint32_t delta, cost_t* cost)
+{
+    test_time += delta;
+    call_blocks = call_bytes = 0;
+    previous_pc = 0;
+    previous_compare = 0;
+    counting = 1;
+    rx433_interrupt();
+    counting = 0;
+    rx433_new_code_ready = 0;
+    rx433_home_easy = 0;
+
+    cost->blocks = call_blocks;
+    cost->bytes = call_bytes;
+    cost->cycles = estimate_cycles(call_blocks, call_bytes);
+}
+
+// Hit counts are grouped as in AFL, so that loops which run for more
+// iterations count as new coverage
+static uint8_t hit_bucket(uint8_t count)
+{
+    if (count <= 3) {
+        return count;
+    } else if (count <= 7) {
+        return 4;
+    } else if (count <= 15) {
+        return 8;
+    } else if (count <= 31) {
+        return 16;
+    } else if (count <= 127) {
+        return 32;
+    } else {
+        return 128;
+    }
+}
+
+// Also clears the trace map for the next call
+static int has_new_coverage(void)
+{
+    uint32_t i;
+    int found = 0;
+
+    for (i = 0; i < touched_size; i++) {
+        uint32_t index = touched[i];
+        uint8_t bit = hit_bucket(trace_map[index]);
+
+        if (!(virgin_map[index] & bit)) {
+            virgin_map[index] |= bit;
+            found = 1;
+        }
+        trace_map[index] = 0;
+    }
+    touched_size = 0;
+    return found;
+}
+
+static int32_t add_to_corpus(int32_t parent, const uint32_t* delta, uint16_t size)
+{
+    entry_t* e;
+
+    if (corpus_size >= MAX_CORPUS) {
+        return -1;
+    }
+    e = &corpus[corpus_size];
+    memcpy(e->state, __start_rx433_state, __stop_rx433_state - __start_rx433_state);
+    e->time = test_time;
+    e->parent = parent;
+    e->size = size;
+    memcpy(e->delta, delta, size * sizeof(uint32_t));
+    return corpus_size++;
+}
+
+// Timings where the decoder's decisions change
+static uint32_t interesting_delta(void)
+{
+    static const uint32_t values[] = {
+        1, 383, 384, 540, 767, 768, 1407, 1408, 1550, 1663, 1664, 2815, 2816,
+        2920, 3071, 3072, (NC_PULSE * 3) - 95, (NC_PULSE * 3) + 95,
+        NC_PULSE * 2, NC_PULSE * 4, NC_PULSE * 6, NC_PULSE * 8, NC_PULSE * 10,
+        NC_SYMBOL_TIME - (NC_PULSE * 3), NC_SYMBOL_TIME + 95,
+        (NC_SYMBOL_TIME * 3) / 2, NC_SYMBOL_TIME * 2, NC_SYMBOL_TIME * 31,
+        10490, 100000, 0x7fffffff, 0xffffffff,
+    };
+
+    switch (next_random() % 4) {
+        case 0:
+            // a multiple of half a pulse
+            return (NC_PULSE / 2) * (1 + (next_random() % 32));
+        case 1:
+            return next_random() % (NC_SYMBOL_TIME * 4);
+        default:
+            return values[next_random() % (sizeof(values) / sizeof(values[0]))];
+    }
+}
+
+static uint32_t new_delta(uint32_t previous)
+{
+    if (((next_random() % 4) == 0) && (previous > 96) && (previous < 0x10000000)) {
+        // close to the previous edge
+        return previous + (next_random() % 193) - 96;
+    }
+    return interesting_delta();
+}
+
+// All of the edges from the reset state to the end of an entry
+static uint32_t edges_to(int32_t index, uint32_t* delta)
+{
+    uint32_t size;
+
+    if (index < 0) {
+        return 0;
+    }
+    size = edges_to(corpus[index].parent, delta);
+    if ((size + corpus[index].size) > MAX_EDGES) {
+        fprintf(stderr, "error: more than %u edges\n", MAX_EDGES);
+        exit(1);
+    }
+    memcpy(&delta[size], corpus[index].delta, corpus[index].size * sizeof(uint32_t));
+    return size + corpus[index].size;
+}
+
+// Run edges from the reset state, and find the most expensive call
+static uint32_t replay(const uint32_t* delta, uint32_t size, uint32_t* worst_index, cost_t* worst)
+{
+    cost_t cost;
+    uint32_t i;
+
+    memset(worst, 0, sizeof(cost_t));
+    reset();
+    for (i = 0; i < size; i++) {
+        call(delta[i], &cost);
+        if (cost.cycles > worst->cycles) {
+            memcpy(worst, &cost, sizeof(cost_t));
+            *worst_index = i;
+        }
+        has_new_coverage();
+    }
+    return worst->cycles;
+}
+
+// Remove edges which do not contribute to the worst case. When an edge is
+// removed, its time is added to the next edge, so later edges keep their timing.
+static uint32_t minimise(uint32_t* delta, uint32_t size)
+{
+    static uint32_t trial[MAX_EDGES];
+    uint32_t worst_index = 0, trial_index = 0;
+    cost_t worst, cost;
+    int removed = 1;
+    int i;
+
+    replay(delta, size, &worst_index, &worst);
+    size = worst_index + 1;
+    while (removed) {
+        removed = 0;
+        for (i = (int) size - 2; i >= 0; i--) {
+            memcpy(trial, delta, i * sizeof(uint32_t));
+            trial[i] = delta[i] + delta[i + 1];
+            memcpy(&trial[i + 1], &delta[i + 2], (size - i - 2) * sizeof(uint32_t));
+            if (replay(trial, size - 1, &trial_index, &cost) >= worst.cycles) {
+                size = trial_index + 1;
+                memcpy(delta, trial, size * sizeof(uint32_t));
+                removed = 1;
+                if (i > ((int) size - 1)) {
+                    i = size - 1;
+                }
+            }
+        }
+    }
+    return size;
+}
+
+// Source lines of the worst case path, with repeats shown as "(...) x N"
+static void print_path(const char* exe)
+{
+    static uint32_t line[MAX_PATH];
+    char command[256];
+    FILE* fd;
+    uint32_t i, j, period, repeats;
+
+    snprintf(command, sizeof(command), "addr2line -e %s > addr2line.tmp", exe);
+    fd = popen(command, "w");
+    if (!fd) {
+        return;
+    }
+    for (i = 0; i < path_size; i++) {
+        fprintf(fd, "%p\n", (void*) path[i]);
+    }
+    if (pclose(fd) != 0) {
+        return;
+    }
+    fd = fopen("addr2line.tmp", "rt");
+    for (i = 0; fd && (i < path_size); i++) {
+        char text[512];
+        char* colon;
+
+        line[i] = 0;
+        if (fgets(text, sizeof(text), fd) && (colon = strrchr(text, ':'))) {
+            line[i] = strtoul(colon + 1, NULL, 10);
+        }
+    }
+    if (fd) {
+        fclose(fd);
+    }
+    remove("addr2line.tmp");
+
+    printf("path (rx433.c lines):");
+    i = 0;
+    while (i < path_size) {
+        // find the shortest period which repeats at least twice here
+        repeats = 1;
+        for (period = 1; period <= 8; period++) {
+            repeats = 1;
+            while (((i + ((repeats + 1) * period)) <= path_size)
+            && (memcmp(&line[i], &line[i + (repeats * period)], period * sizeof(uint32_t)) == 0)) {
+                repeats++;
+            }
+            if (repeats > 1) {
+                break;
+            }
+        }
+        if (repeats > 1) {
+            printf(" (");
+            for (j = 0; j < period; j++) {
+                printf((j == 0) ? "%u" : " %u", line[i + j]);
+            }
+            printf(") x %u", repeats);
+            i += period * repeats;
+        } else {
+            printf(" %u", line[i]);
+            i++;
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+    static uint32_t edges[MAX_EDGES];
+    uint32_t iterations = DEFAULT_ITERATIONS;
+    uint32_t i, j, size, worst_index = 0;
+    uint32_t step[MAX_STEPS];
+    int32_t worst_entry = 0;
+    cost_t cost, worst;
+
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        random_state = strtoul(argv[2], NULL, 0) | 1;
+    }
+    if ((__stop_rx433_state - __start_rx433_state) > MAX_STATE) {
+        fprintf(stderr, "error: the decoder state is larger than %u bytes\n", MAX_STATE);
+        return 1;
+    }
+
+    memset(&worst, 0, sizeof(worst));
+    memset(virgin_map, 0, sizeof(virgin_map));
+    reset();
+    add_to_corpus(-1, NULL, 0);
+
+    for (i = 0; i < iterations; i++) {
+        int32_t parent = next_random() % corpus_size;
+        int32_t other = next_random() % corpus_size;
+        uint16_t steps = 1 + (next_random() % MAX_STEPS);
+        const entry_t* p;
+        uint32_t previous;
+
+        // Newer entries are preferred, as they tend to be further into a message
+        parent = (other > parent) ? other : parent;
+        p = &corpus[parent];
+        previous = p->size ? p->delta[p->size - 1] : 0;
+        memcpy(__start_rx433_state, p->state, __stop_rx433_state - __start_rx433_state);
+        test_time = p->time;
+        for (j = 0; j < steps; j++) {
+            step[j] = previous = new_delta(previous);
+            call(step[j], &cost);
+            if (has_new_coverage() || (cost.cycles > worst.cycles)) {
+                int32_t index = add_to_corpus(parent, step, j + 1);
+                if ((cost.cycles > worst.cycles) && (index >= 0)) {
+                    memcpy(&worst, &cost, sizeof(cost_t));
+                    worst_entry = index;
+                }
+            }
+        }
+    }
+
+    // Replay the worst case from the reset state, recording the path of the final call
+    size = minimise(edges, edges_to(worst_entry, edges));
+    replay(edges, size, &worst_index, &cost);
+    path_size = 0;
+    reset();
+    for (j = 0; j < size; j++) {
+        recording = (j == (size - 1));
+        call(edges[j], &cost);
+        recording = 0;
+    }
+
+    printf("rx433_interrupt worst case after %u inputs (corpus %u):\n", iterations, corpus_size);
+    printf("%u basic blocks, %u bytes copied or cleared, about %u cycles (%.1f us)\n",
+           cost.blocks, cost.bytes, cost.cycles, (double) cost.cycles / CPU_MHZ);
+    printf("edges (microseconds between rising edges):");
+    for (j = 0; j < size; j++) {
+        printf(" %u", edges[j]);
+    }
+    printf("\n");
+    print_path(argv[0]);
+
+    if (cost.cycles > WCET_BOUND_CYCLES) {
+        fprintf(stderr, "error: the worst case (%u cycles) is above the bound (%u cycles)\n",
+                cost.cycles, WCET_BOUND_CYCLES);
+        return 1;
+    }
+    printf("ok: bound %u cycles\n", WCET_BOUND_CYCLES);
+    return 0;
+}
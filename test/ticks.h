@@ -0,0 +1,29 @@
+#ifndef TICKS_H
+#define TICKS_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Timing for the host benchmarks: TSC reference cycles on x86, otherwise
+// nanoseconds
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TICK_UNIT   "cycles"
+
+static inline uint64_t ticks(void)
+{
+    return __rdtsc();
+}
+#else
+#define TICK_UNIT   "ns"
+
+static inline uint64_t ticks(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+#endif
+
+#endif
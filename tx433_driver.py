@@ -1,23 +1,67 @@
 
 import pigpio
 import time
+import typing
+import ctypes
+from pathlib import Path
 
 SYMBOL_SIZE   = 5      # 5 bits per symbol
 
 NC_DATA_SIZE  = 31     # New codes: 31 base-32 symbols
 NC_PULSE      = 0x100  # Timing for new code
 
+# Optional: pulse tables are made by txnc433/libnc.so (make libnc.so)
+LIBNC_PATH    = Path(__file__).parent / "txnc433" / "libnc.so"
+LIBNC_NC_MAX_PULSES = NC_DATA_SIZE * 7 + 1
+
+# Version 2 new codes: weight of each data slot (see README.md)
+NC2_SLOTS     = 10
+NC2_WEIGHT    = [0, 0, 21, 13, 8, 5, 3, 2, 1]
+
+class LibNC_Pulse(ctypes.Structure):
+    _fields_ = [("high_us", ctypes.c_uint32), ("low_us", ctypes.c_uint32)]
+
+class LibNC_GPIO_Pulse(ctypes.Structure):
+    _fields_ = [("gpio_on", ctypes.c_uint32), ("gpio_off", ctypes.c_uint32),
+                ("delay_us", ctypes.c_uint32)]
+
+class LibNC_Timing(ctypes.Structure):
+    _fields_ = [("high_adjust_us", ctypes.c_int32), ("clock_ppm", ctypes.c_int32)]
+
+def load_libnc() -> typing.Optional[ctypes.CDLL]:
+    try:
+        lib = ctypes.CDLL(str(LIBNC_PATH))
+    except OSError:
+        return None
+    lib.libnc_nc_pulses.restype = ctypes.c_size_t
+    lib.libnc_nc_pulses.argtypes = [ctypes.c_char_p, ctypes.POINTER(LibNC_Timing),
+                                    ctypes.POINTER(LibNC_Pulse), ctypes.c_size_t]
+    lib.libnc_nc2_pulses.restype = ctypes.c_size_t
+    lib.libnc_nc2_pulses.argtypes = lib.libnc_nc_pulses.argtypes
+    lib.libnc_he_pulses_cached.restype = ctypes.POINTER(LibNC_Pulse)
+    lib.libnc_he_pulses_cached.argtypes = [ctypes.c_uint32, ctypes.c_uint,
+                                    ctypes.POINTER(LibNC_Timing), ctypes.POINTER(ctypes.c_size_t)]
+    lib.libnc_gpio_pulses.restype = ctypes.c_size_t
+    lib.libnc_gpio_pulses.argtypes = [ctypes.POINTER(LibNC_Pulse), ctypes.c_size_t,
+                                    ctypes.c_uint32, ctypes.POINTER(LibNC_GPIO_Pulse)]
+    return lib
+
 class TX433_Driver:
-    def __init__(self, pi: pigpio.pi, gpio_pin: int) -> None:
+    def __init__(self, pi: pigpio.pi, gpio_pin: int,
+                 high_adjust_us: int = 0, clock_ppm: int = 0) -> None:
+        """The timing calibration (see libnc.h) is only applied if libnc.so is available."""
         self.__pi = pi
         self.__gpio_pin = gpio_pin
         self.__mask = 1 << gpio_pin
+        self.__libnc = load_libnc()
+        self.__timing = LibNC_Timing(high_adjust_us, clock_ppm)
 
         self.__pi.set_mode(self.__gpio_pin, pigpio.OUTPUT)
         self.__pi.write(self.__gpio_pin, 0)
         self.__pi.wave_clear()
 
         self.__pulses: typing.List[pigpio.pulse] = []
+        self.__wave = b""
 
     def __send_high_var(self, high_us: int, low_us: int) -> None:
         self.__pulses.append(pigpio.pulse(self.__mask, 0, high_us))
@@ -35,12 +79,25 @@ class TX433_Driver:
     def __send_one(self) -> None:
         self.__send_high(320)
 
+    def __send_table(self, table: typing.Any, count: int) -> None:
+        # libnc writes the pulses in the format sent by wave_add_generic
+        gpio_pulses = (LibNC_GPIO_Pulse * (count * 2))()
+        n = self.__libnc.libnc_gpio_pulses(table, count, self.__mask, gpio_pulses)
+        self.__wave = ctypes.string_at(gpio_pulses, n * ctypes.sizeof(LibNC_GPIO_Pulse))
+
     def __start(self) -> None:
         self.__pi.wave_clear()
         self.__pulses.clear()
+        self.__wave = b""
 
     def __finish(self) -> None:
-        self.__pi.wave_add_generic(self.__pulses)
+        if self.__wave:
+            # same command as wave_add_generic, without making a pigpio.pulse per pulse
+            pigpio._pigpio_command_ext(self.__pi.sl, pigpio._PI_CMD_WVAG, 0, 0,
+                                       len(self.__wave), [self.__wave])
+            self.__wave = b""
+        else:
+            self.__pi.wave_add_generic(self.__pulses)
         self.__pulses.clear()
         wave_id = self.__pi.wave_create()
         try:
@@ -54,6 +111,16 @@ class TX433_Driver:
     def write_he(self, tx_code: int, attempts: int = 10) -> None:
         """Send Home Easy code."""
         self.__start()
+        if self.__libnc:
+            count = ctypes.c_size_t(0)
+            table = self.__libnc.libnc_he_pulses_cached(tx_code, attempts,
+                                    ctypes.byref(self.__timing), ctypes.byref(count))
+            if not table:
+                raise ValueError("unable to make a Home Easy pulse table")
+            self.__send_table(table, count.value)
+            self.__finish()
+            return
+
         for i in range(attempts):
             self.__send_high(2700) # Start code
             j = 32
@@ -70,9 +137,45 @@ class TX433_Driver:
 
         self.__finish()
 
-    def write_nc(self, message: bytes) -> None:
-        """Send new (long) code."""
+    def write_nc(self, message: bytes, version: int = 1) -> None:
+        """Send new (long) code, using version 1 or version 2 line coding."""
+        if version not in (1, 2):
+            raise ValueError("unknown new code version {}".format(version))
         self.__start()
+        if self.__libnc:
+            table = (LibNC_Pulse * LIBNC_NC_MAX_PULSES)()
+            make_pulses = (self.__libnc.libnc_nc_pulses if version == 1
+                            else self.__libnc.libnc_nc2_pulses)
+            count = make_pulses(bytes(message[:NC_DATA_SIZE]),
+                                    ctypes.byref(self.__timing), table, LIBNC_NC_MAX_PULSES)
+            if not count:
+                raise ValueError("unable to make a new code pulse table")
+            self.__send_table(table, count)
+            self.__finish()
+            return
+
+        if version == 2:
+            # sync word: rising edges 13 and 5 pulses apart
+            self.__send_high_var(NC_PULSE, NC_PULSE * 12)
+            self.__send_high_var(NC_PULSE, NC_PULSE * 4)
+            for i in range(NC_DATA_SIZE):
+                value = message[i] & ((1 << SYMBOL_SIZE) - 1)
+                # slot 0 is the timebase for the symbol, slot 1 is always empty
+                self.__send_high_var(NC_PULSE, NC_PULSE)
+                slot = 2
+                while slot < NC2_SLOTS:
+                    if slot < len(NC2_WEIGHT) and value >= NC2_WEIGHT[slot]:
+                        value -= NC2_WEIGHT[slot]
+                        self.__send_high_var(NC_PULSE, NC_PULSE)
+                        slot += 2
+                    else:
+                        self.__await(NC_PULSE)
+                        slot += 1
+            # slot 0 of the symbol after the last one
+            self.__send_high_var(NC_PULSE, NC_PULSE)
+            self.__finish()
+            return
+
         for i in range(NC_DATA_SIZE):
             symbol = message[i]
             # start symbol: 11010
@@ -19,6 +19,36 @@ typedef struct secret_file_s {
     uint8_t     secret_data[56];
 } secret_file_t;
 
+// Transmitter timing for Home Easy codes, as in tx433_driver.py (microseconds);
+// new codes are timed as in rx433.h
+#define HE_HIGH         220
+#define HE_ZERO         1330
+#define HE_ONE          320
+#define HE_START        2700
+#define HE_GAP          10270
+
+typedef struct pulse_table_s {
+    libnc_pulse_t*  pulses;
+    size_t          count;
+    size_t          max_pulses;
+    int             overflow;
+} pulse_table_t;
+
+typedef struct he_cache_s {
+    int             in_use;
+    uint32_t        code;
+    unsigned        attempts;
+    libnc_timing_t  timing;
+    size_t          count;
+    libnc_pulse_t   pulses[LIBNC_HE_MAX_ATTEMPTS * LIBNC_HE_PULSES];
+} he_cache_t;
+
+// Version 2 new codes: weight of each data slot, as in rx433.c
+static const uint8_t nc2_weight[NC2_LAST_DATA_SLOT + 1] = {0, 0, 21, 13, 8, 5, 3, 2, 1};
+
+static he_cache_t he_cache[LIBNC_HE_CACHE_SIZE];
+static unsigned he_cache_next = 0;
+
 static FILE* secret_fd = NULL;
 static secret_file_t secret_file;
 static const char* secret_file_name = ".hmac433.dat";
@@ -154,3 +184,208 @@ int libnc_encode(const uint8_t* payload, size_t payload_size,
     }
     return 1;
  }
+
+static void send_high(pulse_table_t* table, uint32_t high_us, uint32_t low_us)
+{
+    if (table->count >= table->max_pulses) {
+        table->overflow = 1;
+        return;
+    }
+    table->pulses[table->count].high_us = high_us;
+    table->pulses[table->count].low_us = low_us;
+    table->count++;
+}
+
+static void send_low(pulse_table_t* table, uint32_t low_us)
+{
+    if (table->count == 0) {
+        send_high(table, 0, low_us);
+    } else {
+        table->pulses[table->count - 1].low_us += low_us;
+    }
+}
+
+static size_t finish_table(pulse_table_t* table, const libnc_timing_t* timing)
+{
+    size_t i;
+
+    if (table->overflow) {
+        fprintf(stderr, "pulse table needs more than %d entries\n", (int) table->max_pulses);
+        return 0;
+    }
+    if (!timing) {
+        return table->count;
+    }
+    for (i = 0; i < table->count; i++) {
+        libnc_pulse_t* p = &table->pulses[i];
+        int64_t high = p->high_us;
+        int64_t low = p->low_us;
+
+        high += (high * timing->clock_ppm) / 1000000;
+        low += (low * timing->clock_ppm) / 1000000;
+        if (high) {
+            high += timing->high_adjust_us;
+            low -= timing->high_adjust_us;
+        }
+        if ((high < 0) || (low <= 0) || (high > UINT32_MAX) || (low > UINT32_MAX)
+        || ((high == 0) && (p->high_us != 0))) {
+            fprintf(stderr, "timing calibration gives an invalid pulse\n");
+            return 0;
+        }
+        p->high_us = (uint32_t) high;
+        p->low_us = (uint32_t) low;
+    }
+    return table->count;
+}
+
+size_t libnc_nc_pulses(const uint8_t* message, const libnc_timing_t* timing,
+                       libnc_pulse_t* pulses, size_t max_pulses)
+{
+    pulse_table_t table = {pulses, 0, max_pulses, 0};
+    unsigned i, j;
+
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        // start symbol: 11010
+        send_high(&table, NC_PULSE * 2, NC_PULSE);
+        send_high(&table, NC_PULSE, NC_PULSE);
+        // send symbol: 10 for each 1 bit, 00 for each 0 bit
+        for (j = 0; j < SYMBOL_SIZE; j++) {
+            if (message[i] & (1 << (SYMBOL_SIZE - 1 - j))) {
+                send_high(&table, NC_PULSE, NC_PULSE);
+            } else {
+                send_low(&table, NC_PULSE * 2);
+            }
+        }
+    }
+    // end of final symbol: 10
+    send_high(&table, NC_PULSE, NC_PULSE);
+    return finish_table(&table, timing);
+}
+
+size_t libnc_nc2_pulses(const uint8_t* message, const libnc_timing_t* timing,
+                        libnc_pulse_t* pulses, size_t max_pulses)
+{
+    pulse_table_t table = {pulses, 0, max_pulses, 0};
+    unsigned i, slot;
+
+    // sync word: rising edges 13 and 5 pulses apart
+    send_high(&table, NC_PULSE, NC_PULSE * 12);
+    send_high(&table, NC_PULSE, NC_PULSE * 4);
+    for (i = 0; i < NC_DATA_SIZE; i++) {
+        uint8_t value = message[i] & ((1 << SYMBOL_SIZE) - 1);
+
+        // slot 0 is the timebase for the symbol, slot 1 is always empty
+        send_high(&table, NC_PULSE, NC_PULSE);
+        slot = NC2_FIRST_DATA_SLOT;
+        while (slot < NC2_SLOTS) {
+            if ((slot <= NC2_LAST_DATA_SLOT) && (value >= nc2_weight[slot])) {
+                // greedy choice of the largest weight never uses two adjacent slots
+                value -= nc2_weight[slot];
+                send_high(&table, NC_PULSE, NC_PULSE);
+                slot += 2;
+            } else {
+                send_low(&table, NC_PULSE);
+                slot++;
+            }
+        }
+    }
+    // slot 0 of the symbol after the last one
+    send_high(&table, NC_PULSE, NC_PULSE);
+    return finish_table(&table, timing);
+}
+
+size_t libnc_he_pulses(uint32_t code, unsigned attempts, const libnc_timing_t* timing,
+                       libnc_pulse_t* pulses, size_t max_pulses)
+{
+    pulse_table_t table = {pulses, 0, max_pulses, 0};
+    unsigned i, j;
+
+    for (i = 0; i < attempts; i++) {
+        send_high(&table, HE_HIGH, HE_START);
+        for (j = 32; j > 0; j--) {
+            if ((code >> (j - 1)) & 1) {
+                send_high(&table, HE_HIGH, HE_ZERO);
+                send_high(&table, HE_HIGH, HE_ONE);
+            } else {
+                send_high(&table, HE_HIGH, HE_ONE);
+                send_high(&table, HE_HIGH, HE_ZERO);
+            }
+        }
+        send_high(&table, HE_HIGH, HE_GAP); // end code and gap
+    }
+    return finish_table(&table, timing);
+}
+
+size_t libnc_gpio_pulses(const libnc_pulse_t* pulses, size_t count, uint32_t gpio_mask,
+                         libnc_gpio_pulse_t* gpio_pulses)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < count; i++) {
+        if (pulses[i].high_us) {
+            gpio_pulses[n].gpio_on = gpio_mask;
+            gpio_pulses[n].gpio_off = 0;
+            gpio_pulses[n].delay_us = pulses[i].high_us;
+            n++;
+            gpio_pulses[n].gpio_on = 0;
+            gpio_pulses[n].gpio_off = gpio_mask;
+        } else {
+            gpio_pulses[n].gpio_on = 0;
+            gpio_pulses[n].gpio_off = 0;
+        }
+        gpio_pulses[n].delay_us = pulses[i].low_us;
+        n++;
+    }
+    return n;
+}
+
+size_t libnc_edges(const libnc_pulse_t* pulses, size_t count, uint32_t* times)
+{
+    uint32_t time = 0;
+    size_t i, n = 0;
+
+    for (i = 0; i < count; i++) {
+        if (pulses[i].high_us) {
+            times[n++] = time;
+        }
+        time += pulses[i].high_us + pulses[i].low_us;
+    }
+    return n;
+}
+
+const libnc_pulse_t* libnc_he_pulses_cached(uint32_t code, unsigned attempts,
+                       const libnc_timing_t* timing, size_t* count)
+{
+    libnc_timing_t key;
+    he_cache_t* c;
+    unsigned i;
+
+    memset(&key, 0, sizeof(key));
+    if (timing) {
+        key = *timing;
+    }
+    for (i = 0; i < LIBNC_HE_CACHE_SIZE; i++) {
+        c = &he_cache[i];
+        if (c->in_use && (c->code == code) && (c->attempts == attempts)
+        && (memcmp(&c->timing, &key, sizeof(key)) == 0)) {
+            *count = c->count;
+            return c->pulses;
+        }
+    }
+
+    // Not cached: replace the oldest table
+    c = &he_cache[he_cache_next];
+    he_cache_next = (he_cache_next + 1) % LIBNC_HE_CACHE_SIZE;
+    c->in_use = 0;
+    c->count = libnc_he_pulses(code, attempts, &key, c->pulses,
+                               LIBNC_HE_MAX_ATTEMPTS * LIBNC_HE_PULSES);
+    if (!c->count) {
+        return NULL;
+    }
+    c->in_use = 1;
+    c->code = code;
+    c->attempts = attempts;
+    c->timing = key;
+    *count = c->count;
+    return c->pulses;
+}
@@ -2,6 +2,9 @@
 #define LIBNC_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "rx433.h"
 
 
 #ifdef __cplusplus
@@ -15,7 +18,66 @@ int libnc_encode(const uint8_t* payload, size_t payload_size,
                  uint8_t* message, size_t max_message_size);
 int libnc_advance(void);
 
+// Pulse tables for the transmitter. Each entry is one high pulse followed by a
+// low period; consecutive low periods are merged into one entry.
+typedef struct libnc_pulse_s {
+    uint32_t    high_us;
+    uint32_t    low_us;
+} libnc_pulse_t;
+
+// Timing calibration for a transmitter: high_adjust_us is added to each high
+// pulse and taken from the following low period (e.g. to compensate for a
+// slow transmitter), and all times are scaled by (1 + clock_ppm / 1e6).
+typedef struct libnc_timing_s {
+    int32_t     high_adjust_us;
+    int32_t     clock_ppm;
+} libnc_timing_t;
+
+#define LIBNC_NC_MAX_PULSES     (NC_DATA_SIZE * 7 + 1)
+#define LIBNC_NC2_MAX_PULSES    (NC_DATA_SIZE * 5 + 3)
+#define LIBNC_HE_MAX_ATTEMPTS   20
+#define LIBNC_HE_PULSES         66  // per attempt
+
+// Pulse table for a new code (an encoded message from libnc_encode) using
+// version 1 or version 2 line coding (see README.md), or for a Home Easy code
+// sent "attempts" times. "timing" may be NULL.
+// Returns the number of entries, or 0 on error.
+size_t libnc_nc_pulses(const uint8_t* message, const libnc_timing_t* timing,
+                       libnc_pulse_t* pulses, size_t max_pulses);
+size_t libnc_nc2_pulses(const uint8_t* message, const libnc_timing_t* timing,
+                        libnc_pulse_t* pulses, size_t max_pulses);
+size_t libnc_he_pulses(uint32_t code, unsigned attempts, const libnc_timing_t* timing,
+                       libnc_pulse_t* pulses, size_t max_pulses);
+
+// A pulse table in the format of pigpio's gpioPulse_t, as sent by wave_add_generic,
+// for the GPIOs in "gpio_mask": each high pulse sets them and each low period clears
+// them. "gpio_pulses" has room for 2 * count entries.
+// Returns the number of entries.
+typedef struct libnc_gpio_pulse_s {
+    uint32_t    gpio_on;
+    uint32_t    gpio_off;
+    uint32_t    delay_us;
+} libnc_gpio_pulse_t;
+
+size_t libnc_gpio_pulses(const libnc_pulse_t* pulses, size_t count, uint32_t gpio_mask,
+                         libnc_gpio_pulse_t* gpio_pulses);
+
+// Times of the rising edges of a pulse table (microseconds from its start), as
+// seen by the receiver. "times" has room for "count" entries.
+// Returns the number of edges.
+size_t libnc_edges(const libnc_pulse_t* pulses, size_t count, uint32_t* times);
+
+// As libnc_he_pulses, but the table is kept and reused for the same code,
+// attempts and timing. The table remains valid until LIBNC_HE_CACHE_SIZE
+// other tables have been requested. Returns NULL on error.
+#define LIBNC_HE_CACHE_SIZE     4
+const libnc_pulse_t* libnc_he_pulses_cached(uint32_t code, unsigned attempts,
+                       const libnc_timing_t* timing, size_t* count);
+
+// Line coding used by home_easy.py for messages sent by udp_message (1 or 2)
+int udp_set_version(unsigned version);
 int udp_message(const uint8_t* payload, size_t payload_size);
+int udp_fragmented_message(const uint8_t* payload, size_t payload_size);
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,8 @@
 #include "libnc.h"
 #include "hmac433.h"
 #include "rx433.h"
+#include "fragment.h"
+#include "packed.h"
 
 static int set_time(uint8_t* payload, unsigned trigger)
 {
@@ -68,12 +70,97 @@ static int set_time(uint8_t* payload, unsigned trigger)
     return 1;
 }
 
+static int packed_write(uint8_t* payload, unsigned* pos, unsigned bits, unsigned value)
+{
+    if ((value >> bits) || ((*pos + bits) > (FRAGMENT_MAX_PAYLOAD * 8))) {
+        return 0;
+    }
+    for (; bits > 0; bits--, (*pos)++) {
+        if ((value >> (bits - 1)) & 1) {
+            payload[*pos >> 3] |= 0x80 >> (*pos & 7);
+        }
+    }
+    return 1;
+}
+
+// Pack several commands into one payload (see packed.h).
+// Returns the size of the payload, or 0 if the commands are invalid.
+static int packed_message(uint8_t* payload, int argc, char** argv, int latency)
+{
+    unsigned pos = 8;
+    int has_time = 0;
+    int ok = 1;
+    int i = 0;
+
+    payload[0] = PACKED_COMMANDS;
+    while (ok && (i < argc)) {
+        const char* name = argv[i++];
+        unsigned value[4];
+        int j, count = 0;
+
+        if (strcasecmp(name, "set_alarm") == 0) {
+            count = 2;
+        } else if (strcasecmp(name, "set_day_night_time") == 0) {
+            count = 4;
+        } else if ((strcasecmp(name, "set_time") != 0)
+        && (strcasecmp(name, "unset_alarm") != 0)) {
+            fprintf(stderr, "%s can't be packed\n", name);
+            return 0;
+        }
+        if ((i + count) > argc) {
+            fprintf(stderr, "%s needs %d values\n", name, count);
+            return 0;
+        }
+        for (j = 0; j < count; j++) {
+            value[j] = (unsigned) strtol(argv[i++], NULL, 0);
+            ok = ok && (value[j] < ((j & 1) ? 60 : 24));
+        }
+
+        if (strcasecmp(name, "set_time") == 0) {
+            uint8_t time[PACKET_PAYLOAD_SIZE];
+
+            if (!set_time(time, 1000000 - latency)) {
+                return 0;
+            }
+            has_time = 1;
+            ok = ok && packed_write(payload, &pos, PACKED_CODE_BITS, PACKED_TIME)
+                && packed_write(payload, &pos, PACKED_HOUR_BITS, time[1])
+                && packed_write(payload, &pos, PACKED_MINUTE_BITS, time[2])
+                && packed_write(payload, &pos, PACKED_SECOND_BITS, time[3]);
+        } else if (strcasecmp(name, "unset_alarm") == 0) {
+            ok = ok && packed_write(payload, &pos, PACKED_CODE_BITS, PACKED_ALARM)
+                && packed_write(payload, &pos, PACKED_HOUR_BITS, PACKED_UNSET_HOUR)
+                && packed_write(payload, &pos, PACKED_MINUTE_BITS, 0);
+        } else {
+            ok = ok && packed_write(payload, &pos, PACKED_CODE_BITS,
+                                    (count == 2) ? PACKED_ALARM : PACKED_NIGHT_DAY);
+            for (j = 0; j < count; j++) {
+                ok = ok && packed_write(payload, &pos,
+                                (j & 1) ? PACKED_MINUTE_BITS : PACKED_HOUR_BITS, value[j]);
+            }
+        }
+    }
+    if (!ok) {
+        fputs("invalid time, or too many commands\n", stderr);
+        return 0;
+    }
+    if (has_time && (pos > (PACKET_PAYLOAD_SIZE * 8))) {
+        // The fragments would arrive too late
+        fputs("set_time can only be packed with commands that fit in one packet\n", stderr);
+        return 0;
+    }
+    return (pos + 7) / 8;
+}
+
 int main(int argc, char** argv)
 {
-    uint8_t payload[PACKET_PAYLOAD_SIZE];
+    uint8_t payload[FRAGMENT_MAX_PAYLOAD];
     int     i;
     const char *cmd = NULL;
     int     size = 0;
+    int     deferred = 0;
+    uint8_t at_hour = 0;
+    uint8_t at_minute = 0;
 
     if (argc >= 2) {
         if ((argc >= 3)
@@ -83,20 +170,50 @@ int main(int argc, char** argv)
             memmove(&argv[1], &argv[2], sizeof(char*) * (argc - 2));
             argc--;
         }
+        if ((argc >= 3) && (strcasecmp(argv[1], "v2") == 0)) {
+            // Version 2 line coding
+            udp_set_version(2);
+            memmove(&argv[1], &argv[2], sizeof(char*) * (argc - 2));
+            argc--;
+        }
+        if ((argc >= 5) && (strcasecmp(argv[1], "at") == 0)) {
+            // Run the command at a later time
+            deferred = 1;
+            at_hour = (uint8_t) strtol(argv[2], NULL, 0);
+            at_minute = (uint8_t) strtol(argv[3], NULL, 0);
+            memmove(&argv[1], &argv[4], sizeof(char*) * (argc - 4));
+            argc -= 3;
+        }
         cmd = argv[1];
         size = argc - 1;
     }
     if (cmd == NULL) {
         fprintf(stderr,
-            "Usage: txnc433 <message>\n"
+            "Usage: txnc433 [v2] [at <h> <m>] <message>\n"
+            "v2 = send with version 2 line coding (shorter, needs newer firmware)\n"
+            "at <h> <m> = the clock runs the command at <h>:<m> (within 24 hours),\n"
+            "    for set_alarm, unset_alarm, set_schedule, set_day_night_time\n"
+            "    and bytes (the clock has room for 2 to 4 commands)\n"
             "<message> may be any of\n"
             "  set_time = set the time\n"
             "  set_alarm <h> <m> = set the alarm to <h>:<m> (decimals)\n"
             "  unset_alarm = cancel alarm\n"
-            "  message <M> = send tiny message <M>\n"
-            "  set_day_night_time <hn> <mn> <hd> <md> = set the start time \n"
-            "    for night as <hn>:<mn> and day as <hd>:<md>\n"
+            "  set_schedule <n> <h> <m> <d> = set scheduled alarm <n> (1 or 2)\n"
+            "    to sound every week at <h>:<m> on weekdays <d> (a mask,\n"
+            "    1 = Sunday, 2 = Monday, .. 64 = Saturday, 0 = remove)\n"
+            "  message <M> = send message <M>, split into several\n"
+            "    packets if longer than 5 characters (maximum 29)\n"
+            "  set_day_night_time <hn> <mn> <hd> <md> [<d>] = set the start time \n"
+            "    for night as <hn>:<mn> and day as <hd>:<md>, optionally only\n"
+            "    on weekdays <d> (a mask, as for set_schedule)\n"
             "  counter = show HMAC counter\n"
+            "  drift = show estimated drift of the clock\n"
+            "  clear_deferred = remove every command waiting to run later\n"
+            "  packed <command> ... = several of set_time, set_alarm <h> <m>,\n"
+            "    unset_alarm and set_day_night_time <hn> <mn> <hd> <md> (every day)\n"
+            "    in one packet, e.g. packed set_time set_alarm 7 0; the clock runs\n"
+            "    them in order. set_time can only be packed if the commands fit\n"
+            "    in one packet (so not with set_day_night_time)\n"
             "  resync = resynchronise HMAC counter\n"
             "  advresync = advance HMAC counter by a long way, then resynchronise\n"
             "  or: 1..6 bytes, separated by spaces, each written\n"
@@ -127,15 +244,18 @@ int main(int argc, char** argv)
     } else if (strcasecmp(cmd, "set_alarm") == 0) {
         payload[0] = 'A';
         size = 3;
+    } else if (strcasecmp(cmd, "set_schedule") == 0) {
+        payload[0] = 'S';
+        size = 5;
     } else if (strcasecmp(cmd, "unset_alarm") == 0) {
         payload[0] = 'a';
         size = 1;
     } else if (strcasecmp(cmd, "set_day_night_time") == 0) {
         payload[0] = 'N';
-        size = 5;
+        size = 6;
     } else if (strcasecmp(cmd, "message") == 0) {
         payload[0] = 'M';
-        for (i = 1; i < PACKET_PAYLOAD_SIZE; i++) {
+        for (i = 1; i < FRAGMENT_MAX_PAYLOAD; i++) {
             payload[i] = argv[2][i - 1];
             if (payload[i] == '\0') {
                 break;
@@ -145,6 +265,20 @@ int main(int argc, char** argv)
     } else if (strcasecmp(cmd, "counter") == 0) {
         payload[0] = 'C';
         size = 1;
+    } else if (strcasecmp(cmd, "drift") == 0) {
+        payload[0] = 'C';
+        payload[1] = 'D';
+        size = 2;
+    } else if (strcasecmp(cmd, "packed") == 0) {
+        memset(payload, 0, sizeof(payload));
+        size = packed_message(payload, argc - 2, &argv[2], 100000);
+        if (size == 0) {
+            return 1;
+        }
+    } else if (strcasecmp(cmd, "clear_deferred") == 0) {
+        payload[0] = 'D';
+        payload[1] = 0xff;
+        size = 2;
     } else if (strcasecmp(cmd, "resync") == 0) {
         size = RESYNC;
     } else if (strcasecmp(cmd, "advresync") == 0) {
@@ -154,7 +288,21 @@ int main(int argc, char** argv)
         size = RESYNC;
     }
 
-    if (!udp_message(payload, size)) {
+    if (deferred) {
+        if ((size == RESYNC) || (size > PACKET_PAYLOAD_SIZE)
+        || (strcasecmp(cmd, "set_time") == 0)
+        || (payload[0] == 0) || !strchr("ASNa", payload[0])) {
+            fputs("this command can't be run later\n", stderr);
+            return 1;
+        }
+        memmove(&payload[3], &payload[0], size);
+        payload[0] = 'D';
+        payload[1] = at_hour;
+        payload[2] = at_minute;
+        size += 3;
+    }
+
+    if (!udp_fragmented_message(payload, size)) {
         return 1;
     }
     return 0;
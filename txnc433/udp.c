@@ -7,14 +7,31 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <time.h>
 
 #include "libnc.h"
 #include "hmac433.h"
 #include "rx433.h"
+#include "fragment.h"
 
 #define NC_HEADER_SIZE 2
 static const char* header = "NC";
 
+int udp_set_version(unsigned version)
+{
+    switch (version) {
+        case 1:
+            header = "NC";
+            return 1;
+        case 2:
+            // home_easy.py sends the message with version 2 line coding
+            header = "N2";
+            return 1;
+        default:
+            return 0;
+    }
+}
+
 int udp_message(const uint8_t* payload, size_t payload_size)
 {
     uint8_t message[NC_DATA_SIZE + NC_HEADER_SIZE];
@@ -59,3 +76,37 @@ int udp_message(const uint8_t* payload, size_t payload_size)
     close(s);
     return 1;
  }
+
+int udp_fragmented_message(const uint8_t* payload, size_t payload_size)
+{
+    uint8_t fragment[PACKET_PAYLOAD_SIZE];
+    uint8_t tag = (uint8_t) time(NULL) & FRAGMENT_TAG_MASK;
+    size_t  count, i, size;
+
+    if (payload_size <= PACKET_PAYLOAD_SIZE) {
+        // Fits in one packet
+        return udp_message(payload, payload_size);
+    }
+    if (payload_size > FRAGMENT_MAX_PAYLOAD) {
+        fputs("Message is too large\n", stderr);
+        return 0;
+    }
+
+    count = (payload_size + FRAGMENT_DATA_SIZE - 1) / FRAGMENT_DATA_SIZE;
+    for (i = 0; i < count; i++) {
+        memset(fragment, 0, sizeof(fragment));
+        fragment[0] = FRAGMENT_FLAG | (tag << FRAGMENT_TAG_SHIFT) | (uint8_t) i;
+        if ((i + 1) == count) {
+            fragment[0] |= FRAGMENT_LAST;
+        }
+        size = payload_size - (i * FRAGMENT_DATA_SIZE);
+        if (size > FRAGMENT_DATA_SIZE) {
+            size = FRAGMENT_DATA_SIZE;
+        }
+        memcpy(&fragment[1], &payload[i * FRAGMENT_DATA_SIZE], size);
+        if (!udp_message(fragment, PACKET_PAYLOAD_SIZE)) {
+            return 0;
+        }
+    }
+    return 1;
+}